@@ -91,9 +91,8 @@ static bool trim_bad_trailing_directory_chars(pfc::string8& path)
 std::string preferences::saving::filename(metadb_handle_ptr track, const metadb_v2_rec_t& track_info)
 {
     const char* name_format_str = cfg_save_filename_format.c_str();
-    titleformat_object::ptr name_format_script;
-    bool name_compile_success = titleformat_compiler::get()->compile(name_format_script, name_format_str);
-    if(!name_compile_success)
+    titleformat_object::ptr name_format_script = compile_titleformat_cached(name_format_str);
+    if(name_format_script.is_empty())
     {
         LOG_WARN("Failed to compile save file format: %s", name_format_str);
         return "";
@@ -143,9 +142,8 @@ std::string preferences::saving::filename(metadb_handle_ptr track, const metadb_
             const char* path_format_str = cfg_save_path_custom.get_ptr();
             dir_class_name = std::string("Custom('") + path_format_str + "')";
 
-            titleformat_object::ptr dir_format_script;
-            bool dir_compile_success = titleformat_compiler::get()->compile(dir_format_script, path_format_str);
-            if(!dir_compile_success)
+            titleformat_object::ptr dir_format_script = compile_titleformat_cached(path_format_str);
+            if(dir_format_script.is_empty())
             {
                 LOG_WARN("Failed to compile save path format: %s", path_format_str);
                 return "";
@@ -14,6 +14,8 @@ static const GUID GUID_PREFERENCES_PAGE_SRC_METATAGS = { 0x23c180eb, 0x1f8f, 0x4
 static const GUID GUID_CFG_SEARCH_TAGS = { 0xb7332708, 0xe70b, 0x4a6e, { 0xa4, 0xd, 0x14, 0x6d, 0xe3, 0x74, 0x56, 0x65 } };
 static const GUID GUID_CFG_SAVE_TAG_UNTIMED = { 0x39b0bc08, 0x5c3a, 0x4359, { 0x9d, 0xdb, 0xd4, 0x90, 0x84, 0xb, 0x31, 0x88 } };
 static const GUID GUID_CFG_SAVE_TAG_TIMESTAMPED = { 0x337d0d40, 0xe9da, 0x4531, { 0xb0, 0x82, 0x13, 0x24, 0x56, 0xe5, 0xc4, 0x2 } };
+static const GUID GUID_CFG_SAVE_TAG_BATCH_SIZE = { 0xc87fb5b8, 0xe4b7, 0x4ece, { 0xbd, 0xab, 0x58, 0x10, 0xe4, 0x93, 0x79, 0xc0 } };
+static const GUID GUID_CFG_SAVE_TAG_BATCH_INTERVAL = { 0x99047ea8, 0x59bb, 0x44d0, { 0xad, 0xe8, 0x12, 0x5f, 0xe7, 0xeb, 0x4, 0x61 } };
 
 static cfg_auto_string cfg_search_tags(GUID_CFG_SEARCH_TAGS, IDC_SEARCH_TAGS, "LYRICS;SYNCEDLYRICS;UNSYNCED LYRICS;UNSYNCEDLYRICS");
 
@@ -25,11 +27,18 @@ static cfg_auto_string cfg_search_tags(GUID_CFG_SEARCH_TAGS, IDC_SEARCH_TAGS, "L
 static cfg_auto_string cfg_save_tag_untimed(GUID_CFG_SAVE_TAG_UNTIMED, IDC_SAVE_TAG_UNSYNCED, "UNSYNCED LYRICS");
 static cfg_auto_string cfg_save_tag_timestamped(GUID_CFG_SAVE_TAG_TIMESTAMPED, IDC_SAVE_TAG_SYNCED, "UNSYNCED LYRICS"); // 
 
+// Tag updates are collected and written together, so that (for example) a bulk search that saves to tags
+// doesn't need a separate tag update (each with its own UI refresh) for every track.
+static cfg_auto_int cfg_save_tag_batch_size(GUID_CFG_SAVE_TAG_BATCH_SIZE, IDC_SAVE_TAG_BATCH_SIZE, 50);
+static cfg_auto_int cfg_save_tag_batch_interval_ms(GUID_CFG_SAVE_TAG_BATCH_INTERVAL, IDC_SAVE_TAG_BATCH_INTERVAL, 1000);
+
 static cfg_auto_property* g_root_auto_properties[] =
 {
     &cfg_search_tags,
     &cfg_save_tag_untimed,
     &cfg_save_tag_timestamped,
+    &cfg_save_tag_batch_size,
+    &cfg_save_tag_batch_interval_ms,
 };
 
 std::vector<std::string> preferences::searching::tags()
@@ -66,6 +75,16 @@ std::string_view preferences::saving::timestamped_tag()
     return {cfg_save_tag_timestamped.get_ptr(), cfg_save_tag_timestamped.get_length()};
 }
 
+size_t preferences::saving::tag_batch_size()
+{
+    return size_t(std::max(1, cfg_save_tag_batch_size.get_value()));
+}
+
+double preferences::saving::tag_batch_interval_seconds()
+{
+    return double(std::max(0, cfg_save_tag_batch_interval_ms.get_value()))/1000.0;
+}
+
 
 class PreferencesSrcMetatags : public CDialogImpl<PreferencesSrcMetatags>, public auto_preferences_page_instance
 {
@@ -85,6 +104,8 @@ public:
         COMMAND_HANDLER_EX(IDC_SEARCH_TAGS, EN_CHANGE, OnUIChange)
         COMMAND_HANDLER_EX(IDC_SAVE_TAG_SYNCED, EN_CHANGE, OnUIChange)
         COMMAND_HANDLER_EX(IDC_SAVE_TAG_UNSYNCED, EN_CHANGE, OnUIChange)
+        COMMAND_HANDLER_EX(IDC_SAVE_TAG_BATCH_SIZE, EN_CHANGE, OnUIChange)
+        COMMAND_HANDLER_EX(IDC_SAVE_TAG_BATCH_INTERVAL, EN_CHANGE, OnUIChange)
         COMMAND_HANDLER_EX(IDC_SAVE_TAG_EXPLAIN, BN_CLICKED, OnTagExplain)
     END_MSG_MAP()
 
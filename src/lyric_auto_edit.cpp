@@ -5,280 +5,385 @@
 #include "lyric_auto_edit.h"
 #include "lyric_io.h"
 
-std::optional<LyricData> auto_edit::RunAutoEdit(AutoEditType type, const LyricData& lyrics)
+// Each auto-edit is a transform of a single line, which edits the line in-place and reports whether it changed anything.
+// This lets us apply any number of edits in one pass over the lines, rather than copying the lyrics once for every edit.
+struct EditStage
 {
-    switch(type)
-    {
-        case AutoEditType::ReplaceHtmlEscapedChars: return ReplaceHtmlEscapedChars(lyrics);
-        case AutoEditType::RemoveRepeatedSpaces: return RemoveRepeatedSpaces(lyrics);
-        case AutoEditType::RemoveRepeatedBlankLines: return RemoveRepeatedBlankLines(lyrics);
-        case AutoEditType::RemoveAllBlankLines: return RemoveAllBlankLines(lyrics);
-        case AutoEditType::ResetCapitalisation: return ResetCapitalisation(lyrics);
-        case AutoEditType::FixMalformedTimestamps: return FixMalformedTimestamps(lyrics);
-        case AutoEditType::RemoveTimestamps: return RemoveTimestamps(lyrics);
-
-        case AutoEditType::Unknown:
-        default:
-            LOG_ERROR("Unexpected auto-edit type: %d", int(type));
-            assert(false);
-            return {};
-    }
+    AutoEditType type;
+    size_t change_count;
+    bool previous_blank; // Only used by RemoveRepeatedBlankLines
+};
+
+static bool is_blank_or_spaces(const std::tstring& text)
+{
+    return text.find_first_not_of(_T(' ')) == std::tstring::npos;
 }
 
-std::optional<LyricData> auto_edit::ReplaceHtmlEscapedChars(const LyricData& lyrics)
+static bool is_blank_or_whitespace(const std::tstring& text)
 {
-    LyricDataUnstructured unstructured = parsers::lrc::serialise(lyrics);
-    std::pair<std::string_view, char> replacements[] =
-    {
-        {"&amp;", '&'},
-        {"&lt;", '<'},
-        {"&gt;", '>'},
-        {"&quot;", '"'},
-        {"&apos;", '\''},
-    };
-
-    size_t replace_count = 0;
-    for(auto [escaped, replacement] : replacements)
+    const auto is_not_whitespace = [](wchar_t c) { return std::iswspace(c) == 0; };
+    return std::find_if(text.begin(), text.end(), is_not_whitespace) == text.end();
+}
+
+static bool decode_html_escaped_chars(std::string& text)
+{
+    if(text.find('&') == std::string::npos)
     {
-        size_t current_index = 0;
-        while(current_index < unstructured.text.length())
-        {
-            size_t next_index = unstructured.text.find(escaped, current_index);
-            if(next_index == std::string::npos) break;
+        return false;
+    }
 
-            unstructured.text.replace(next_index, escaped.length(), 1, replacement);
-            current_index = next_index + 1;
-            replace_count++;
-        }
+    std::string decoded;
+    decoded.reserve(text.length());
+    parsers::html::append_decoded_text(decoded, text);
+    if(decoded == text)
+    {
+        return false;
     }
-    LOG_INFO("Auto-edit replaced %u named HTML-encoded characters", replace_count);
+    text = std::move(decoded);
+    return true;
+}
 
-    if(replace_count > 0)
+static bool replace_html_escaped_chars(LyricDataLine& line)
+{
+    if(line.text.find(_T('&')) == std::tstring::npos)
     {
-        return {parsers::lrc::parse(unstructured)};
+        return false;
     }
-    else
+
+    std::string text = from_tstring(line.text);
+    if(!decode_html_escaped_chars(text))
     {
-        return {};
+        return false;
     }
+    line.text = to_tstring(text);
+    return true;
 }
 
-std::optional<LyricData> auto_edit::RemoveRepeatedSpaces(const LyricData& lyrics)
+static size_t remove_repeated_spaces(LyricDataLine& line)
 {
-    size_t spaces_erased = 0;
-    LyricData new_lyrics = lyrics;
-    for(LyricDataLine& line : new_lyrics.lines)
+    const auto both_spaces = [](TCHAR lhs, TCHAR rhs) { return (lhs == _T(' ')) && (rhs == _T(' ')); };
+    const auto new_end = std::unique(line.text.begin(), line.text.end(), both_spaces);
+    const size_t spaces_erased = size_t(std::distance(new_end, line.text.end()));
+    line.text.erase(new_end, line.text.end());
+    return spaces_erased;
+}
+
+static bool reset_capitalisation(LyricDataLine& line)
+{
+    if(line.text.empty())
+    {
+        return false;
+    }
+
+    bool edited = false;
+    if(line.text[0] <= 255)
     {
-        size_t search_start = 0;
-        while(search_start < line.text.length())
+        if(_istlower(line.text[0]))
         {
-            size_t next_space = line.text.find_first_of(_T(' '), search_start);
+            line.text[0] = _totupper(static_cast<unsigned char>(line.text[0]));
+            edited = true;
+        }
+    }
 
-            // NOTE: If the line was empty we would not enter this loop.
-            //       We subtract 1 from the length to avoid overflowing when next_space == npos == (size_t)-1
-            assert(line.text.length() > 0);
-            if(next_space > line.text.length()-1)
+    for(size_t i=1; i<line.text.length(); i++)
+    {
+        if(line.text[i] <= 255)
+        {
+            if(_istupper(line.text[i]))
             {
-                break;
+                line.text[i] = _totlower(static_cast<unsigned char>(line.text[i]));
+                edited = true;
             }
+        }
+    }
+    return edited;
+}
 
-            size_t erase_start = next_space + 1;
-            size_t erase_end = line.text.find_first_not_of(_T(' '), erase_start);
+// Fixes the timestamp tag at the given position in the text if it is malformed only by having the wrong separator before
+// the fractional seconds (e.g "[00:12:34]" instead of "[00:12.34]"). Returns true if the tag was fixed.
+static bool fix_decimal_separator(std::string& text, size_t tag_start, size_t tag_length)
+{
+    const std::string_view tag(text.data() + tag_start, tag_length);
+    if((tag.length() < 10) || // Tag isn't long enough to contain a timestamp
+       (tag[0] != '[') || // Tag doesn't start with a bracket
+       (tag[tag.length()-1] != ']')) // Tag doesn't end with a bracket
+    {
+        return false;
+    }
 
-            if((erase_end != std::tstring::npos) && (erase_end > erase_start))
-            {
-                size_t erase_count = erase_end - erase_start;
-                line.text.erase(erase_start, erase_count);
-                spaces_erased += erase_count;
-            }
-            search_start = next_space + 1;
-        }
+    double unused;
+    bool was_bad = !parsers::lrc::try_parse_timestamp(tag, unused);
+    if(!was_bad)
+    {
+        return false;
     }
-    LOG_INFO("Auto-removal removed %u unnecessary spaces", spaces_erased);
 
-    if(spaces_erased > 0)
+    size_t last_nondecimal_index = tag.find_last_not_of("1234567890.", tag.length()-2);
+    if(last_nondecimal_index == std::string_view::npos)
     {
-        return {std::move(new_lyrics)};
+        return false; // No non-decimal characters, this really shouldn't happen since we've checked tag[0]=='[' above.
     }
-    else
+
+    char& replaced_char = text[tag_start + last_nondecimal_index];
+    const char original_char = replaced_char;
+    replaced_char = '.';
+    bool is_fixed = parsers::lrc::try_parse_timestamp(tag, unused);
+    if(!is_fixed)
     {
-        return {};
+        replaced_char = original_char;
     }
+    return is_fixed;
 }
 
-std::optional<LyricData> auto_edit::RemoveRepeatedBlankLines(const LyricData& lyrics)
+// Fixes any malformed timestamps in the line. Any (now well-formed) timestamps at the start of the line are removed
+// from the text and returned, so that the line can be given those timestamps in the same way that it would be if
+// the fixed text were re-parsed.
+static bool fix_malformed_timestamps(LyricDataLine& line, std::vector<double>& out_timestamps)
 {
-    size_t lines_removed = 0;
-    bool previous_blank = true;
-    LyricData new_lyrics = lyrics;
-    for(auto iter=new_lyrics.lines.begin(); iter != new_lyrics.lines.end(); /*Omitted*/)
+    if(line.text.find(_T('[')) == std::tstring::npos)
     {
-        size_t first_non_space = iter->text.find_first_not_of(' ');
-        bool is_blank = (first_non_space == std::tstring::npos);
-        if(is_blank && previous_blank)
+        return false;
+    }
+
+    std::string text = from_tstring(line.text);
+    int change_count = 0;
+    size_t current_index = text.find('[');
+    while(current_index != std::string::npos)
+    {
+        size_t end_index = text.find(']', current_index);
+        if(end_index == std::string::npos)
         {
-            iter = new_lyrics.lines.erase(iter);
-            lines_removed++;
+            break;
         }
-        else
+
+        if(fix_decimal_separator(text, current_index, end_index - current_index + 1))
         {
-            iter++;
+            change_count++;
         }
-        previous_blank = is_blank;
+        current_index = text.find('[', current_index+1);
     }
-    LOG_INFO("Auto-removal removed %u blank lines", lines_removed);
 
-    if(lines_removed > 0)
+    if(change_count == 0)
     {
-        return {std::move(new_lyrics)};
+        return false;
     }
-    else
+
+    size_t timestamps_end = 0;
+    while((timestamps_end < text.length()) && (text[timestamps_end] == '['))
     {
-        return {};
+        const size_t close_index = text.find(']', timestamps_end);
+        if(close_index == std::string::npos)
+        {
+            break;
+        }
+
+        double timestamp = 0.0;
+        const std::string_view tag(text.data() + timestamps_end, close_index - timestamps_end + 1);
+        if(!parsers::lrc::try_parse_timestamp(tag, timestamp))
+        {
+            break;
+        }
+        out_timestamps.push_back(timestamp);
+        timestamps_end = close_index + 1;
     }
+
+    line.text = to_tstring(std::string_view(text).substr(timestamps_end));
+    return true;
 }
 
-std::optional<LyricData> auto_edit::RemoveAllBlankLines(const LyricData& lyrics)
+// Applies the given edit stages (starting from first_stage) to the line.
+// Returns false if the line should be removed from the lyrics.
+static bool apply_edit_stages(LyricDataLine& line,
+                              std::vector<EditStage>& stages,
+                              size_t first_stage,
+                              std::vector<LyricDataLine>& out_new_lines,
+                              bool& out_needs_sort)
 {
-    LyricData new_lyrics = lyrics;
-    auto line_is_empty = [](const LyricDataLine& line)
+    for(size_t stage_index=first_stage; stage_index<stages.size(); stage_index++)
     {
-        if(line.text.empty())
+        EditStage& stage = stages[stage_index];
+        switch(stage.type)
         {
-            return true;
-        }
+            case AutoEditType::ReplaceHtmlEscapedChars:
+            {
+                stage.change_count += replace_html_escaped_chars(line) ? 1 : 0;
+            } break;
 
-        const auto is_not_whitespace = [](wchar_t c) { return std::iswspace(c) == 0; };
-        const auto first_not_whitespace = std::find_if(line.text.begin(), line.text.end(), is_not_whitespace);
-        return first_not_whitespace == line.text.end();
-    };
-    auto new_end = std::remove_if(new_lyrics.lines.begin(), new_lyrics.lines.end(), line_is_empty);
-    ptrdiff_t lines_removed = std::distance(new_end, new_lyrics.lines.end());
-    new_lyrics.lines.erase(new_end, new_lyrics.lines.end());
-    LOG_INFO("Auto-removal removed %d blank lines", lines_removed);
+            case AutoEditType::RemoveRepeatedSpaces:
+            {
+                stage.change_count += remove_repeated_spaces(line);
+            } break;
 
-    if(lines_removed > 0)
-    {
-        return {std::move(new_lyrics)};
-    }
-    else
-    {
-        return {};
-    }
-}
+            case AutoEditType::RemoveRepeatedBlankLines:
+            {
+                const bool is_blank = is_blank_or_spaces(line.text);
+                const bool remove = is_blank && stage.previous_blank;
+                stage.previous_blank = is_blank;
+                if(remove)
+                {
+                    stage.change_count++;
+                    return false;
+                }
+            } break;
 
-std::optional<LyricData> auto_edit::ResetCapitalisation(const LyricData& lyrics)
-{
-    LyricData new_lyrics = lyrics;
+            case AutoEditType::RemoveAllBlankLines:
+            {
+                if(is_blank_or_whitespace(line.text))
+                {
+                    stage.change_count++;
+                    return false;
+                }
+            } break;
 
-    size_t edit_count = 0;
-    for(LyricDataLine& line : new_lyrics.lines)
-    {
-        if(line.text.empty()) continue;
+            case AutoEditType::ResetCapitalisation:
+            {
+                stage.change_count += reset_capitalisation(line) ? 1 : 0;
+            } break;
 
-        bool edited = false;
-        if(line.text[0] <= 255)
-        {
-            if(_istlower(line.text[0]))
+            case AutoEditType::FixMalformedTimestamps:
             {
-                line.text[0] = _totupper(static_cast<unsigned char>(line.text[0]));
-                edited = true;
-            }
-        }
+                std::vector<double> timestamps;
+                if(!fix_malformed_timestamps(line, timestamps))
+                {
+                    break;
+                }
+                stage.change_count++;
 
-        for(size_t i=1; i<line.text.length(); i++)
-        {
-            if(line.text[i] <= 255)
+                // NOTE: Lines that gain timestamps need to be moved to the right place in the lyrics (and possibly merged
+                //       with lines that have the same timestamp), which we do once all edits have been applied to all lines.
+                //       Lines with more than one timestamp are duplicated, as they would be by the parser.
+                size_t next_timestamp = 0;
+                if((line.timestamp == DBL_MAX) && !timestamps.empty())
+                {
+                    line.timestamp = timestamps[next_timestamp++];
+                    out_needs_sort = true;
+                }
+                for(; next_timestamp<timestamps.size(); next_timestamp++)
+                {
+                    LyricDataLine new_line = {line.text, timestamps[next_timestamp]};
+                    if(apply_edit_stages(new_line, stages, stage_index + 1, out_new_lines, out_needs_sort))
+                    {
+                        out_new_lines.push_back(std::move(new_line));
+                    }
+                    out_needs_sort = true;
+                }
+            } break;
+
+            case AutoEditType::RemoveTimestamps:
             {
-                if(_istupper(line.text[i]))
+                if(line.timestamp != DBL_MAX)
                 {
-                    line.text[i] = _totlower(static_cast<unsigned char>(line.text[i]));
-                    edited = true;
+                    line.timestamp = DBL_MAX;
+                    stage.change_count++;
                 }
-            }
-        }
+            } break;
 
-        if(edited)
-        {
-            edit_count++;
+            case AutoEditType::Unknown:
+            default:
+                break;
         }
     }
-    LOG_INFO("Auto-edit changed the capitalisation of %u lines", edit_count);
+    return true;
+}
 
-    if(edit_count > 0)
+static void log_edit_stage(const EditStage& stage)
+{
+    switch(stage.type)
     {
-        return {std::move(new_lyrics)};
-    }
-    else
-    {
-        return {};
+        case AutoEditType::ReplaceHtmlEscapedChars: LOG_INFO("Auto-edit replaced HTML-encoded characters in %d lines", int(stage.change_count)); break;
+        case AutoEditType::RemoveRepeatedSpaces: LOG_INFO("Auto-removal removed %d unnecessary spaces", int(stage.change_count)); break;
+        case AutoEditType::RemoveRepeatedBlankLines: LOG_INFO("Auto-removal removed %d repeated blank lines", int(stage.change_count)); break;
+        case AutoEditType::RemoveAllBlankLines: LOG_INFO("Auto-removal removed %d blank lines", int(stage.change_count)); break;
+        case AutoEditType::ResetCapitalisation: LOG_INFO("Auto-edit changed the capitalisation of %d lines", int(stage.change_count)); break;
+        case AutoEditType::FixMalformedTimestamps: LOG_INFO("Auto-edit fixed malformed timestamps in %d lines", int(stage.change_count)); break;
+        case AutoEditType::RemoveTimestamps: LOG_INFO("Auto-edit removed timestamps from %d lines", int(stage.change_count)); break;
+        default: break;
     }
 }
 
-std::optional<LyricData> auto_edit::FixMalformedTimestamps(const LyricData& lyrics)
+bool auto_edit::RunAutoEdits(const std::vector<AutoEditType>& types, LyricData& lyrics)
 {
-    const auto fix_decimal_separator = [](std::string_view tag)
+    std::vector<EditStage> stages;
+    stages.reserve(types.size());
+    for(AutoEditType type : types)
     {
-        if((tag.length() < 10) || // Tag isn't long enough to contain a timestamp
-           (tag[0] != '[') || // Tag doesn't start with a bracket
-           (tag[tag.length()-1] != ']')) // Tag doesn't end with a bracket
+        switch(type)
         {
-            return false;
-        }
+            case AutoEditType::ReplaceHtmlEscapedChars:
+            case AutoEditType::RemoveRepeatedSpaces:
+            case AutoEditType::RemoveRepeatedBlankLines:
+            case AutoEditType::RemoveAllBlankLines:
+            case AutoEditType::ResetCapitalisation:
+            case AutoEditType::FixMalformedTimestamps:
+            case AutoEditType::RemoveTimestamps:
+                stages.push_back({type, 0, true});
+                break;
 
-        double unused;
-        bool was_bad = !parsers::lrc::try_parse_timestamp(tag, unused);
-        if(!was_bad)
-        {
-            return false;
+            case AutoEditType::Unknown:
+            default:
+                LOG_ERROR("Unexpected auto-edit type: %d", int(type));
+                assert(false);
+                break;
         }
+    }
+    if(stages.empty())
+    {
+        return false;
+    }
 
-        size_t last_nondecimal_index = tag.find_last_not_of("1234567890.", tag.length()-2);
-        if(last_nondecimal_index == std::string_view::npos)
+    for(EditStage& stage : stages)
+    {
+        if(stage.type == AutoEditType::ReplaceHtmlEscapedChars)
         {
-            return false; // No non-decimal characters, this really shouldn't happen since we've checked tag[0]=='[' above.
+            for(std::string& tag : lyrics.tags)
+            {
+                stage.change_count += decode_html_escaped_chars(tag) ? 1 : 0;
+            }
         }
+    }
 
-        char replaced_char = tag[last_nondecimal_index];
-        const_cast<char&>(tag[last_nondecimal_index]) = '.';
-        bool is_fixed = parsers::lrc::try_parse_timestamp(tag, unused);
-        if(is_fixed)
+    // NOTE: Lines that are kept are moved down over the lines that were removed before them,
+    //       so that removing lines is linear in the number of lines rather than quadratic.
+    std::vector<LyricDataLine> new_lines;
+    bool needs_sort = false;
+    size_t write_index = 0;
+    for(size_t read_index=0; read_index<lyrics.lines.size(); read_index++)
+    {
+        LyricDataLine& line = lyrics.lines[read_index];
+        if(!apply_edit_stages(line, stages, 0, new_lines, needs_sort))
         {
-            return true;
+            continue;
         }
-        else
+
+        if(write_index != read_index)
         {
-            const_cast<char&>(tag[last_nondecimal_index]) = replaced_char;
-            return false;
+            lyrics.lines[write_index] = std::move(line);
         }
-    };
-
-    LyricDataUnstructured new_lyrics = parsers::lrc::serialise(lyrics);
+        write_index++;
+    }
+    lyrics.lines.erase(lyrics.lines.begin() + write_index, lyrics.lines.end());
 
-    int change_count = 0;
-    size_t current_index = new_lyrics.text.find('[');
-    while(current_index != std::string::npos)
+    if(needs_sort)
     {
-        bool changed = false;
-
-        size_t end_index = new_lyrics.text.find(']', current_index);
-        if(end_index == std::string::npos)
-        {
-            break;
-        }
-        std::string_view tag {new_lyrics.text.c_str() + current_index, end_index - current_index + 1};
-        changed |= fix_decimal_separator(tag);
+        std::move(new_lines.begin(), new_lines.end(), std::back_inserter(lyrics.lines));
+        parsers::lrc::sort_lines(lyrics.lines);
+    }
 
-        if(changed)
-        {
-            change_count++;
-        }
-        current_index = new_lyrics.text.find('[', current_index+1);
+    bool changed = false;
+    for(const EditStage& stage : stages)
+    {
+        log_edit_stage(stage);
+        changed |= (stage.change_count > 0);
     }
+    return changed;
+}
 
-    if(change_count > 0)
+std::optional<LyricData> auto_edit::RunAutoEdit(AutoEditType type, const LyricData& lyrics)
+{
+    LyricData new_lyrics = lyrics;
+    if(RunAutoEdits({type}, new_lyrics))
     {
-        return {parsers::lrc::parse(new_lyrics)};
+        return {std::move(new_lyrics)};
     }
     else
     {
@@ -286,12 +391,41 @@ std::optional<LyricData> auto_edit::FixMalformedTimestamps(const LyricData& lyri
     }
 }
 
+std::optional<LyricData> auto_edit::ReplaceHtmlEscapedChars(const LyricData& lyrics)
+{
+    return RunAutoEdit(AutoEditType::ReplaceHtmlEscapedChars, lyrics);
+}
+
+std::optional<LyricData> auto_edit::RemoveRepeatedSpaces(const LyricData& lyrics)
+{
+    return RunAutoEdit(AutoEditType::RemoveRepeatedSpaces, lyrics);
+}
+
+std::optional<LyricData> auto_edit::RemoveRepeatedBlankLines(const LyricData& lyrics)
+{
+    return RunAutoEdit(AutoEditType::RemoveRepeatedBlankLines, lyrics);
+}
+
+std::optional<LyricData> auto_edit::RemoveAllBlankLines(const LyricData& lyrics)
+{
+    return RunAutoEdit(AutoEditType::RemoveAllBlankLines, lyrics);
+}
+
+std::optional<LyricData> auto_edit::ResetCapitalisation(const LyricData& lyrics)
+{
+    return RunAutoEdit(AutoEditType::ResetCapitalisation, lyrics);
+}
+
+std::optional<LyricData> auto_edit::FixMalformedTimestamps(const LyricData& lyrics)
+{
+    return RunAutoEdit(AutoEditType::FixMalformedTimestamps, lyrics);
+}
+
 std::optional<LyricData> auto_edit::RemoveTimestamps(const LyricData& lyrics)
 {
+    // NOTE: We always return the new lyrics here (even if they already had no timestamps)
+    //       because the caller deletes the existing lyrics and then re-saves whatever we return.
     LyricData new_lyrics = lyrics;
-    for(LyricDataLine& line : new_lyrics.lines)
-    {
-        line.timestamp = DBL_MAX;
-    }
-    return {new_lyrics};
+    RunAutoEdits({AutoEditType::RemoveTimestamps}, new_lyrics);
+    return {std::move(new_lyrics)};
 }
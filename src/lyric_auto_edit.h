@@ -7,7 +7,11 @@
 
 namespace auto_edit
 {
-    std::optional<LyricData> RunAutoEdit(AutoEditType type, const LyricData& lyrics);
+    // Applies all of the given edits (in order) to the lyrics in-place, in a single pass over the lines.
+    // Returns true if any of the edits changed anything.
+    OPENLYRICS_TESTABLE_FUNC bool RunAutoEdits(const std::vector<AutoEditType>& types, LyricData& lyrics);
+
+    OPENLYRICS_TESTABLE_FUNC std::optional<LyricData> RunAutoEdit(AutoEditType type, const LyricData& lyrics);
 
     std::optional<LyricData> ReplaceHtmlEscapedChars(const LyricData& lyrics);
     std::optional<LyricData> RemoveRepeatedSpaces(const LyricData& lyrics);
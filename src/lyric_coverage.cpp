@@ -0,0 +1,371 @@
+#include "stdafx.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+
+#include "logging.h"
+#include "lyric_coverage.h"
+#include "metadb_index_search_avoidance.h"
+#include "parsers.h"
+#include "sources/lyric_source.h"
+
+static const GUID localfiles_src_guid = { 0x76d90970, 0x1c98, 0x4fe2, { 0x94, 0x4e, 0xac, 0xe4, 0x93, 0xf3, 0x8e, 0x85 } };
+static const GUID id3tag_src_guid = { 0x3fb0f715, 0xa097, 0x493a, { 0x94, 0x4e, 0xdb, 0x48, 0x66, 0x8, 0x86, 0x78 } };
+
+// Tracks are indexed in batches, with display updates dispatched for each batch rather than for each track
+static const size_t INDEX_BATCH_SIZE = 256;
+
+enum CoverageFlags : uint8_t
+{
+    None          = 0,
+    InLocalFile   = 1 << 0,
+    InTag         = 1 << 1,
+    Synced        = 1 << 2,
+    Unsynced      = 1 << 3,
+    Instrumental  = 1 << 4,
+    SearchSkipped = 1 << 5,
+};
+
+struct TrackCoverage
+{
+    metadb_handle_ptr track; // Held so that the key pointer remains valid for as long as the entry exists
+    uint8_t flags;
+};
+
+static std::mutex g_coverage_mutex;
+static std::unordered_map<const metadb_handle*, TrackCoverage> g_coverage;
+
+static std::mutex g_index_queue_mutex;
+static std::condition_variable g_indexer_idle;
+static std::vector<metadb_handle_ptr> g_index_queue;
+static bool g_indexer_running = false;
+static abort_callback_impl g_indexer_abort;
+
+bool coverage::text_is_timestamped(std::string_view text)
+{
+    size_t line_start = 0;
+    while(line_start < text.length())
+    {
+        size_t line_end = text.find_first_of("\r\n", line_start);
+        if(line_end == std::string_view::npos)
+        {
+            line_end = text.length();
+        }
+
+        const std::string_view line = text.substr(line_start, line_end - line_start);
+        const size_t tag_end = line.find(']');
+        if((line.length() > 0) && (line[0] == '[') && (tag_end != std::string_view::npos))
+        {
+            double timestamp = 0.0;
+            if(parsers::lrc::try_parse_timestamp(line.substr(0, tag_end + 1), timestamp))
+            {
+                return true;
+            }
+        }
+        line_start = line_end + 1;
+    }
+    return false;
+}
+
+static uint8_t compute_coverage(metadb_handle_ptr track, abort_callback& abort)
+{
+    const metadb_v2_rec_t track_info = track->query_v2_();
+    if(track_info.info == nullptr)
+    {
+        return CoverageFlags::None;
+    }
+    const TrackKey track_key(track_info);
+
+    uint8_t flags = CoverageFlags::None;
+    for(const GUID& source_id : { localfiles_src_guid, id3tag_src_guid })
+    {
+        // NOTE: Not every source checks for abort itself (the tag source never needs to wait on anything)
+        abort.check();
+
+        LyricSourceBase* source = LyricSourceBase::get(source_id);
+        if(source == nullptr)
+        {
+            continue;
+        }
+
+        try
+        {
+            for(LyricDataRaw& result : source->search(track, track_info, track_key, abort))
+            {
+                if(!result.lookup_id.empty() && !source->lookup(result, abort))
+                {
+                    continue;
+                }
+
+                flags |= (source_id == id3tag_src_guid) ? CoverageFlags::InTag : CoverageFlags::InLocalFile;
+                flags |= coverage::text_is_timestamped(result.text()) ? CoverageFlags::Synced : CoverageFlags::Unsynced;
+            }
+        }
+        catch(const exception_aborted&)
+        {
+            throw;
+        }
+        catch(const std::exception& e)
+        {
+            LOG_INFO("Failed to check lyric coverage of track: %s", e.what());
+        }
+    }
+
+    // NOTE: We check every track in the library, so we mustn't fill up (and repeatedly clear) the in-memory
+    //       cache of search-avoidance records that is there for the tracks that are actually being searched.
+    switch(search_avoidance_allows_search_uncached(track, track_info, track_key))
+    {
+        case SearchAvoidanceReason::MarkedInstrumental: flags |= CoverageFlags::Instrumental; break;
+        case SearchAvoidanceReason::RepeatedFailures:
+        case SearchAvoidanceReason::MatchesSkipFilter: flags |= CoverageFlags::SearchSkipped; break;
+        case SearchAvoidanceReason::Allowed:
+        default: break;
+    }
+    return flags;
+}
+
+static void dispatch_coverage_refresh(metadb_handle_list changed_tracks)
+{
+    if(changed_tracks.get_count() == 0)
+    {
+        return;
+    }
+
+    // NOTE: Anything displaying our fields will only re-evaluate them if we tell it that they changed
+    fb2k::inMainThread2([changed_tracks]()
+    {
+        metadb_io::get()->dispatch_refresh(changed_tracks);
+    });
+}
+
+static void run_indexer()
+{
+    // Indexing the whole library can take a while, and nobody is waiting on it, so stay out of the way of anything else
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+
+    size_t indexed_count = 0;
+    bool ran_out_of_tracks = false;
+    try
+    {
+        while(true)
+        {
+            std::vector<metadb_handle_ptr> batch;
+            {
+                std::lock_guard lock(g_index_queue_mutex);
+                if(g_index_queue.empty())
+                {
+                    g_indexer_running = false;
+                    g_indexer_idle.notify_all();
+                    ran_out_of_tracks = true;
+                    break;
+                }
+
+                const size_t batch_size = std::min(g_index_queue.size(), INDEX_BATCH_SIZE);
+                batch.assign(g_index_queue.end() - ptrdiff_t(batch_size), g_index_queue.end());
+                g_index_queue.resize(g_index_queue.size() - batch_size);
+            }
+
+            metadb_handle_list changed_tracks;
+            for(const metadb_handle_ptr& track : batch)
+            {
+                const uint8_t flags = compute_coverage(track, g_indexer_abort);
+
+                std::lock_guard lock(g_coverage_mutex);
+                const auto iter = g_coverage.find(track.get_ptr());
+                if((iter == g_coverage.end()) || (iter->second.flags != flags))
+                {
+                    g_coverage[track.get_ptr()] = {track, flags};
+                    changed_tracks.add_item(track);
+                }
+            }
+            indexed_count += batch.size();
+            dispatch_coverage_refresh(std::move(changed_tracks));
+        }
+    }
+    catch(const exception_aborted&)
+    {
+        LOG_INFO("Lyric coverage check was aborted");
+    }
+    catch(const std::exception& e)
+    {
+        LOG_WARN("Failed to check lyric coverage: %s", e.what());
+    }
+    catch(...)
+    {
+        LOG_WARN("Failed to check lyric coverage with an error of unrecognised type");
+    }
+
+    // NOTE: The indexer is only marked as stopped above if it ran out of tracks. If it stopped for any other
+    //       reason then we need to do so here, otherwise no new indexer would ever be started and quitting would wait on it.
+    //       We mustn't do so if we ran out of tracks though, because another indexer may have been started since then.
+    if(!ran_out_of_tracks)
+    {
+        std::lock_guard lock(g_index_queue_mutex);
+        g_indexer_running = false;
+        g_indexer_idle.notify_all();
+    }
+
+    LOG_INFO("Checked lyric coverage of %d tracks", int(indexed_count));
+}
+
+static void enqueue_for_indexing(metadb_handle_list_cref tracks)
+{
+    std::lock_guard lock(g_index_queue_mutex);
+    for(size_t i=0; i<tracks.get_count(); i++)
+    {
+        g_index_queue.push_back(tracks[i]);
+    }
+
+    if(!g_indexer_running && !g_index_queue.empty() && !g_indexer_abort.is_aborting())
+    {
+        g_indexer_running = true;
+        fb2k::splitTask(run_indexer);
+    }
+}
+
+void coverage::notify_changed(metadb_handle_ptr track)
+{
+    enqueue_for_indexing(pfc::list_single_ref_t<metadb_handle_ptr>(track));
+}
+
+class CoverageLibraryCallback : public library_callback_v2
+{
+    void on_library_initialized() override
+    {
+        metadb_handle_list all_tracks;
+        library_manager::get()->get_all_items(all_tracks);
+        LOG_INFO("Checking lyric coverage of %d tracks in the media library...", int(all_tracks.get_count()));
+        enqueue_for_indexing(all_tracks);
+    }
+
+    void on_items_added(metadb_handle_list_cref items) override
+    {
+        enqueue_for_indexing(items);
+    }
+
+    void on_items_removed(metadb_handle_list_cref items) override
+    {
+        std::lock_guard lock(g_coverage_mutex);
+        for(size_t i=0; i<items.get_count(); i++)
+        {
+            g_coverage.erase(items[i].get_ptr());
+        }
+    }
+
+    void on_items_modified(metadb_handle_list_cref items) override
+    {
+        // NOTE: Our own display refreshes also come through here, and re-checking those would never end
+        if(!library_callback::is_modified_from_hook())
+        {
+            enqueue_for_indexing(items);
+        }
+    }
+
+    void on_items_modified_v2(metadb_handle_list_cref items, metadb_io_callback_v2_data& /*data*/) override
+    {
+        on_items_modified(items);
+    }
+};
+static library_callback_factory_t<CoverageLibraryCallback> g_coverage_library_callback_factory;
+
+class CoverageIndexerQuit : public initquit
+{
+    void on_quit() override
+    {
+        g_indexer_abort.abort();
+
+        std::unique_lock lock(g_index_queue_mutex);
+        const bool finished = g_indexer_idle.wait_for(lock, std::chrono::seconds(5), [](){ return !g_indexer_running; });
+        if(!finished)
+        {
+            LOG_WARN("Timed out waiting for lyric coverage check to complete");
+        }
+    }
+};
+static initquit_factory_t<CoverageIndexerQuit> g_coverage_indexer_quit_factory;
+
+class CoverageFieldProvider : public metadb_display_field_provider
+{
+    enum Field : t_uint32
+    {
+        Status,
+        Location,
+        HasLyrics,
+
+        FieldCount
+    };
+
+    t_uint32 get_field_count() override
+    {
+        return Field::FieldCount;
+    }
+
+    void get_field_name(t_uint32 index, pfc::string_base& out) override
+    {
+        switch(index)
+        {
+            case Field::Status: out = "openlyrics_status"; break;
+            case Field::Location: out = "openlyrics_location"; break;
+            case Field::HasLyrics: out = "openlyrics_has_lyrics"; break;
+            default: uBugCheck();
+        }
+    }
+
+    bool process_field(t_uint32 index, metadb_handle* handle, titleformat_text_out* out) override
+    {
+        // NOTE: This is called while formatting titles (e.g for every visible row of a playlist)
+        //       so it must do nothing more than read what we've already indexed.
+        uint8_t flags = CoverageFlags::None;
+        {
+            std::lock_guard lock(g_coverage_mutex);
+            const auto iter = g_coverage.find(handle);
+            if(iter == g_coverage.end())
+            {
+                return false;
+            }
+            flags = iter->second.flags;
+        }
+
+        const bool has_lyrics = ((flags & (CoverageFlags::InLocalFile | CoverageFlags::InTag)) != 0);
+        switch(index)
+        {
+            case Field::Status:
+            {
+                const char* status = "missing";
+                if((flags & CoverageFlags::Synced) != 0) status = "synced";
+                else if((flags & CoverageFlags::Unsynced) != 0) status = "unsynced";
+                else if((flags & CoverageFlags::Instrumental) != 0) status = "instrumental";
+                else if((flags & CoverageFlags::SearchSkipped) != 0) status = "skipped";
+                out->write(titleformat_inputtypes::meta, status);
+                return true;
+            }
+
+            case Field::Location:
+            {
+                const bool in_file = ((flags & CoverageFlags::InLocalFile) != 0);
+                const bool in_tag = ((flags & CoverageFlags::InTag) != 0);
+                if(!in_file && !in_tag)
+                {
+                    return false;
+                }
+                out->write(titleformat_inputtypes::meta, (in_file && in_tag) ? "file+tag" : (in_file ? "file" : "tag"));
+                return true;
+            }
+
+            case Field::HasLyrics:
+            {
+                if(!has_lyrics)
+                {
+                    return false;
+                }
+                out->write(titleformat_inputtypes::meta, "1");
+                return true;
+            }
+
+            default:
+                return false;
+        }
+    }
+};
+static service_factory_single_t<CoverageFieldProvider> g_coverage_field_provider_factory;
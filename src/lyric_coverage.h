@@ -0,0 +1,18 @@
+#pragma once
+
+#include "stdafx.h"
+
+// Keeps track of which tracks in the media library have lyrics (and what kind), so that the information can be
+// shown in playlist columns etc through titleformat fields, without needing to search for lyrics while rendering:
+//   %openlyrics_status%      - "synced", "unsynced", "instrumental", "skipped" or "missing"
+//   %openlyrics_location%    - "file", "tag" or "file+tag"
+//   %openlyrics_has_lyrics%  - "1" if the track has saved lyrics, otherwise the field is not present
+// Fields are not present for tracks that have not (yet) been indexed.
+namespace coverage
+{
+    // Queues the given track to have its coverage re-checked, e.g because we just saved lyrics for it.
+    void notify_changed(metadb_handle_ptr track);
+
+    // Returns true if the given lyric text contains at least one line starting with an LRC timestamp
+    OPENLYRICS_TESTABLE_FUNC bool text_is_timestamped(std::string_view text);
+}
@@ -4,6 +4,15 @@
 
 LyricDataRaw::LyricDataRaw(LyricDataCommon common) : LyricDataCommon(common) {}
 
+std::string_view LyricDataRaw::text() const
+{
+    if(text_file != nullptr)
+    {
+        return text_file->contents();
+    }
+    return std::string_view(reinterpret_cast<const char*>(text_bytes.data()), text_bytes.size());
+}
+
 LyricDataUnstructured::LyricDataUnstructured(LyricDataCommon common) : LyricDataCommon(common) {}
 
 LyricData::LyricData(LyricDataCommon common) : LyricDataCommon(common) {}
@@ -20,9 +20,12 @@ struct LyricDataRaw : public LyricDataCommon
 {
     std::string lookup_id;           // An ID used by the source to get the lyrics text after a search. Used only temporarily during searching.
     std::vector<uint8_t> text_bytes; // The raw bytes for the lyrics text, in an unspecified encoding
+    std::shared_ptr<const MappedFile> text_file; // A file containing the raw bytes for the lyrics text, used instead of text_bytes when set
 
     LyricDataRaw() = default;
     explicit LyricDataRaw(LyricDataCommon common);
+
+    std::string_view text() const; // The raw bytes for the lyrics text, from wherever they are stored
 };
 
 // Unparsed lyric data with a known text encoding
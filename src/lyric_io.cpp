@@ -1,71 +1,124 @@
 #include "stdafx.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
 #include "logging.h"
 #include "lyric_auto_edit.h"
+#include "lyric_coverage.h"
 #include "lyric_data.h"
 #include "lyric_io.h"
 #include "metadb_index_search_avoidance.h"
 #include "parsers.h"
 #include "sources/lyric_source.h"
+#include "timer_block.h"
 #include "ui_hooks.h"
 #include "win32_util.h"
 
-bool io::save_lyrics(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, LyricData& lyrics, bool allow_overwrite, abort_callback& abort)
+static std::string serialise_lyrics(const LyricData& lyrics)
 {
-    // NOTE: We require that saving happens on the main thread because the ID3 tag updates can
-    //       only happen on the main thread.
-    core_api::ensure_main_thread();
+    const bool merge_lines = lyrics.IsTimestamped() && preferences::saving::merge_equivalent_lrc_lines();
+    return parsers::lrc::write(lyrics, merge_lines ? parsers::lrc::OutputFormat::MergedLrc : parsers::lrc::OutputFormat::Lrc);
+}
 
-    LyricSourceBase* source = LyricSourceBase::get(preferences::saving::save_source());
-    if(source == nullptr)
+// Lyrics are serialised and saved on a background thread so that saving (e.g after every track in a bulk search)
+// doesn't hold up the UI. Saves are processed in the order they were requested so that the last save always wins.
+struct QueuedSave
+{
+    LyricSourceBase* source;
+    metadb_handle_ptr track;
+    metadb_v2_rec_t track_info;
+    LyricData lyrics;
+    bool allow_overwrite;
+};
+
+static std::mutex g_save_queue_mutex;
+static std::condition_variable g_save_queue_idle;
+static std::deque<QueuedSave> g_save_queue;
+static bool g_save_worker_running = false;
+
+static void run_save_queue()
+{
+    while(true)
     {
-        LOG_WARN("Failed to load configured save source");
-        return false;
+        std::optional<QueuedSave> save;
+        {
+            std::lock_guard lock(g_save_queue_mutex);
+            if(g_save_queue.empty())
+            {
+                g_save_worker_running = false;
+                g_save_queue_idle.notify_all();
+                return;
+            }
+            save = std::move(g_save_queue.front());
+            g_save_queue.pop_front();
+        }
+
+        try
+        {
+            const std::string text = serialise_lyrics(save->lyrics);
+            save->source->save(save->track, save->track_info, save->lyrics.IsTimestamped(), text, save->allow_overwrite, fb2k::noAbort);
+            clear_search_avoidance(TrackKey(save->track_info)); // Clear here so that we will always find saved lyrics
+            coverage::notify_changed(save->track);
+        }
+        catch(const std::exception& e)
+        {
+            std::string source_name = from_tstring(save->source->friendly_name());
+            LOG_ERROR("Failed to save lyrics to %s: %s", source_name.c_str(), e.what());
+        }
     }
+}
 
-    std::string text;
-    if(lyrics.IsTimestamped() && preferences::saving::merge_equivalent_lrc_lines())
+class SaveQueueFlushOnQuit : public initquit
+{
+    void on_quit() override
     {
-        LyricData merged_lyrics = lyrics;
-        const auto lexicographic_sort = [](const auto& lhs, const auto& rhs){ return lhs.text < rhs.text; };
-        std::stable_sort(merged_lyrics.lines.begin(), merged_lyrics.lines.end(), lexicographic_sort);
-        std::vector<LyricDataLine>::iterator equal_begin = merged_lyrics.lines.begin();
-
-        while(equal_begin != merged_lyrics.lines.end())
+        // NOTE: foobar doesn't call initquit services in any particular order, so this is the only place that
+        //       flushes saves on shutdown. The queue here must be drained first because the sources only queue up
+        //       their own writes (e.g tag update batches, or files to be written in the background) when we call `save`.
         {
-            std::vector<LyricDataLine>::iterator equal_end = equal_begin + 1;
-            while((equal_end != merged_lyrics.lines.end()) && (equal_begin->text == equal_end->text) && (equal_end->timestamp != DBL_MAX))
+            std::unique_lock lock(g_save_queue_mutex);
+            if(g_save_worker_running)
             {
-                equal_end++;
+                LOG_INFO("Waiting for %d queued lyric saves to complete...", int(g_save_queue.size()));
+                const bool finished = g_save_queue_idle.wait_for(lock, std::chrono::seconds(10), [](){ return !g_save_worker_running; });
+                if(!finished)
+                {
+                    LOG_WARN("Timed out waiting for queued lyric saves to complete. %d saves were lost", int(g_save_queue.size()));
+                }
             }
+        }
 
-            // NOTE: We don't need to move equal_begin back one because we don't add
-            //       the first timestamp to the string. That'll happen as part of the
-            //       normal printing below.
-            for(auto iter=equal_end-1; iter!=equal_begin; iter--)
+        for(GUID source_id : LyricSourceBase::get_all_ids())
+        {
+            LyricSourceBase* source = LyricSourceBase::get(source_id);
+            if(source != nullptr)
             {
-                equal_begin->text = to_tstring(parsers::lrc::print_timestamp(iter->timestamp)) + equal_begin->text;
+                source->flush_pending_saves();
             }
-            equal_begin = merged_lyrics.lines.erase(equal_begin+1, equal_end);
         }
+    }
+};
+static initquit_factory_t<SaveQueueFlushOnQuit> g_save_queue_flush_factory;
 
-        const auto timestamp_sort = [](const auto& lhs, const auto& rhs){ return lhs.timestamp < rhs.timestamp; };
-        std::stable_sort(merged_lyrics.lines.begin(), merged_lyrics.lines.end(), timestamp_sort);
+bool io::save_lyrics(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, LyricData& lyrics, bool allow_overwrite)
+{
+    // NOTE: Only the save path is determined here, which is cheap. The lyrics are serialised and written on a background thread.
+    TIME_FUNCTION();
 
-        text = from_tstring(parsers::lrc::expand_text(merged_lyrics));
-    }
-    else
+    LyricSourceBase* source = LyricSourceBase::get(preferences::saving::save_source());
+    if(source == nullptr)
     {
-        text = from_tstring(parsers::lrc::expand_text(lyrics));
+        LOG_WARN("Failed to load configured save source");
+        return false;
     }
 
     try
     {
-        std::string output_path = source->save(track, track_info, lyrics.IsTimestamped(), text, allow_overwrite, abort);
-        lyrics.save_path = output_path;
+        lyrics.save_path = source->get_save_path(track, track_info, lyrics.IsTimestamped());
         lyrics.save_source = source->id();
-        clear_search_avoidance(track); // Clear here so that we will always find saved lyrics
-        return true;
     }
     catch(const std::exception& e)
     {
@@ -73,6 +126,15 @@ bool io::save_lyrics(metadb_handle_ptr track, const metadb_v2_rec_t& track_info,
         LOG_ERROR("Failed to save lyrics to %s: %s", source_name.c_str(), e.what());
         return false;
     }
+
+    std::lock_guard lock(g_save_queue_mutex);
+    g_save_queue.push_back({source, track, track_info, lyrics, allow_overwrite});
+    if(!g_save_worker_running)
+    {
+        g_save_worker_running = true;
+        fb2k::splitTask(run_save_queue);
+    }
+    return true;
 }
 
 static void ensure_windows_newlines(std::string& str)
@@ -98,7 +160,7 @@ static void ensure_windows_newlines(std::string& str)
     }
 }
 
-static std::string decode_to_utf8(const std::vector<uint8_t> text_bytes)
+static std::string decode_to_utf8(std::string_view text_bytes)
 {
     const auto GetLastErrorString = []() -> const char*
     {
@@ -110,20 +172,20 @@ static std::string decode_to_utf8(const std::vector<uint8_t> text_bytes)
 
     assert(text_bytes.size() < INT_MAX);
     int utf8success = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS,
-                                          (char*)text_bytes.data(), (int)text_bytes.size(),
+                                          text_bytes.data(), (int)text_bytes.size(),
                                           nullptr, 0);
     if(utf8success > 0)
     {
         // The input bytes are already valid UTF8, so we don't need to do any converting back-and-forth with wide chars
         LOG_INFO("Loaded lyrics already form a valid UTF-8 sequence");
-        return std::string((char*)text_bytes.data(), text_bytes.size());
+        return std::string(text_bytes);
     }
 
     std::vector<char> narrow_tmp;
     std::vector<WCHAR> wide_tmp;
 
     constexpr size_t wchar_per_byte = sizeof(wchar_t)/sizeof(uint8_t);
-    const std::wstring_view bytes_as_widestr = std::wstring_view((wchar_t*)text_bytes.data(), text_bytes.size()/wchar_per_byte);
+    const std::wstring_view bytes_as_widestr = std::wstring_view((const wchar_t*)text_bytes.data(), text_bytes.size()/wchar_per_byte);
     int narrow_bytes = wide_to_narrow_string(CP_UTF8, bytes_as_widestr, narrow_tmp);
     if(narrow_bytes > 0)
     {
@@ -152,8 +214,7 @@ static std::string decode_to_utf8(const std::vector<uint8_t> text_bytes)
         GetCPInfoExA(cp, 0, &info);
         const char* current_locale_str = (GetACP() == cp) ? " (current locale code page)" : "";
 
-        const std::string_view narrow_str((char*)text_bytes.data(), text_bytes.size());
-        int utf16_chars = narrow_to_wide_string(cp, narrow_str, wide_tmp);
+        int utf16_chars = narrow_to_wide_string(cp, text_bytes, wide_tmp);
         if(utf16_chars <= 0)
         {
             LOG_WARN("Failed to convert to codepage %u/%s%s: %d/%s", cp, info.CodePageName, current_locale_str, GetLastError(), GetLastErrorString());
@@ -181,27 +242,134 @@ static std::string decode_to_utf8(const std::vector<uint8_t> text_bytes)
 static LyricDataUnstructured raw_to_unstructured(const LyricDataRaw& raw)
 {
     LyricDataUnstructured unstructured(raw);
-    if(!raw.text_bytes.empty())
+    const std::string_view text_bytes = raw.text();
+    if(!text_bytes.empty())
     {
-        unstructured.text = decode_to_utf8(raw.text_bytes);
+        unstructured.text = decode_to_utf8(text_bytes);
         ensure_windows_newlines(unstructured.text);
     }
     return unstructured;
 }
 
+static bool lookup_search_result(LyricSourceBase* source, const std::string& friendly_name, LyricDataRaw& result, abort_callback& abort)
+{
+    bool lyrics_found = source->lookup(result, abort);
+    if(!lyrics_found)
+    {
+        LOG_INFO("Look up for lyrics from source %s returned an empty result, ignoring...", friendly_name.c_str());
+        return false;
+    }
+
+    if(result.text().empty())
+    {
+        LOG_INFO("Received empty successful lookup from source: %s", friendly_name.c_str());
+        return false;
+    }
+    return true;
+}
+
+struct ConcurrentLookup
+{
+    LyricDataRaw* result;
+    abort_callback_impl abort;
+    bool complete;
+    bool found;
+};
+
+// Looks up all of the given search results at the same time and returns the index of the first one (in the given order)
+// for which lyrics were found. Lookups that are still running when that result is found are cancelled.
+static std::optional<size_t> lookup_search_results_concurrently(LyricSourceBase* source, const std::string& friendly_name, const std::vector<LyricDataRaw*>& results, abort_callback& abort)
+{
+    std::mutex mutex;
+    std::condition_variable lookup_completed;
+    std::unique_ptr<ConcurrentLookup[]> lookups(new ConcurrentLookup[results.size()]);
+
+    for(size_t i=0; i<results.size(); i++)
+    {
+        ConcurrentLookup& lookup = lookups[i];
+        lookup.result = results[i];
+        lookup.complete = false;
+        lookup.found = false;
+
+        fb2k::splitTask([source, &friendly_name, &lookup, &mutex, &lookup_completed](){
+            bool found = false;
+            try
+            {
+                found = lookup_search_result(source, friendly_name, *lookup.result, lookup.abort);
+            }
+            catch(const std::exception& e)
+            {
+                LOG_INFO("Concurrent lookup from source %s failed: %s", friendly_name.c_str(), e.what());
+            }
+            catch(...)
+            {
+                LOG_INFO("Concurrent lookup from source %s failed with an error of unrecognised type", friendly_name.c_str());
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            lookup.found = found;
+            lookup.complete = true;
+            lookup_completed.notify_all();
+        });
+    }
+
+    std::optional<size_t> found_index;
+    std::unique_lock<std::mutex> lock(mutex);
+    size_t next_index = 0;
+    while((next_index < results.size()) && !abort.is_aborting())
+    {
+        const ConcurrentLookup& lookup = lookups[next_index];
+        if(!lookup.complete)
+        {
+            // NOTE: We wake up periodically even if nothing has completed, so that we notice if the whole search is aborted
+            lookup_completed.wait_for(lock, std::chrono::milliseconds(100));
+            continue;
+        }
+
+        if(lookup.found)
+        {
+            found_index = next_index;
+            break;
+        }
+        next_index++;
+    }
+
+    // The lookup tasks reference our local state, so we need to wait for all of them to finish before we return.
+    // We don't need the results of any that are still running though, so ask them to finish as soon as possible.
+    for(size_t i=0; i<results.size(); i++)
+    {
+        if(!lookups[i].complete)
+        {
+            lookups[i].abort.abort();
+        }
+    }
+    lookup_completed.wait(lock, [&lookups, &results]()
+    {
+        return std::all_of(lookups.get(), lookups.get() + results.size(), [](const ConcurrentLookup& lookup) { return lookup.complete; });
+    });
+
+    return found_index;
+}
+
+static std::atomic<int> g_searches_in_progress = 0;
+
 static void internal_search_for_lyrics(LyricUpdateHandle& handle, bool local_only)
 {
+    struct SearchInProgress
+    {
+        SearchInProgress() { g_searches_in_progress++; }
+        ~SearchInProgress() { g_searches_in_progress--; }
+    } search_in_progress;
+
     handle.set_started();
-    std::string tag_artist = track_metadata(handle.get_track_info(), "artist");
-    std::string tag_album = track_metadata(handle.get_track_info(), "album");
-    std::string tag_title = track_metadata(handle.get_track_info(), "title");
-    LOG_INFO("Searching for lyrics for artist='%s', album='%s', title='%s'...", tag_artist.c_str(), tag_album.c_str(), tag_title.c_str());
+    const TrackKey& track_key = handle.get_track_key();
+    LOG_INFO("Searching for lyrics for artist='%s', album='%s', title='%s'...", track_key.artist.c_str(), track_key.album.c_str(), track_key.title.c_str());
 
     // If there are no identifying tags and it's not already a local-only search, then
     // make it one because we have no way of finding the right track on any remote sources
     // anyway. The only reason we continue searching at all is that we might find lyrics
     // in the lyrics tags (which we obviously don't need an artist/album/title to check).
-    if(!local_only && tag_artist.empty() && tag_album.empty() && tag_title.empty())
+    if(!local_only && track_key.artist.empty() && track_key.album.empty() && track_key.title.empty())
     {
         LOG_INFO("No identifying metadata tags are available for this track, reverting to a local-only search");
     }
@@ -231,23 +399,18 @@ static void internal_search_for_lyrics(LyricUpdateHandle& handle, bool local_onl
             {
                 handle.set_remote_source_searched();
             }
-            std::vector<LyricDataRaw> search_results = source->search(handle.get_track(), handle.get_track_info(), handle.get_checked_abort());
+            std::vector<LyricDataRaw> search_results = source->search(handle.get_track(), handle.get_track_info(), track_key, handle.get_checked_abort());
 
+            std::vector<LyricDataRaw*> candidates;
             for(LyricDataRaw& result : search_results)
             {
-                // NOTE: Some sources don't return an album so we ignore album data if the source didn't give us any.
-                //       Similarly, the local tag data might not contain an album, in which case we shouldn't reject
-                //       candidates because they have non-empty album data.
-                bool tag_match = (result.album.empty() || tag_album.empty() || tag_values_match(tag_album, result.album)) &&
-                                 tag_values_match(tag_artist, result.artist) &&
-                                 tag_values_match(tag_title, result.title);
-                if(!tag_match)
+                if(!track_key.matches(result.artist, result.album, result.title))
                 {
                     LOG_INFO("Rejected %s search result %s/%s/%s due to tag mismatch: %s/%s/%s",
                             friendly_name.c_str(),
-                            tag_artist.c_str(),
-                            tag_album.c_str(),
-                            tag_title.c_str(),
+                            track_key.artist.c_str(),
+                            track_key.album.c_str(),
+                            track_key.title.c_str(),
                             result.artist.c_str(),
                             result.album.c_str(),
                             result.title.c_str());
@@ -255,9 +418,18 @@ static void internal_search_for_lyrics(LyricUpdateHandle& handle, bool local_onl
                 }
 
                 assert(result.source_id == source_id);
+                candidates.push_back(&result);
+            }
+
+            const size_t max_concurrent_lookups = std::max<size_t>(1, source->max_concurrent_lookups());
+            size_t candidate_index = 0;
+            while(candidate_index < candidates.size())
+            {
+                LyricDataRaw& result = *candidates[candidate_index];
                 if(result.lookup_id.empty())
                 {
-                    if(result.text_bytes.empty())
+                    candidate_index++;
+                    if(result.text().empty())
                     {
                         LOG_INFO("Source %s returned an empty lyric, skipping...", friendly_name.c_str());
                     }
@@ -267,28 +439,41 @@ static void internal_search_for_lyrics(LyricUpdateHandle& handle, bool local_onl
                         LOG_INFO("Successfully retrieved lyrics from source: %s", friendly_name.c_str());
                         break;
                     }
+                    continue;
                 }
-                else
+
+                // Look up the next few candidates together (if the source allows it) so that
+                // we don't have to wait for each one in turn when the first few have no lyrics
+                std::vector<LyricDataRaw*> lookup_batch;
+                while((candidate_index < candidates.size()) &&
+                      (lookup_batch.size() < max_concurrent_lookups) &&
+                      !candidates[candidate_index]->lookup_id.empty())
                 {
-                    bool lyrics_found = source->lookup(result, handle.get_checked_abort());
-                    if(lyrics_found)
-                    {
-                        if(result.text_bytes.empty())
-                        {
-                            LOG_INFO("Received empty successful lookup from source: %s", friendly_name.c_str());
-                        }
-                        else
-                        {
-                            lyric_data_raw = std::move(result);
-                            LOG_INFO("Successfully looked-up lyrics from source: %s", friendly_name.c_str());
-                            break;
-                        }
-                    }
-                    else
+                    lookup_batch.push_back(candidates[candidate_index]);
+                    candidate_index++;
+                }
+
+                std::optional<size_t> found_index;
+                if(lookup_batch.size() == 1)
+                {
+                    if(lookup_search_result(source, friendly_name, *lookup_batch[0], handle.get_checked_abort()))
                     {
-                        LOG_INFO("Look up for lyrics from source %s returned an empty result, ignoring...", friendly_name.c_str());
+                        found_index = 0;
                     }
                 }
+                else
+                {
+                    LOG_INFO("Looking up %d results from source %s concurrently...", int(lookup_batch.size()), friendly_name.c_str());
+                    found_index = lookup_search_results_concurrently(source, friendly_name, lookup_batch, handle.get_checked_abort());
+                    handle.get_checked_abort(); // Throw if the search was aborted while we were waiting
+                }
+
+                if(found_index.has_value())
+                {
+                    lyric_data_raw = std::move(*lookup_batch[found_index.value()]);
+                    LOG_INFO("Successfully looked-up lyrics from source: %s", friendly_name.c_str());
+                    break;
+                }
             }
         }
         catch(const std::exception& e)
@@ -300,7 +485,7 @@ static void internal_search_for_lyrics(LyricUpdateHandle& handle, bool local_onl
             LOG_ERROR("Error of unrecognised type while searching %s", friendly_name.c_str());
         }
 
-        if(!lyric_data_raw.text_bytes.empty())
+        if(!lyric_data_raw.text().empty())
         {
             break;
         }
@@ -311,16 +496,18 @@ static void internal_search_for_lyrics(LyricUpdateHandle& handle, bool local_onl
     handle.set_progress("Parsing...");
 
     const LyricDataUnstructured unstructured = raw_to_unstructured(lyric_data_raw);
+    lyric_data_raw.text_file = nullptr; // Unmap the file now that we've decoded it, it cannot be replaced (e.g by saving new lyrics) while mapped
     LyricData lyric_data = parsers::lrc::parse(unstructured);
 
     if(lyric_data.IsEmpty())
     {
-        search_avoidance_log_search_failure(handle.get_track());
+        search_avoidance_log_search_failure(handle.get_track(), track_key);
+        coverage::notify_changed(handle.get_track());
     }
     else
     {
         // Clear here so that we will continue searching even if auto-save is disabled and the user doesn't save
-        clear_search_avoidance(handle.get_track());
+        clear_search_avoidance(track_key);
     }
 
     handle.set_result(std::move(lyric_data), true);
@@ -334,6 +521,90 @@ void io::search_for_lyrics(LyricUpdateHandle& handle, bool local_only)
     });
 }
 
+// Tracks that failed to find lyrics are not searched again every time they're played (see search avoidance).
+// Instead we periodically retry them in the background once their retry delay expires, one at a time
+// and only while no other searches are running, so that lyrics that have since become available are still found.
+static const double BACKGROUND_RETRY_INTERVAL_SEC = 5.0 * 60.0;
+
+static abort_callback_impl g_background_retry_abort;
+static std::mutex g_background_retry_mutex;
+static std::condition_variable g_background_retry_idle;
+static bool g_background_retry_running = false;
+
+static void run_background_retry(metadb_handle_ptr track)
+{
+    try
+    {
+        const metadb_v2_rec_t track_info = track->query_v2_();
+        if(search_avoidance_allows_search(track, track_info, TrackKey(track_info)) == SearchAvoidanceReason::Allowed)
+        {
+            LOG_INFO("Retrying search for lyrics in the background...");
+            LyricUpdateHandle update(LyricUpdateHandle::Type::AutoSearch, track, track_info, g_background_retry_abort);
+            internal_search_for_lyrics(update, false);
+            if(!g_background_retry_abort.is_aborting())
+            {
+                io::process_available_lyric_update(update);
+            }
+        }
+    }
+    catch(const std::exception& e)
+    {
+        LOG_WARN("Failed to retry lyric search in the background: %s", e.what());
+    }
+
+    std::lock_guard lock(g_background_retry_mutex);
+    g_background_retry_running = false;
+    g_background_retry_idle.notify_all();
+}
+
+static void background_retry_tick()
+{
+    if(g_background_retry_abort.is_aborting())
+    {
+        return;
+    }
+    fb2k::callLater(BACKGROUND_RETRY_INTERVAL_SEC, background_retry_tick);
+
+    if(g_searches_in_progress > 0)
+    {
+        return;
+    }
+
+    std::lock_guard lock(g_background_retry_mutex);
+    if(g_background_retry_running)
+    {
+        return;
+    }
+
+    std::optional<metadb_handle_ptr> track = search_avoidance_take_retry_candidate();
+    if(track.has_value())
+    {
+        g_background_retry_running = true;
+        fb2k::splitTask([track = track.value()](){ run_background_retry(track); });
+    }
+}
+
+class BackgroundRetryInitQuit : public initquit
+{
+    void on_init() override
+    {
+        fb2k::callLater(BACKGROUND_RETRY_INTERVAL_SEC, background_retry_tick);
+    }
+
+    void on_quit() override
+    {
+        g_background_retry_abort.abort();
+
+        std::unique_lock lock(g_background_retry_mutex);
+        const bool finished = g_background_retry_idle.wait_for(lock, std::chrono::seconds(5), [](){ return !g_background_retry_running; });
+        if(!finished)
+        {
+            LOG_WARN("Timed out waiting for background lyric search to complete");
+        }
+    }
+};
+static initquit_factory_t<BackgroundRetryInitQuit> g_background_retry_factory;
+
 static void internal_search_for_all_lyrics_from_source(LyricUpdateHandle& handle, LyricSourceBase* source, std::string artist, std::string album, std::string title)
 {
     std::string friendly_name = from_tstring(source->friendly_name());
@@ -344,7 +615,7 @@ static void internal_search_for_all_lyrics_from_source(LyricUpdateHandle& handle
         std::vector<LyricDataRaw> search_results;
         if(source->is_local())
         {
-            search_results = source->search(handle.get_track(), handle.get_track_info(), handle.get_checked_abort());
+            search_results = source->search(handle.get_track(), handle.get_track_info(), handle.get_track_key(), handle.get_checked_abort());
         }
         else
         {
@@ -368,7 +639,7 @@ static void internal_search_for_all_lyrics_from_source(LyricUpdateHandle& handle
             std::optional<LyricDataUnstructured> lyric;
             if(result.lookup_id.empty())
             {
-                if(!result.text_bytes.empty())
+                if(!result.text().empty())
                 {
                     lyric = raw_to_unstructured(result);
                 }
@@ -376,10 +647,11 @@ static void internal_search_for_all_lyrics_from_source(LyricUpdateHandle& handle
             else
             {
                 bool lyrics_found = source->lookup(result, handle.get_checked_abort());
-                if(lyrics_found && !result.text_bytes.empty())
+                if(lyrics_found && !result.text().empty())
                 {
                     lyric = raw_to_unstructured(result);
                 }
+                result.text_file = nullptr;
             }
 
             if(lyric.has_value())
@@ -536,18 +808,11 @@ std::optional<LyricData> io::process_available_lyric_update(LyricUpdateHandle& u
             const bool should_auto_edit = should_auto_edits_be_applied(loaded_from_local_src, update.get_type());
             if(should_auto_edit)
             {
-                for(AutoEditType type : preferences::editing::automated_auto_edits())
-                {
-                    std::optional<LyricData> maybe_lyrics = auto_edit::RunAutoEdit(type, lyrics);
-                    if(maybe_lyrics.has_value())
-                    {
-                        lyrics = std::move(maybe_lyrics.value());
-                    }
-                }
+                auto_edit::RunAutoEdits(preferences::editing::automated_auto_edits(), lyrics);
             }
 
             const bool allow_overwrite = save_overwrite_allowed(update.get_type());
-            io::save_lyrics(update.get_track(), update.get_track_info(), lyrics, allow_overwrite, update.get_checked_abort());
+            io::save_lyrics(update.get_track(), update.get_track_info(), lyrics, allow_overwrite);
         }
         catch(const std::exception& e)
         {
@@ -579,7 +844,9 @@ bool io::delete_saved_lyrics(metadb_handle_ptr track, const LyricData& lyrics)
         }
 
         LOG_INFO("Lyric was saved to a local source, deleting with the saver source");
-        return source->delete_persisted(track, lyrics.save_path);
+        const bool deleted = source->delete_persisted(track, lyrics.save_path);
+        coverage::notify_changed(track);
+        return deleted;
     }
     else
     {
@@ -594,7 +861,9 @@ bool io::delete_saved_lyrics(metadb_handle_ptr track, const LyricData& lyrics)
         if(source->is_local())
         {
             LOG_INFO("Lyric was loaded from a local source, deleting with the loader source");
-            return source->delete_persisted(track, lyrics.source_path);
+            const bool deleted = source->delete_persisted(track, lyrics.source_path);
+            coverage::notify_changed(track);
+            return deleted;
         }
         else
         {
@@ -607,6 +876,7 @@ bool io::delete_saved_lyrics(metadb_handle_ptr track, const LyricData& lyrics)
 LyricUpdateHandle::LyricUpdateHandle(Type type, metadb_handle_ptr track, metadb_v2_rec_t track_info, abort_callback& abort) :
     m_track(track),
     m_track_info(track_info),
+    m_track_key(track_info),
     m_type(type),
     m_mutex({}),
     m_lyrics(),
@@ -623,6 +893,7 @@ LyricUpdateHandle::LyricUpdateHandle(Type type, metadb_handle_ptr track, metadb_
 
 LyricUpdateHandle::LyricUpdateHandle(LyricUpdateHandle&& other) :
     m_track(other.m_track),
+    m_track_key(other.m_track_key),
     m_type(other.m_type),
     m_mutex(),
     m_lyrics(std::move(other.m_lyrics)),
@@ -731,6 +1002,11 @@ const metadb_v2_rec_t& LyricUpdateHandle::get_track_info()
     return m_track_info;
 }
 
+const TrackKey& LyricUpdateHandle::get_track_key()
+{
+    return m_track_key;
+}
+
 void LyricUpdateHandle::set_started()
 {
     EnterCriticalSection(&m_mutex);
@@ -790,5 +1066,7 @@ void LyricUpdateHandle::set_complete()
     assert(complete_success);
 
     LeaveCriticalSection(&m_mutex);
+
+    repaint_all_lyric_panels(); // Panels only stop showing our progress once they've seen that we're complete
 }
 
@@ -32,6 +32,7 @@ public:
     abort_callback& get_checked_abort(); // Checks the abort flag (so it might throw) and returns it
     metadb_handle_ptr get_track();
     const metadb_v2_rec_t& get_track_info();
+    const TrackKey& get_track_key();
 
     void set_started();
     void set_progress(std::string_view value);
@@ -51,6 +52,7 @@ private:
 
     const metadb_handle_ptr m_track;
     const metadb_v2_rec_t m_track_info;
+    const TrackKey m_track_key;
     const Type m_type;
 
     CRITICAL_SECTION m_mutex;
@@ -70,8 +72,9 @@ namespace io
     std::optional<LyricData> process_available_lyric_update(LyricUpdateHandle& update);
 
     // Updates the lyric data with the ID of the source used for saving, as well as the persistence path that it reports.
+    // The lyrics themselves are written in the background, so a successful return only means that the save has been queued.
     // Returns a success flag
-    bool save_lyrics(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, LyricData& lyrics, bool allow_overwrite, abort_callback& abort);
+    bool save_lyrics(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, LyricData& lyrics, bool allow_overwrite);
 
     bool delete_saved_lyrics(metadb_handle_ptr track, const LyricData& lyrics);
 
@@ -1,8 +1,13 @@
 #include "stdafx.h"
 
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+
 #include "metadb_index_search_avoidance.h"
 
 #include "logging.h"
+#include "lyric_coverage.h"
 #include "preferences.h"
 #include "tag_util.h"
 
@@ -21,12 +26,21 @@ struct lyric_search_avoidance
     // Struct versions:
     // v1: 20 bytes
     // v2: 24 bytes
+    // v3: 32 bytes
     int failed_searches;
     t_filetimestamp first_fail_time;
     uint64_t search_config_generation;
     uint32_t flags; // Added in v2
+    t_filetimestamp next_search_time; // Added in v3
 };
 
+// The delay before the first retry of a track that failed to find lyrics, which doubles for every subsequent failure
+static const t_filetimestamp RETRY_DELAY_BASE = system_time_periods::day;
+static const int RETRY_DELAY_MAX_DOUBLINGS = 5; // ~1 month
+
+// The most failed tracks that we'll remember to retry in the background (see search_avoidance_take_retry_candidate)
+static const size_t MAX_RETRY_CANDIDATES = 1024;
+
 struct lyric_metadb_index_client : metadb_index_client
 {
     static lyric_metadb_index_client::ptr instance()
@@ -37,11 +51,7 @@ struct lyric_metadb_index_client : metadb_index_client
 
     static metadb_index_hash hash(const file_info& info)
     {
-        std::string artist = track_metadata(info, "artist");
-        std::string album = track_metadata(info, "album");
-        std::string title = track_metadata(info, "title");
-        std::string key = artist + album + title;
-        return static_api_ptr_t<hasher_md5>()->process_single_string(key.c_str()).xorHalve();
+        return TrackKey::compute_hash(track_metadata(info, "artist"), track_metadata(info, "album"), track_metadata(info, "title"));
     }
 
     static metadb_index_hash hash_handle(const metadb_handle_ptr& info)
@@ -81,12 +91,11 @@ class lyric_metadb_index_init : public init_stage_callback
 };
 static service_factory_single_t<lyric_metadb_index_init> g_lyric_metadb_index_init;
 
-static lyric_search_avoidance load_search_avoidance(metadb_handle_ptr track)
+static lyric_search_avoidance read_search_avoidance(metadb_index_hash our_index_hash)
 {
     char data_buffer[512] = {};
 
     auto meta_index = metadb_index_manager::get();
-    metadb_index_hash our_index_hash = lyric_metadb_index_client::hash_handle(track);
     size_t data_bytes = meta_index->get_user_data_here(GUID_METADBINDEX_LYRIC_HISTORY,
                                                        our_index_hash,
                                                        data_buffer,
@@ -114,6 +123,15 @@ static lyric_search_avoidance load_search_avoidance(metadb_handle_ptr track)
             reader >> result.first_fail_time;
             reader >> result.search_config_generation;
             reader >> result.flags;
+            result.next_search_time = 0;
+        }
+        else if(data_bytes == 32) // v3
+        {
+            reader >> result.failed_searches;
+            reader >> result.first_fail_time;
+            reader >> result.search_config_generation;
+            reader >> result.flags;
+            reader >> result.next_search_time;
         }
         return result;
     }
@@ -124,6 +142,155 @@ static lyric_search_avoidance load_search_avoidance(metadb_handle_ptr track)
     }
 }
 
+static void write_search_avoidance(metadb_index_hash our_index_hash, const std::optional<lyric_search_avoidance>& avoidance)
+{
+    auto meta_index = metadb_index_manager::get();
+    if(!avoidance.has_value())
+    {
+        meta_index->set_user_data(GUID_METADBINDEX_LYRIC_HISTORY, our_index_hash, nullptr, 0);
+        return;
+    }
+
+    stream_writer_formatter_simple<false> writer;
+    writer << avoidance.value().failed_searches;
+    writer << avoidance.value().first_fail_time;
+    writer << avoidance.value().search_config_generation;
+    writer << avoidance.value().flags;
+    writer << avoidance.value().next_search_time;
+
+    meta_index->set_user_data(GUID_METADBINDEX_LYRIC_HISTORY,
+                              our_index_hash,
+                              writer.m_buffer.get_ptr(),
+                              writer.m_buffer.get_size());
+}
+
+// Search avoidance is checked on every track change and updated after every failed search, so we keep the records
+// we've seen in memory rather than reading them back out of the metadb index each time. Changes are applied to the
+// in-memory copy immediately and written out to the index in the background.
+// NOTE: Records are tiny so we can afford to keep a lot of them, but we still don't want this to grow without bound
+//       while searching a large library, so just start over if it gets too big.
+static const size_t MAX_CACHED_AVOIDANCE_RECORDS = 16384;
+
+static std::mutex g_avoidance_mutex;
+static std::condition_variable g_avoidance_writes_idle;
+static std::unordered_map<metadb_index_hash, lyric_search_avoidance> g_cached_avoidance;
+static std::unordered_map<metadb_index_hash, std::optional<lyric_search_avoidance>> g_pending_avoidance_writes; // An empty value clears the record
+static bool g_avoidance_writer_running = false;
+
+struct RetryCandidate
+{
+    metadb_handle_ptr track;
+    t_filetimestamp next_search_time;
+};
+static std::unordered_map<metadb_index_hash, RetryCandidate> g_retry_candidates; // Protected by g_avoidance_mutex
+
+static void run_avoidance_writes()
+{
+    while(true)
+    {
+        std::unordered_map<metadb_index_hash, std::optional<lyric_search_avoidance>> writes;
+        {
+            std::lock_guard lock(g_avoidance_mutex);
+            if(g_pending_avoidance_writes.empty())
+            {
+                g_avoidance_writer_running = false;
+                g_avoidance_writes_idle.notify_all();
+                return;
+            }
+            writes.swap(g_pending_avoidance_writes);
+        }
+
+        for(const auto& [hash, avoidance] : writes)
+        {
+            try
+            {
+                write_search_avoidance(hash, avoidance);
+            }
+            catch(const std::exception& ex)
+            {
+                LOG_WARN("Failed to write search-avoidance info: %s", ex.what());
+            }
+        }
+    }
+}
+
+static lyric_search_avoidance load_search_avoidance(metadb_index_hash our_index_hash, bool cache_result = true)
+{
+    {
+        std::lock_guard lock(g_avoidance_mutex);
+        const auto iter = g_cached_avoidance.find(our_index_hash);
+        if(iter != g_cached_avoidance.end())
+        {
+            return iter->second;
+        }
+    }
+
+    // NOTE: We don't hold the lock while reading from the index. If the record is modified in the meantime then
+    //       the modification will already be in the cache and we won't replace it with what we just read.
+    const lyric_search_avoidance avoidance = read_search_avoidance(our_index_hash);
+    if(!cache_result)
+    {
+        return avoidance;
+    }
+
+    std::lock_guard lock(g_avoidance_mutex);
+    if(g_cached_avoidance.size() >= MAX_CACHED_AVOIDANCE_RECORDS)
+    {
+        g_cached_avoidance.clear();
+    }
+    return g_cached_avoidance.emplace(our_index_hash, avoidance).first->second;
+}
+
+static void store_search_avoidance(metadb_index_hash our_index_hash, const std::optional<lyric_search_avoidance>& avoidance)
+{
+    std::lock_guard lock(g_avoidance_mutex);
+    if(!avoidance.has_value() || ((avoidance.value().flags & AvoidanceFlags::MarkedInstrumental) != 0))
+    {
+        g_retry_candidates.erase(our_index_hash);
+    }
+
+    if(!avoidance.has_value())
+    {
+        // Lyrics are saved far more often than searches fail, so avoid writing to the index just to clear a record that is already empty
+        const auto iter = g_cached_avoidance.find(our_index_hash);
+        const bool known_empty = (iter != g_cached_avoidance.end()) &&
+                                 (iter->second.failed_searches == 0) &&
+                                 (iter->second.first_fail_time == 0) &&
+                                 (iter->second.flags == AvoidanceFlags::None);
+        if(known_empty && (g_pending_avoidance_writes.count(our_index_hash) == 0))
+        {
+            return;
+        }
+    }
+
+    if(g_cached_avoidance.size() >= MAX_CACHED_AVOIDANCE_RECORDS)
+    {
+        g_cached_avoidance.clear();
+    }
+    g_cached_avoidance[our_index_hash] = avoidance.value_or(lyric_search_avoidance{});
+    g_pending_avoidance_writes[our_index_hash] = avoidance;
+
+    if(!g_avoidance_writer_running)
+    {
+        g_avoidance_writer_running = true;
+        fb2k::splitTask(run_avoidance_writes);
+    }
+}
+
+class SearchAvoidanceFlushOnQuit : public initquit
+{
+    void on_quit() override
+    {
+        std::unique_lock lock(g_avoidance_mutex);
+        const bool finished = g_avoidance_writes_idle.wait_for(lock, std::chrono::seconds(5), [](){ return !g_avoidance_writer_running; });
+        if(!finished)
+        {
+            LOG_WARN("Timed out waiting for search-avoidance info to be written. %d updates were lost", int(g_pending_avoidance_writes.size()));
+        }
+    }
+};
+static initquit_factory_t<SearchAvoidanceFlushOnQuit> g_search_avoidance_flush_factory;
+
 bool track_matches_skip_filter(metadb_handle_ptr track, const metadb_v2_rec_t& track_info)
 {
     const pfc::string8& skip_filter_str = preferences::searching::skip_filter();
@@ -132,9 +299,8 @@ bool track_matches_skip_filter(metadb_handle_ptr track, const metadb_v2_rec_t& t
         return false;
     }
 
-    titleformat_object::ptr skip_filter;
-    const bool filter_compile_success = titleformat_compiler::get()->compile(skip_filter, skip_filter_str.c_str());
-    if(!filter_compile_success)
+    titleformat_object::ptr skip_filter = compile_titleformat_cached(skip_filter_str.c_str());
+    if(skip_filter.is_empty())
     {
         LOG_WARN("Failed to compile skip filter format: %s", skip_filter_str.c_str());
         return false;
@@ -146,7 +312,7 @@ bool track_matches_skip_filter(metadb_handle_ptr track, const metadb_v2_rec_t& t
     return !filter_result.isEmpty();
 }
 
-SearchAvoidanceReason search_avoidance_allows_search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info)
+static SearchAvoidanceReason check_search_avoidance(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, const TrackKey& track_key, bool cache_record)
 {
     if(track_is_remote(track))
     {
@@ -158,64 +324,133 @@ SearchAvoidanceReason search_avoidance_allows_search(metadb_handle_ptr track, co
         return SearchAvoidanceReason::MatchesSkipFilter;
     }
 
-    lyric_search_avoidance avoidance = load_search_avoidance(track);
+    lyric_search_avoidance avoidance = load_search_avoidance(track_key.hash, cache_record);
     if((avoidance.flags & AvoidanceFlags::MarkedInstrumental) != 0)
     {
         return SearchAvoidanceReason::MarkedInstrumental;
     }
 
-    const bool expected_to_fail = (avoidance.failed_searches > 3);
-    const bool trial_period_expired = ((avoidance.first_fail_time + system_time_periods::week) < filetimestamp_from_system_timer());
+    // NOTE: Changing the search configuration (e.g enabling a new source) makes it worth searching again immediately
     const bool same_generation = (avoidance.search_config_generation == preferences::searching::source_config_generation());
-    const bool has_repeated_failures = (same_generation && expected_to_fail && trial_period_expired);
-    if(has_repeated_failures)
+    if(same_generation && (avoidance.failed_searches > 0))
     {
-        return SearchAvoidanceReason::RepeatedFailures;
+        t_filetimestamp next_search_time = avoidance.next_search_time;
+        if(next_search_time == 0)
+        {
+            // Records written before we stored the next search time only have the time of the first failure
+            next_search_time = avoidance.first_fail_time + search_avoidance_retry_delay(avoidance.failed_searches, track_key.hash);
+        }
+
+        if(filetimestamp_from_system_timer() < next_search_time)
+        {
+            return SearchAvoidanceReason::RepeatedFailures;
+        }
     }
 
     return SearchAvoidanceReason::Allowed;
 }
 
-static void save_search_avoidance(metadb_handle_ptr track, lyric_search_avoidance avoidance)
+SearchAvoidanceReason search_avoidance_allows_search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, const TrackKey& track_key)
+{
+    return check_search_avoidance(track, track_info, track_key, true);
+}
+
+SearchAvoidanceReason search_avoidance_allows_search_uncached(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, const TrackKey& track_key)
+{
+    return check_search_avoidance(track, track_info, track_key, false);
+}
+
+static void save_search_avoidance(metadb_handle_ptr track, metadb_index_hash our_index_hash, lyric_search_avoidance avoidance)
 {
     if(track_is_remote(track))
     {
         return;
     }
 
-    auto meta_index = metadb_index_manager::get();
-    metadb_index_hash our_index_hash = lyric_metadb_index_client::hash_handle(track);
-
-    stream_writer_formatter_simple<false> writer;
-    writer << avoidance.failed_searches;
-    writer << avoidance.first_fail_time;
-    writer << avoidance.search_config_generation;
-    writer << avoidance.flags;
-
-    meta_index->set_user_data(GUID_METADBINDEX_LYRIC_HISTORY,
-                              our_index_hash,
-                              writer.m_buffer.get_ptr(),
-                              writer.m_buffer.get_size());
+    store_search_avoidance(our_index_hash, avoidance);
 }
 
-void search_avoidance_log_search_failure(metadb_handle_ptr track)
+void search_avoidance_log_search_failure(metadb_handle_ptr track, const TrackKey& track_key)
 {
     if(track_is_remote(track))
     {
         return;
     }
 
-    lyric_search_avoidance avoidance = load_search_avoidance(track);
-    avoidance.search_config_generation = preferences::searching::source_config_generation();
+    const t_filetimestamp now = filetimestamp_from_system_timer();
+    lyric_search_avoidance avoidance = load_search_avoidance(track_key.hash);
+    const uint64_t config_generation = preferences::searching::source_config_generation();
+    if(avoidance.search_config_generation != config_generation)
+    {
+        // The previous failures were with a different search configuration, so start backing off from scratch
+        avoidance.failed_searches = 0;
+        avoidance.first_fail_time = 0;
+    }
+    avoidance.search_config_generation = config_generation;
     if(avoidance.first_fail_time == 0)
     {
-        avoidance.first_fail_time = filetimestamp_from_system_timer();
+        avoidance.first_fail_time = now;
     }
     if(avoidance.failed_searches < INT_MAX)
     {
         avoidance.failed_searches++;
     }
-    save_search_avoidance(track, avoidance);
+    avoidance.next_search_time = now + search_avoidance_retry_delay(avoidance.failed_searches, track_key.hash);
+    save_search_avoidance(track, track_key.hash, avoidance);
+
+    if((avoidance.flags & AvoidanceFlags::MarkedInstrumental) == 0)
+    {
+        std::lock_guard lock(g_avoidance_mutex);
+        if((g_retry_candidates.size() < MAX_RETRY_CANDIDATES) || (g_retry_candidates.count(track_key.hash) > 0))
+        {
+            g_retry_candidates[track_key.hash] = {track, avoidance.next_search_time};
+        }
+    }
+}
+
+std::optional<metadb_handle_ptr> search_avoidance_take_retry_candidate()
+{
+    const t_filetimestamp now = filetimestamp_from_system_timer();
+
+    std::lock_guard lock(g_avoidance_mutex);
+    auto earliest = g_retry_candidates.end();
+    for(auto iter = g_retry_candidates.begin(); iter != g_retry_candidates.end(); iter++)
+    {
+        const bool eligible = (iter->second.next_search_time <= now);
+        if(eligible && ((earliest == g_retry_candidates.end()) || (iter->second.next_search_time < earliest->second.next_search_time)))
+        {
+            earliest = iter;
+        }
+    }
+
+    if(earliest == g_retry_candidates.end())
+    {
+        return {};
+    }
+
+    metadb_handle_ptr track = earliest->second.track;
+    g_retry_candidates.erase(earliest);
+    return track;
+}
+
+t_filetimestamp search_avoidance_retry_delay(int failed_searches, metadb_index_hash track_hash)
+{
+    if(failed_searches <= 0)
+    {
+        return 0;
+    }
+
+    const int doublings = std::min(failed_searches - 1, RETRY_DELAY_MAX_DOUBLINGS);
+    const t_filetimestamp delay = RETRY_DELAY_BASE << doublings;
+
+    // Scale the delay by somewhere between 80% and 120%, chosen by mixing the bits of the track hash
+    // and failure count (so that the same track gets a different amount of jitter on each failure).
+    uint64_t mix = track_hash ^ (uint64_t(failed_searches) * 0x9E3779B97F4A7C15ull);
+    mix = (mix ^ (mix >> 31)) * 0xBF58476D1CE4E5B9ull;
+    mix = mix ^ (mix >> 29);
+    const t_filetimestamp jitter_range = delay / 5;
+    const t_filetimestamp jitter = (jitter_range == 0) ? 0 : (mix % (2*jitter_range + 1));
+    return delay - jitter_range + jitter;
 }
 
 void search_avoidance_force_by_mark_instrumental(metadb_handle_ptr track)
@@ -225,22 +460,22 @@ void search_avoidance_force_by_mark_instrumental(metadb_handle_ptr track)
         return;
     }
 
-    lyric_search_avoidance avoidance = load_search_avoidance(track);
+    const metadb_index_hash our_index_hash = lyric_metadb_index_client::hash_handle(track);
+    lyric_search_avoidance avoidance = load_search_avoidance(our_index_hash);
     avoidance.flags |= AvoidanceFlags::MarkedInstrumental;
-    save_search_avoidance(track, avoidance);
+    save_search_avoidance(track, our_index_hash, avoidance);
+    coverage::notify_changed(track);
 
 #ifndef NDEBUG
     // Sanity check this in debug builds to ensure we have successfully prevented searches
-    assert(search_avoidance_allows_search(track, track->query_v2_()) == SearchAvoidanceReason::MarkedInstrumental);
+    const metadb_v2_rec_t track_info = track->query_v2_();
+    assert(search_avoidance_allows_search(track, track_info, TrackKey(track_info)) == SearchAvoidanceReason::MarkedInstrumental);
 #endif
 }
 
-void clear_search_avoidance(metadb_handle_ptr track)
+void clear_search_avoidance(const TrackKey& track_key)
 {
-    auto meta_index = metadb_index_manager::get();
-    metadb_index_hash our_index_hash = lyric_metadb_index_client::hash_handle(track);
-
-    meta_index->set_user_data(GUID_METADBINDEX_LYRIC_HISTORY, our_index_hash, nullptr, 0);
+    store_search_avoidance(track_key.hash, {});
 }
 
 const char* search_avoid_reason_to_string(SearchAvoidanceReason reason)
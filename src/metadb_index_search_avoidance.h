@@ -2,6 +2,8 @@
 
 #include "stdafx.h"
 
+#include "tag_util.h"
+
 enum class SearchAvoidanceReason
 {
     Allowed,
@@ -10,10 +12,24 @@ enum class SearchAvoidanceReason
     MatchesSkipFilter,
 };
 
-SearchAvoidanceReason search_avoidance_allows_search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info);
-void search_avoidance_log_search_failure(metadb_handle_ptr track);
-void clear_search_avoidance(metadb_handle_ptr track);
+SearchAvoidanceReason search_avoidance_allows_search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, const TrackKey& track_key);
+
+// The same as search_avoidance_allows_search, except that a record read from the metadb index is not kept in memory afterwards.
+// This is for checking many tracks at once (e.g the whole library), which would otherwise push out the records that are in use.
+SearchAvoidanceReason search_avoidance_allows_search_uncached(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, const TrackKey& track_key);
+void search_avoidance_log_search_failure(metadb_handle_ptr track, const TrackKey& track_key);
+void clear_search_avoidance(const TrackKey& track_key);
 
 void search_avoidance_force_by_mark_instrumental(metadb_handle_ptr track);
 
+// Returns a track that previously failed to find lyrics and has now waited long enough that it should be searched again,
+// if there are any. Only tracks that failed since foobar2000 was started are known. Each track is returned at most once
+// per failure, if the retry fails again then it will be returned again once its (longer) retry delay has expired.
+std::optional<metadb_handle_ptr> search_avoidance_take_retry_candidate();
+
+// Returns how long to wait before searching again for a track that has failed to find lyrics the given number of times.
+// The delay doubles with each failure (up to a limit), with some jitter derived from the track's search-avoidance hash
+// so that tracks which all failed together (e.g in a bulk search) don't all become eligible for a retry at once.
+OPENLYRICS_TESTABLE_FUNC t_filetimestamp search_avoidance_retry_delay(int failed_searches, metadb_index_hash track_hash);
+
 const char* search_avoid_reason_to_string(SearchAvoidanceReason reason);
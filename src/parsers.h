@@ -16,13 +16,129 @@ namespace lrc
 
     double get_line_first_timestamp(std::string_view line);
     std::string print_timestamp(double timestamp);
-    bool try_parse_timestamp(std::string_view tag, double& out_timestamp);
+    OPENLYRICS_TESTABLE_FUNC bool try_parse_timestamp(std::string_view tag, double& out_timestamp);
 
-    LyricData parse(const LyricDataUnstructured& input);
-    LyricDataUnstructured serialise(const LyricData& input);
+    // Sorts lines by timestamp (keeping untimed lines at the end, in their existing order) and merges lines with identical timestamps
+    void sort_lines(std::vector<LyricDataLine>& lines);
+
+    OPENLYRICS_TESTABLE_FUNC LyricData parse(const LyricDataUnstructured& input);
+    OPENLYRICS_TESTABLE_FUNC LyricDataUnstructured serialise(const LyricData& input);
 
     std::tstring expand_text(const LyricData& data);
+
+    enum class OutputFormat
+    {
+        Lrc,         // One line per timestamp, exactly as the lines are stored
+        MergedLrc,   // Lines with identical text are written once, with all of their timestamps (e.g "[00:12.34][01:23.45]Chorus")
+        EnhancedLrc, // A2 "enhanced" LRC, with word timestamps (e.g "[00:12.34]<00:12.34>Line<00:15.67>")
+        Srt,         // SubRip subtitles, for players that don't support LRC at all
+    };
+
+    // Writes the given lyrics out as UTF-8 text in the given format, in a single pass over the lines
+    OPENLYRICS_TESTABLE_FUNC std::string write(const LyricData& data, OutputFormat format);
 } // namespace lrc
 
+namespace html
+{
+    enum class TokenType
+    {
+        EndOfInput,
+        Text,
+        StartTag,
+        EndTag,
+    };
+
+    struct Token
+    {
+        TokenType type;
+        std::string_view text; // The raw (not yet entity-decoded) text for Text tokens, or the tag name for StartTag/EndTag tokens
+        std::string_view attributes; // The raw attribute text of StartTag tokens
+        bool self_closing; // True for StartTag tokens that have no content (e.g void elements like <br> or tags closed with "/>")
+    };
+
+    // A minimal pull-tokenizer for HTML documents.
+    // Tokens reference the input text directly, so tokenizing never allocates.
+    // Comments, doctypes and the contents of <script> & <style> elements are skipped entirely.
+    class OPENLYRICS_TESTABLE_FUNC Tokenizer
+    {
+    public:
+        explicit Tokenizer(std::string_view input);
+        Token next();
+
+    private:
+        std::string_view m_input;
+        size_t m_position;
+    };
+
+    OPENLYRICS_TESTABLE_FUNC bool tag_is(const Token& token, std::string_view name);
+    OPENLYRICS_TESTABLE_FUNC std::optional<std::string_view> get_attribute(std::string_view attributes, std::string_view name);
+
+    // Appends the given HTML text to the output, replacing character references with the UTF-8 text they represent
+    OPENLYRICS_TESTABLE_FUNC void append_decoded_text(std::string& output, std::string_view text);
+} // namespace html
+
+namespace json
+{
+    enum class ValueType
+    {
+        Invalid,
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object,
+    };
+
+    // A minimal single-pass pull-reader for JSON documents.
+    // Rather than building a tree of the whole document, callers walk through it and read only the values
+    // that they actually need, skipping over everything else without allocating.
+    // Every value must be consumed (with one of the read/enter functions, or skip_value) before moving on
+    // to the next key or element. Once the reader encounters malformed input every function returns false.
+    class OPENLYRICS_TESTABLE_FUNC Reader
+    {
+    public:
+        explicit Reader(std::string_view input);
+
+        ValueType peek();
+        bool failed() const;
+
+        bool enter_object();
+        bool next_key(std::string_view& out_key); // Returns false at the end of the object. Keys are returned without unescaping.
+        bool find_key(std::string_view key); // Skips over members of the current object until the given key is found. Returns false (having left the object) if it is not present.
+        bool exit_object(); // Skips over all remaining members of the current object
+
+        bool enter_array();
+        bool next_element(); // Returns false at the end of the array
+        bool exit_array(); // Skips over all remaining elements of the current array
+
+        bool read_string(std::string& out_value);
+        bool read_number(double& out_value);
+        bool read_bool(bool& out_value);
+        bool skip_value();
+        bool read_raw(std::string_view& out_value); // Skips the next value, returning its JSON text so that it can be read separately later
+
+    private:
+        void skip_whitespace();
+        bool consume(char c);
+        bool skip_string();
+        bool fail();
+
+        std::string_view m_input;
+        size_t m_position;
+        bool m_failed;
+    };
+
+    // Returns true the first time it is called with a given flag, for callers that read object members with next_key.
+    // Objects with duplicate keys should be read using only the first occurrence of each key, to match find_key
+    // (and cJSON, which we used to use to parse API responses) e.g: if((key == "id") && is_first_occurrence(seen_id))
+    inline bool is_first_occurrence(bool& seen_flag)
+    {
+        const bool first = !seen_flag;
+        seen_flag = true;
+        return first;
+    }
+} // namespace json
+
 } // namespace parsers
 
@@ -0,0 +1,114 @@
+# Generates html_entities.h, the table of named character references used by parsers::html::append_decoded_text.
+# Usage: python generate_html_entities.py (which overwrites html_entities.h in the same directory)
+#
+# The entity list is the WHATWG HTML5 list (https://html.spec.whatwg.org/entities.json), as included with Python.
+# Only the names terminated by a semicolon are included. We don't decode the "legacy" names without a semicolon
+# because in lyrics those are far more likely to be ordinary text that happens to follow an ampersand.
+#
+# The table is laid out as a minimal perfect hash ("hash and displace"): each name is first hashed into a bucket,
+# and each bucket stores the seed which sends all of the names in it to their own slot in the table.
+# A lookup is therefore two hashes of the name and a single string comparison.
+
+import html.entities
+import os
+
+FNV_OFFSET = 2166136261
+FNV_PRIME = 16777619
+
+def fnv1a(name, seed):
+    h = (FNV_OFFSET ^ seed) & 0xFFFFFFFF
+    for c in name.encode('ascii'):
+        h ^= c
+        h = (h * FNV_PRIME) & 0xFFFFFFFF
+    return h
+
+entities = sorted((name[:-1], value) for name, value in html.entities.html5.items() if name.endswith(';'))
+slot_count = len(entities)
+bucket_count = (slot_count + 3) // 4
+
+buckets = [[] for _ in range(bucket_count)]
+for entity in entities:
+    buckets[fnv1a(entity[0], 0) % bucket_count].append(entity)
+
+slots = [None] * slot_count
+seeds = [0] * bucket_count
+for bucket_index in sorted(range(bucket_count), key=lambda i: -len(buckets[i])):
+    bucket = buckets[bucket_index]
+    if not bucket:
+        continue
+    seed = 1
+    while True:
+        targets = [fnv1a(name, seed) % slot_count for name, _ in bucket]
+        if len(set(targets)) == len(targets) and all(slots[t] is None for t in targets):
+            break
+        seed += 1
+    seeds[bucket_index] = seed
+    for target, entity in zip(targets, bucket):
+        slots[target] = entity
+
+assert all(slot is not None for slot in slots)
+assert max(seeds) < 0x10000
+
+def escape(name):
+    return name.replace('\\', '\\\\').replace('"', '\\"')
+
+output_path = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'html_entities.h')
+out = open(output_path, 'w', newline='\r\n', encoding='ascii')
+out.write('#pragma once\n')
+out.write('\n')
+out.write('// NOTE: This file is generated by generate_html_entities.py, do not edit it by hand.\n')
+out.write('\n')
+out.write('#include "stdafx.h"\n')
+out.write('\n')
+out.write('namespace parsers::html::entities\n')
+out.write('{\n')
+out.write('    struct NamedReference\n')
+out.write('    {\n')
+out.write('        std::string_view name; // Excluding the leading \'&\' and trailing \';\'\n')
+out.write('        uint32_t codepoints[2]; // A few references produce two codepoints, the second is zero for all others\n')
+out.write('    };\n')
+out.write('\n')
+out.write('    constexpr uint32_t hash(std::string_view name, uint32_t seed)\n')
+out.write('    {\n')
+out.write('        uint32_t result = %du ^ seed;\n' % FNV_OFFSET)
+out.write('        for(char c : name)\n')
+out.write('        {\n')
+out.write('            result ^= static_cast<unsigned char>(c);\n')
+out.write('            result *= %du;\n' % FNV_PRIME)
+out.write('        }\n')
+out.write('        return result;\n')
+out.write('    }\n')
+out.write('\n')
+out.write('    constexpr size_t MAX_NAME_LENGTH = %d;\n' % max(len(name) for name, _ in entities))
+out.write('\n')
+out.write('    constexpr uint16_t bucket_seeds[%d] =\n' % bucket_count)
+out.write('    {\n')
+for i in range(0, bucket_count, 16):
+    out.write('        ' + ' '.join('%d,' % s for s in seeds[i:i+16]) + '\n')
+out.write('    };\n')
+out.write('\n')
+out.write('    constexpr NamedReference table[%d] =\n' % slot_count)
+out.write('    {\n')
+for name, value in slots:
+    codepoints = [ord(c) for c in value] + [0]
+    out.write('        { "%s", { 0x%X, 0x%X } },\n' % (escape(name), codepoints[0], codepoints[1]))
+out.write('    };\n')
+out.write('\n')
+out.write('    // Returns the reference with the given name, or null if there is no such reference\n')
+out.write('    constexpr const NamedReference* find(std::string_view name)\n')
+out.write('    {\n')
+out.write('        if(name.empty() || (name.length() > MAX_NAME_LENGTH))\n')
+out.write('        {\n')
+out.write('            return nullptr;\n')
+out.write('        }\n')
+out.write('\n')
+out.write('        const uint32_t seed = bucket_seeds[hash(name, 0) % std::size(bucket_seeds)];\n')
+out.write('        const NamedReference& candidate = table[hash(name, seed) % std::size(table)];\n')
+out.write('        return (candidate.name == name) ? &candidate : nullptr;\n')
+out.write('    }\n')
+out.write('\n')
+out.write('    static_assert(find("amp")->codepoints[0] == \'&\');\n')
+out.write('    static_assert(find("hellip")->codepoints[0] == 0x2026);\n')
+out.write('    static_assert(find("notanentity") == nullptr);\n')
+out.write('}\n')
+out.close()
@@ -0,0 +1,373 @@
+#include "stdafx.h"
+
+#include "parsers.h"
+#include "html_entities.h"
+
+namespace parsers::html
+{
+
+static bool is_html_whitespace(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n') || (c == '\f');
+}
+
+static char ascii_tolower(char c)
+{
+    if((c >= 'A') && (c <= 'Z'))
+    {
+        return c - 'A' + 'a';
+    }
+    return c;
+}
+
+static bool equals_ignore_case(std::string_view a, std::string_view b)
+{
+    if(a.length() != b.length())
+    {
+        return false;
+    }
+
+    for(size_t i=0; i<a.length(); i++)
+    {
+        if(ascii_tolower(a[i]) != ascii_tolower(b[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t find_ignore_case(std::string_view haystack, std::string_view needle, size_t start)
+{
+    if(needle.length() > haystack.length())
+    {
+        return std::string_view::npos;
+    }
+
+    for(size_t i=start; i<=haystack.length() - needle.length(); i++)
+    {
+        if(equals_ignore_case(haystack.substr(i, needle.length()), needle))
+        {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+static bool is_void_element(std::string_view tag_name)
+{
+    const std::string_view void_elements[] = { "area", "base", "br", "col", "embed", "hr", "img", "input", "link", "meta", "param", "source", "track", "wbr" };
+    for(std::string_view element : void_elements)
+    {
+        if(equals_ignore_case(tag_name, element))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+Tokenizer::Tokenizer(std::string_view input)
+    : m_input(input)
+    , m_position(0)
+{
+}
+
+Token Tokenizer::next()
+{
+    while(m_position < m_input.length())
+    {
+        const std::string_view remaining = m_input.substr(m_position);
+        if(remaining[0] != '<')
+        {
+            const size_t text_len = std::min(remaining.find('<'), remaining.length());
+            m_position += text_len;
+            return { TokenType::Text, remaining.substr(0, text_len), {}, false };
+        }
+
+        if(remaining.substr(0, 4) == "<!--")
+        {
+            const size_t comment_end = remaining.find("-->", 4);
+            m_position = (comment_end == std::string_view::npos) ? m_input.length() : (m_position + comment_end + 3);
+            continue;
+        }
+
+        if((remaining.length() >= 2) && ((remaining[1] == '!') || (remaining[1] == '?')))
+        {
+            // Doctypes, CDATA sections and processing instructions
+            const size_t decl_end = remaining.find('>');
+            m_position = (decl_end == std::string_view::npos) ? m_input.length() : (m_position + decl_end + 1);
+            continue;
+        }
+
+        const bool is_end_tag = (remaining.length() >= 2) && (remaining[1] == '/');
+        const size_t name_start = is_end_tag ? 2 : 1;
+        if((name_start >= remaining.length()) || !pfc::char_is_ascii_alpha(remaining[name_start]))
+        {
+            // Not actually a tag, this is just a '<' in the text.
+            // Return everything up to the next '<' as text.
+            const size_t text_len = std::min(remaining.find('<', 1), remaining.length());
+            m_position += text_len;
+            return { TokenType::Text, remaining.substr(0, text_len), {}, false };
+        }
+
+        size_t name_end = name_start;
+        while((name_end < remaining.length()) && !is_html_whitespace(remaining[name_end]) && (remaining[name_end] != '/') && (remaining[name_end] != '>'))
+        {
+            name_end++;
+        }
+        const std::string_view name = remaining.substr(name_start, name_end - name_start);
+
+        // Find the end of the tag, ignoring any '>' characters inside quoted attribute values
+        size_t tag_end = name_end;
+        char active_quote = '\0';
+        while(tag_end < remaining.length())
+        {
+            const char c = remaining[tag_end];
+            if(active_quote != '\0')
+            {
+                if(c == active_quote)
+                {
+                    active_quote = '\0';
+                }
+            }
+            else if((c == '"') || (c == '\''))
+            {
+                active_quote = c;
+            }
+            else if(c == '>')
+            {
+                break;
+            }
+            tag_end++;
+        }
+
+        if(tag_end >= remaining.length())
+        {
+            // The document ended partway through a tag
+            m_position = m_input.length();
+            break;
+        }
+        m_position += tag_end + 1;
+
+        if(is_end_tag)
+        {
+            return { TokenType::EndTag, name, {}, false };
+        }
+
+        std::string_view attributes = remaining.substr(name_end, tag_end - name_end);
+        const bool explicitly_closed = !attributes.empty() && (attributes.back() == '/');
+        if(explicitly_closed)
+        {
+            attributes.remove_suffix(1);
+        }
+        const bool self_closing = explicitly_closed || is_void_element(name);
+
+        if(!self_closing && (equals_ignore_case(name, "script") || equals_ignore_case(name, "style")))
+        {
+            // The contents of these elements are not HTML (and not text that would be displayed) so skip straight to the end tag
+            const std::string_view closer = equals_ignore_case(name, "script") ? "</script" : "</style";
+            const size_t closer_index = find_ignore_case(m_input, closer, m_position);
+            m_position = (closer_index == std::string_view::npos) ? m_input.length() : closer_index;
+        }
+
+        return { TokenType::StartTag, name, attributes, self_closing };
+    }
+
+    return { TokenType::EndOfInput, {}, {}, false };
+}
+
+bool tag_is(const Token& token, std::string_view name)
+{
+    return ((token.type == TokenType::StartTag) || (token.type == TokenType::EndTag)) && equals_ignore_case(token.text, name);
+}
+
+std::optional<std::string_view> get_attribute(std::string_view attributes, std::string_view name)
+{
+    size_t index = 0;
+    while(index < attributes.length())
+    {
+        while((index < attributes.length()) && (is_html_whitespace(attributes[index]) || (attributes[index] == '/')))
+        {
+            index++;
+        }
+
+        const size_t attr_name_start = index;
+        while((index < attributes.length()) && !is_html_whitespace(attributes[index]) && (attributes[index] != '=') && (attributes[index] != '/'))
+        {
+            index++;
+        }
+        const std::string_view attr_name = attributes.substr(attr_name_start, index - attr_name_start);
+
+        while((index < attributes.length()) && is_html_whitespace(attributes[index]))
+        {
+            index++;
+        }
+
+        std::string_view attr_value;
+        if((index < attributes.length()) && (attributes[index] == '='))
+        {
+            index++;
+            while((index < attributes.length()) && is_html_whitespace(attributes[index]))
+            {
+                index++;
+            }
+
+            if((index < attributes.length()) && ((attributes[index] == '"') || (attributes[index] == '\'')))
+            {
+                const char quote = attributes[index];
+                const size_t value_start = index + 1;
+                const size_t value_end = std::min(attributes.find(quote, value_start), attributes.length());
+                attr_value = attributes.substr(value_start, value_end - value_start);
+                index = value_end + 1;
+            }
+            else
+            {
+                const size_t value_start = index;
+                while((index < attributes.length()) && !is_html_whitespace(attributes[index]))
+                {
+                    index++;
+                }
+                attr_value = attributes.substr(value_start, index - value_start);
+            }
+        }
+
+        if(!attr_name.empty() && equals_ignore_case(attr_name, name))
+        {
+            return attr_value;
+        }
+    }
+
+    return {};
+}
+
+static void append_utf8(std::string& output, uint32_t codepoint)
+{
+    if((codepoint == 0) || (codepoint > 0x10FFFF) || ((codepoint >= 0xD800) && (codepoint <= 0xDFFF)))
+    {
+        codepoint = 0xFFFD; // The unicode replacement character
+    }
+
+    if(codepoint < 0x80)
+    {
+        output += static_cast<char>(codepoint);
+    }
+    else if(codepoint < 0x800)
+    {
+        output += static_cast<char>(0xC0 | (codepoint >> 6));
+        output += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    else if(codepoint < 0x10000)
+    {
+        output += static_cast<char>(0xE0 | (codepoint >> 12));
+        output += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        output += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    else
+    {
+        output += static_cast<char>(0xF0 | (codepoint >> 18));
+        output += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+        output += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        output += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+}
+
+// Numeric references to the C1 control characters are interpreted as windows-1252 instead (as they are by browsers),
+// because that's what the page actually meant. Old lyrics pages in particular are full of "&#146;" for apostrophes.
+static uint32_t remap_windows1252_codepoint(uint32_t codepoint)
+{
+    static const uint16_t c1_replacements[32] =
+    {
+        0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+        0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178,
+    };
+
+    if((codepoint >= 0x80) && (codepoint <= 0x9F))
+    {
+        return c1_replacements[codepoint - 0x80];
+    }
+    return codepoint;
+}
+
+static bool try_decode_numeric_reference(std::string_view reference, uint32_t& out_codepoint)
+{
+    // reference is the text between '&#' and ';'
+    const bool is_hex = !reference.empty() && ((reference[0] == 'x') || (reference[0] == 'X'));
+    if(is_hex)
+    {
+        reference.remove_prefix(1);
+    }
+    if(reference.empty() || (reference.length() > 8))
+    {
+        return false;
+    }
+
+    uint32_t value = 0;
+    for(char c : reference)
+    {
+        if(pfc::char_is_numeric(c))
+        {
+            value = value*(is_hex ? 16 : 10) + uint32_t(c - '0');
+        }
+        else if(is_hex && (ascii_tolower(c) >= 'a') && (ascii_tolower(c) <= 'f'))
+        {
+            value = value*16 + uint32_t(ascii_tolower(c) - 'a' + 10);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    out_codepoint = remap_windows1252_codepoint(value);
+    return true;
+}
+
+void append_decoded_text(std::string& output, std::string_view text)
+{
+    // Character references are short, so if we don't find a terminating ';' soon then this isn't one.
+    // This allows for the longest named reference, plus the leading '&' and trailing ';'.
+    const size_t max_reference_len = entities::MAX_NAME_LENGTH + 2;
+
+    while(!text.empty())
+    {
+        const size_t amp_index = text.find('&');
+        output += text.substr(0, amp_index);
+        if(amp_index == std::string_view::npos)
+        {
+            break;
+        }
+        text.remove_prefix(amp_index);
+
+        const size_t semicolon_index = text.substr(0, max_reference_len).find(';');
+        if(semicolon_index != std::string_view::npos)
+        {
+            const std::string_view reference = text.substr(1, semicolon_index - 1);
+            uint32_t codepoint = 0;
+            if(!reference.empty() && (reference[0] == '#') && try_decode_numeric_reference(reference.substr(1), codepoint))
+            {
+                append_utf8(output, codepoint);
+                text.remove_prefix(semicolon_index + 1);
+                continue;
+            }
+
+            const entities::NamedReference* named_ref = entities::find(reference);
+            if(named_ref != nullptr)
+            {
+                append_utf8(output, named_ref->codepoints[0]);
+                if(named_ref->codepoints[1] != 0)
+                {
+                    append_utf8(output, named_ref->codepoints[1]);
+                }
+                text.remove_prefix(semicolon_index + 1);
+                continue;
+            }
+        }
+
+        // Not a character reference that we recognise, just include it verbatim
+        output += '&';
+        text.remove_prefix(1);
+    }
+}
+
+} // namespace parsers::html
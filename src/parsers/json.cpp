@@ -0,0 +1,473 @@
+#include "stdafx.h"
+
+#include <charconv>
+
+#include "parsers.h"
+
+namespace parsers::json
+{
+
+static bool is_json_whitespace(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+static void append_utf8(std::string& output, uint32_t codepoint)
+{
+    if(codepoint < 0x80)
+    {
+        output += static_cast<char>(codepoint);
+    }
+    else if(codepoint < 0x800)
+    {
+        output += static_cast<char>(0xC0 | (codepoint >> 6));
+        output += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    else if(codepoint < 0x10000)
+    {
+        output += static_cast<char>(0xE0 | (codepoint >> 12));
+        output += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        output += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    else
+    {
+        output += static_cast<char>(0xF0 | (codepoint >> 18));
+        output += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+        output += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        output += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+}
+
+static bool try_parse_hex4(std::string_view text, uint32_t& out_value)
+{
+    if(text.length() < 4)
+    {
+        return false;
+    }
+
+    uint32_t value = 0;
+    for(size_t i=0; i<4; i++)
+    {
+        const char c = text[i];
+        uint32_t digit = 0;
+        if((c >= '0') && (c <= '9')) digit = uint32_t(c - '0');
+        else if((c >= 'a') && (c <= 'f')) digit = uint32_t(c - 'a' + 10);
+        else if((c >= 'A') && (c <= 'F')) digit = uint32_t(c - 'A' + 10);
+        else return false;
+
+        value = value*16 + digit;
+    }
+    out_value = value;
+    return true;
+}
+
+Reader::Reader(std::string_view input)
+    : m_input(input)
+    , m_position(0)
+    , m_failed(false)
+{
+}
+
+bool Reader::failed() const
+{
+    return m_failed;
+}
+
+bool Reader::fail()
+{
+    m_failed = true;
+    return false;
+}
+
+void Reader::skip_whitespace()
+{
+    while((m_position < m_input.length()) && is_json_whitespace(m_input[m_position]))
+    {
+        m_position++;
+    }
+}
+
+bool Reader::consume(char c)
+{
+    skip_whitespace();
+    if((m_position < m_input.length()) && (m_input[m_position] == c))
+    {
+        m_position++;
+        return true;
+    }
+    return false;
+}
+
+ValueType Reader::peek()
+{
+    if(m_failed)
+    {
+        return ValueType::Invalid;
+    }
+
+    skip_whitespace();
+    if(m_position >= m_input.length())
+    {
+        return ValueType::Invalid;
+    }
+
+    const char c = m_input[m_position];
+    switch(c)
+    {
+        case '{': return ValueType::Object;
+        case '[': return ValueType::Array;
+        case '"': return ValueType::String;
+        case 't':
+        case 'f': return ValueType::Bool;
+        case 'n': return ValueType::Null;
+        default:
+            if((c == '-') || ((c >= '0') && (c <= '9')))
+            {
+                return ValueType::Number;
+            }
+            return ValueType::Invalid;
+    }
+}
+
+bool Reader::enter_object()
+{
+    if(m_failed)
+    {
+        return false;
+    }
+    return consume('{') || fail();
+}
+
+bool Reader::next_key(std::string_view& out_key)
+{
+    if(m_failed)
+    {
+        return false;
+    }
+
+    if(consume('}'))
+    {
+        return false;
+    }
+    consume(','); // The first member of an object is not preceded by a comma
+
+    skip_whitespace();
+    const size_t key_start = m_position + 1;
+    if((peek() != ValueType::String) || !skip_string())
+    {
+        return fail();
+    }
+    const size_t key_end = m_position - 1;
+
+    if(!consume(':'))
+    {
+        return fail();
+    }
+
+    out_key = m_input.substr(key_start, key_end - key_start);
+    return true;
+}
+
+bool Reader::find_key(std::string_view key)
+{
+    std::string_view current_key;
+    while(next_key(current_key))
+    {
+        if(current_key == key)
+        {
+            return true;
+        }
+
+        if(!skip_value())
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool Reader::exit_object()
+{
+    std::string_view ignored_key;
+    while(next_key(ignored_key))
+    {
+        if(!skip_value())
+        {
+            return false;
+        }
+    }
+    return !m_failed;
+}
+
+bool Reader::enter_array()
+{
+    if(m_failed)
+    {
+        return false;
+    }
+    return consume('[') || fail();
+}
+
+bool Reader::next_element()
+{
+    if(m_failed)
+    {
+        return false;
+    }
+
+    if(consume(']'))
+    {
+        return false;
+    }
+    consume(','); // The first element of an array is not preceded by a comma
+    return (peek() != ValueType::Invalid) || fail();
+}
+
+bool Reader::exit_array()
+{
+    while(next_element())
+    {
+        if(!skip_value())
+        {
+            return false;
+        }
+    }
+    return !m_failed;
+}
+
+bool Reader::skip_string()
+{
+    // NOTE: Assumes that the reader is positioned on the opening quote
+    m_position++;
+    while(m_position < m_input.length())
+    {
+        const char c = m_input[m_position++];
+        if(c == '"')
+        {
+            return true;
+        }
+        else if(c == '\\')
+        {
+            m_position++;
+        }
+    }
+    return fail();
+}
+
+bool Reader::read_string(std::string& out_value)
+{
+    if(peek() != ValueType::String)
+    {
+        return fail();
+    }
+
+    out_value.clear();
+    m_position++;
+    while(m_position < m_input.length())
+    {
+        // Copy everything up to the next quote or escape in one go
+        const size_t special_index = m_input.find_first_of("\"\\", m_position);
+        if(special_index == std::string_view::npos)
+        {
+            break;
+        }
+        out_value.append(m_input.substr(m_position, special_index - m_position));
+        m_position = special_index + 1;
+
+        if(m_input[special_index] == '"')
+        {
+            return true;
+        }
+
+        if(m_position >= m_input.length())
+        {
+            break;
+        }
+        const char escaped = m_input[m_position++];
+        switch(escaped)
+        {
+            case '"': out_value += '"'; break;
+            case '\\': out_value += '\\'; break;
+            case '/': out_value += '/'; break;
+            case 'b': out_value += '\b'; break;
+            case 'f': out_value += '\f'; break;
+            case 'n': out_value += '\n'; break;
+            case 'r': out_value += '\r'; break;
+            case 't': out_value += '\t'; break;
+            case 'u':
+            {
+                uint32_t codepoint = 0;
+                if(!try_parse_hex4(m_input.substr(m_position), codepoint))
+                {
+                    return fail();
+                }
+                m_position += 4;
+
+                // Characters outside the BMP are encoded as a UTF-16 surrogate pair
+                uint32_t low_surrogate = 0;
+                if((codepoint >= 0xD800) && (codepoint <= 0xDBFF) &&
+                    (m_input.substr(m_position, 2) == "\\u") &&
+                    try_parse_hex4(m_input.substr(m_position + 2), low_surrogate) &&
+                    (low_surrogate >= 0xDC00) && (low_surrogate <= 0xDFFF))
+                {
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low_surrogate - 0xDC00);
+                    m_position += 6;
+                }
+                else if((codepoint >= 0xD800) && (codepoint <= 0xDFFF))
+                {
+                    codepoint = 0xFFFD; // An unpaired surrogate, use the unicode replacement character
+                }
+                append_utf8(out_value, codepoint);
+            } break;
+
+            default:
+                return fail();
+        }
+    }
+    return fail();
+}
+
+bool Reader::read_number(double& out_value)
+{
+    if(peek() != ValueType::Number)
+    {
+        return fail();
+    }
+
+    size_t number_end = m_position;
+    while(number_end < m_input.length())
+    {
+        const char c = m_input[number_end];
+        if(((c >= '0') && (c <= '9')) || (c == '-') || (c == '+') || (c == '.') || (c == 'e') || (c == 'E'))
+        {
+            number_end++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    const char* number_ptr = m_input.data() + m_position;
+    const char* number_end_ptr = m_input.data() + number_end;
+    const std::from_chars_result result = std::from_chars(number_ptr, number_end_ptr, out_value);
+    if((result.ec != std::errc()) || (result.ptr != number_end_ptr))
+    {
+        return fail();
+    }
+
+    m_position = number_end;
+    return true;
+}
+
+bool Reader::read_bool(bool& out_value)
+{
+    if(peek() != ValueType::Bool)
+    {
+        return fail();
+    }
+
+    const std::string_view remaining = m_input.substr(m_position);
+    if(remaining.substr(0, 4) == "true")
+    {
+        out_value = true;
+        m_position += 4;
+        return true;
+    }
+    else if(remaining.substr(0, 5) == "false")
+    {
+        out_value = false;
+        m_position += 5;
+        return true;
+    }
+    return fail();
+}
+
+bool Reader::skip_value()
+{
+    switch(peek())
+    {
+        case ValueType::String:
+            return skip_string();
+
+        case ValueType::Number:
+        {
+            double ignored = 0.0;
+            return read_number(ignored);
+        }
+
+        case ValueType::Bool:
+        {
+            bool ignored = false;
+            return read_bool(ignored);
+        }
+
+        case ValueType::Null:
+        {
+            if(m_input.substr(m_position, 4) != "null")
+            {
+                return fail();
+            }
+            m_position += 4;
+            return true;
+        }
+
+        case ValueType::Object:
+        case ValueType::Array:
+        {
+            // We don't care about the contents so just find the matching close bracket,
+            // without checking that everything in between is well-formed.
+            int depth = 0;
+            while(m_position < m_input.length())
+            {
+                const char c = m_input[m_position];
+                if(c == '"')
+                {
+                    if(!skip_string())
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+
+                m_position++;
+                if((c == '{') || (c == '['))
+                {
+                    depth++;
+                }
+                else if((c == '}') || (c == ']'))
+                {
+                    depth--;
+                    if(depth == 0)
+                    {
+                        return true;
+                    }
+                }
+            }
+            return fail();
+        }
+
+        case ValueType::Invalid:
+        default:
+            return fail();
+    }
+}
+
+bool Reader::read_raw(std::string_view& out_value)
+{
+    if(peek() == ValueType::Invalid)
+    {
+        return fail();
+    }
+
+    const size_t value_start = m_position;
+    if(!skip_value())
+    {
+        return false;
+    }
+
+    out_value = m_input.substr(value_start, m_position - value_start);
+    return true;
+}
+
+} // namespace parsers::json
@@ -1,5 +1,7 @@
 #include "stdafx.h"
 
+#include <unordered_map>
+
 #include "logging.h"
 #include "lyric_data.h"
 #include "parsers.h"
@@ -182,25 +184,56 @@ struct LineTimeParseResult
     size_t charsConsumed;
 };
 
-std::string print_timestamp(double timestamp)
+static void append_padded_number(std::string& output, int value, int min_digits)
 {
-    double total_seconds_flt = std::floor(timestamp);
-    int total_seconds = static_cast<int>(total_seconds_flt);
-    int time_hours = total_seconds/3600;
-    int time_minutes = (total_seconds - 3600*time_hours)/60;
-    int time_seconds = total_seconds - (time_hours*3600) - (time_minutes*60);
-    int time_centisec = static_cast<int>((timestamp - total_seconds_flt) * 100.0);
+    char digits[16] = {};
+    int digit_count = 0;
+    do
+    {
+        digits[digit_count++] = static_cast<char>('0' + (value % 10));
+        value /= 10;
+    } while(value > 0);
 
-    char temp[32];
-    if(time_hours == 0)
+    for(int i=digit_count; i<min_digits; i++)
     {
-        snprintf(temp, sizeof(temp), "[%02d:%02d.%02d]", time_minutes, time_seconds, time_centisec);
+        output += '0';
     }
-    else
+    while(digit_count > 0)
+    {
+        output += digits[--digit_count];
+    }
+}
+
+// Appends the timestamp in the form used by LRC files (e.g "[01:23.45]"), enclosed in the given brackets
+static void append_timestamp(std::string& output, double timestamp, char open_bracket, char close_bracket)
+{
+    timestamp = max(0.0, timestamp);
+    const double total_seconds_flt = std::floor(timestamp);
+    const int total_seconds = static_cast<int>(total_seconds_flt);
+    const int time_hours = total_seconds/3600;
+    const int time_minutes = (total_seconds - 3600*time_hours)/60;
+    const int time_seconds = total_seconds - (time_hours*3600) - (time_minutes*60);
+    const int time_centisec = static_cast<int>((timestamp - total_seconds_flt) * 100.0);
+
+    output += open_bracket;
+    if(time_hours != 0)
     {
-        snprintf(temp, sizeof(temp), "[%02d:%02d:%02d.%02d]", time_hours, time_minutes, time_seconds, time_centisec);
+        append_padded_number(output, time_hours, 2);
+        output += ':';
     }
-    return std::string(temp);
+    append_padded_number(output, time_minutes, 2);
+    output += ':';
+    append_padded_number(output, time_seconds, 2);
+    output += '.';
+    append_padded_number(output, time_centisec, 2);
+    output += close_bracket;
+}
+
+std::string print_timestamp(double timestamp)
+{
+    std::string result;
+    append_timestamp(result, timestamp, '[', ']');
+    return result;
 }
 
 bool try_parse_timestamp(std::string_view tag, double& out_timestamp)
@@ -359,6 +392,15 @@ std::vector<LyricDataLine> collapse_concurrent_lines(const std::vector<LyricData
     });
 }
 
+void sort_lines(std::vector<LyricDataLine>& lines)
+{
+    std::stable_sort(lines.begin(), lines.end(), [](const LyricDataLine& a, const LyricDataLine& b)
+    {
+        return a.timestamp < b.timestamp;
+    });
+    lines = collapse_concurrent_lines(lines);
+}
+
 LyricData parse(const LyricDataUnstructured& input)
 {
     LOG_INFO("Parsing LRC lyric text...");
@@ -447,11 +489,7 @@ LyricData parse(const LyricDataUnstructured& input)
         }
     }
 
-    std::stable_sort(lines.begin(), lines.end(), [](const LyricDataLine& a, const LyricDataLine& b)
-    {
-        return a.timestamp < b.timestamp;
-    });
-    lines = collapse_concurrent_lines(lines);
+    sort_lines(lines);
 
     LyricData result(input);
     result.tags = std::move(tags);
@@ -525,4 +563,207 @@ std::tstring expand_text(const LyricData& data)
     return expanded_text;
 }
 
+static void append_tags(std::string& output, const LyricData& data)
+{
+    for(const std::string& tag : data.tags)
+    {
+        output += tag;
+        output += "\r\n";
+    }
+    if(!data.tags.empty())
+    {
+        output += "\r\n";
+    }
+}
+
+// Appends each of the (newline-separated) lines in the given text, with the given prefix and suffix on every one of them.
+// NOTE: Ordinarily a single line contains no newlines. However if two lines in an lrc file have identical timestamps,
+//       then we merge them during parsing. In that case we need to split them out again here.
+static void append_split_lines(std::string& output, std::string_view prefix, std::string_view text, std::string_view suffix)
+{
+    size_t start_index = 0;
+    while(start_index <= text.length()) // This is specifically less-or-equal so that empty lines are still written
+    {
+        const size_t end_index = min(text.length(), text.find('\n', start_index));
+        output += prefix;
+        output += text.substr(start_index, end_index - start_index);
+        output += suffix;
+        output += "\r\n";
+        start_index = end_index + 1;
+    }
+}
+
+// Returns the index of the first line after the given one that starts at a later time, or the line count if there is no such line
+static size_t find_next_later_line(const LyricData& data, size_t line_index)
+{
+    size_t next_index = line_index + 1;
+    while((next_index < data.lines.size()) && (data.lines[next_index].timestamp <= data.lines[line_index].timestamp))
+    {
+        next_index++;
+    }
+    return next_index;
+}
+
+static void write_lrc(std::string& output, const LyricData& data)
+{
+    append_tags(output, data);
+
+    std::string prefix;
+    for(const LyricDataLine& line : data.lines)
+    {
+        prefix.clear();
+        if(line.timestamp != DBL_MAX)
+        {
+            append_timestamp(prefix, line.timestamp, '[', ']');
+        }
+        append_split_lines(output, prefix, from_tstring(line.text), {});
+    }
+}
+
+static void write_merged_lrc(std::string& output, const LyricData& data)
+{
+    // Every timed line is linked to the next line with identical text, so that we can write out all the timestamps
+    // for each distinct text at its first occurrence. Untimed lines are never merged, they have no timestamps to merge.
+    const size_t no_line = SIZE_MAX;
+    const size_t line_count = data.lines.size();
+    std::vector<size_t> next_equal_line(line_count, no_line);
+    std::vector<bool> is_merged(line_count, false);
+    std::unordered_map<std::tstring_view, size_t> last_line_with_text;
+    last_line_with_text.reserve(line_count);
+    for(size_t i=0; i<line_count; i++)
+    {
+        const LyricDataLine& line = data.lines[i];
+        if(line.timestamp == DBL_MAX)
+        {
+            continue;
+        }
+
+        const auto [iter, inserted] = last_line_with_text.try_emplace(line.text, i);
+        if(!inserted)
+        {
+            next_equal_line[iter->second] = i;
+            is_merged[i] = true;
+            iter->second = i;
+        }
+    }
+
+    append_tags(output, data);
+
+    std::string prefix;
+    for(size_t i=0; i<line_count; i++)
+    {
+        if(is_merged[i])
+        {
+            continue;
+        }
+
+        prefix.clear();
+        if(data.lines[i].timestamp != DBL_MAX)
+        {
+            for(size_t equal_index=i; equal_index!=no_line; equal_index=next_equal_line[equal_index])
+            {
+                append_timestamp(prefix, data.lines[equal_index].timestamp, '[', ']');
+            }
+        }
+        append_split_lines(output, prefix, from_tstring(data.lines[i].text), {});
+    }
+}
+
+static void write_enhanced_lrc(std::string& output, const LyricData& data)
+{
+    append_tags(output, data);
+
+    // NOTE: We don't know when individual words are sung, so each line is written as a single "word" that lasts
+    //       from the start of the line until the start of the next one.
+    std::string prefix;
+    std::string suffix;
+    for(size_t i=0; i<data.lines.size(); i++)
+    {
+        const LyricDataLine& line = data.lines[i];
+        prefix.clear();
+        suffix.clear();
+        if((line.timestamp != DBL_MAX) && !line.text.empty())
+        {
+            append_timestamp(prefix, line.timestamp, '[', ']');
+            append_timestamp(prefix, line.timestamp, '<', '>');
+
+            const size_t next_index = find_next_later_line(data, i);
+            if((next_index < data.lines.size()) && (data.lines[next_index].timestamp != DBL_MAX))
+            {
+                append_timestamp(suffix, data.lines[next_index].timestamp, '<', '>');
+            }
+        }
+        else if(line.timestamp != DBL_MAX)
+        {
+            append_timestamp(prefix, line.timestamp, '[', ']');
+        }
+        append_split_lines(output, prefix, from_tstring(line.text), suffix);
+    }
+}
+
+static void append_srt_time(std::string& output, double timestamp)
+{
+    const int64_t total_millisec = static_cast<int64_t>(std::llround(max(0.0, timestamp) * 1000.0));
+    const int64_t total_seconds = total_millisec/1000;
+    append_padded_number(output, static_cast<int>(total_seconds/3600), 2);
+    output += ':';
+    append_padded_number(output, static_cast<int>((total_seconds/60) % 60), 2);
+    output += ':';
+    append_padded_number(output, static_cast<int>(total_seconds % 60), 2);
+    output += ',';
+    append_padded_number(output, static_cast<int>(total_millisec % 1000), 3);
+}
+
+static void write_srt(std::string& output, const LyricData& data)
+{
+    // SRT has no way to express the last line's end time other than giving it one explicitly, so we just pick a reasonable-looking duration
+    const double final_line_duration = 5.0;
+
+    // NOTE: SRT has no equivalent of the LRC offset tag, so it is applied to the cue times directly.
+    //       Untimed lines and empty lines are skipped because they would not be displayed anyway.
+    int cue_number = 1;
+    for(size_t i=0; i<data.lines.size(); i++)
+    {
+        const LyricDataLine& line = data.lines[i];
+        if((line.timestamp == DBL_MAX) || line.text.empty())
+        {
+            continue;
+        }
+
+        const size_t next_index = find_next_later_line(data, i);
+        const double start_time = data.LineTimestamp(i);
+        double end_time = start_time + final_line_duration;
+        if((next_index < data.lines.size()) && (data.lines[next_index].timestamp != DBL_MAX))
+        {
+            end_time = data.LineTimestamp(next_index);
+        }
+
+        append_padded_number(output, cue_number++, 1);
+        output += "\r\n";
+        append_srt_time(output, start_time);
+        output += " --> ";
+        append_srt_time(output, end_time);
+        output += "\r\n";
+        append_split_lines(output, {}, from_tstring(line.text), {});
+        output += "\r\n";
+    }
+}
+
+std::string write(const LyricData& data, OutputFormat format)
+{
+    std::string output;
+    output.reserve(data.lines.size() * 64); // NOTE: 64 is an arbitrary "probably longer than most lines" value
+    switch(format)
+    {
+        case OutputFormat::Lrc: write_lrc(output, data); break;
+        case OutputFormat::MergedLrc: write_merged_lrc(output, data); break;
+        case OutputFormat::EnhancedLrc: write_enhanced_lrc(output, data); break;
+        case OutputFormat::Srt: write_srt(output, data); break;
+        default:
+            LOG_WARN("Unrecognised lyric output format: %d", int(format));
+            break;
+    }
+    return output;
+}
+
 } // namespace parsers::lrc
@@ -115,6 +115,8 @@ namespace preferences
 
         std::string_view untimed_tag();
         std::string_view timestamped_tag();
+        size_t tag_batch_size();
+        double tag_batch_interval_seconds();
 
         bool merge_equivalent_lrc_lines();
 
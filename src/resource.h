@@ -101,6 +101,8 @@
 #define IDC_SEARCH_SKIP_FILTER_OUTPUT   1122
 #define IDC_SEARCH_SYNTAX_HELP          1123
 #define IDC_SEARCH_SKIP_FILTER_RESULT   1124
+#define IDC_SAVE_TAG_BATCH_SIZE         1126
+#define IDC_SAVE_TAG_BATCH_INTERVAL     1127
 
 // Next default values for new objects
 // 
@@ -108,7 +110,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        129
 #define _APS_NEXT_COMMAND_VALUE         40001
-#define _APS_NEXT_CONTROL_VALUE         1126
+#define _APS_NEXT_CONTROL_VALUE         1128
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
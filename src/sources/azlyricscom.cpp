@@ -1,13 +1,11 @@
 #include "stdafx.h"
 #include <cctype>
 
-#include "tidy.h"
-#include "tidybuffio.h"
-#include "pugixml.hpp"
-
+#include "http_cache.h"
 #include "logging.h"
 #include "lyric_data.h"
 #include "lyric_source.h"
+#include "scrape_rules.h"
 #include "tag_util.h"
 
 static const GUID src_guid = { 0xadf3a1ba, 0x7e88, 0x4539, { 0xaf, 0x9e, 0xa8, 0xc4, 0xbc, 0x62, 0x98, 0xf1 } };
@@ -40,6 +38,22 @@ static std::string remove_chars_for_url(const std::string_view input)
     return output;
 }
 
+static scrape::RuleSet azlyrics_rules()
+{
+    // The lyrics are the direct text children of the first div *without* a class attribute
+    // that comes after (and is a sibling of) the div with class "lyricsh".
+    scrape::RuleSet rules = {};
+    rules.url_template = "https://www.azlyrics.com/lyrics/{artist}/{title}.html";
+    rules.url_component = remove_chars_for_url;
+    rules.container = "div:not([class])";
+    rules.container_follows = "div[class=lyricsh]";
+    rules.text_scope = scrape::TextScope::DirectChildren;
+    rules.text_trim = scrape::TextTrim::Whitespace;
+    rules.newline_after_container = false;
+    return rules;
+}
+static const scrape::CompiledRuleSet g_rules(azlyrics_rules());
+
 std::vector<LyricDataRaw> AZLyricsComSource::search(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort)
 {
     // NOTE: It seems that if we let the user-agent indicate a browser that is sufficiently far out of date, we get served a captcha.
@@ -66,16 +80,13 @@ std::vector<LyricDataRaw> AZLyricsComSource::search(std::string_view artist, std
     http_request::ptr request = http_client::get()->create_request("GET");
     request->add_header("User-Agent", useragent);
 
-    std::string url_artist = remove_chars_for_url(artist);
-    std::string url_title = remove_chars_for_url(title);
-    std::string url = "https://www.azlyrics.com/lyrics/" + url_artist + "/" + url_title + ".html";;
+    const std::string url = g_rules.format_url(artist, album, title);
     LOG_INFO("Querying for lyrics from %s...", url.c_str());
 
-    pfc::string8 content;
+    std::string content;
     try
     {
-        file_ptr response_file = request->run(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
+        content = http_cache::get(request, url, abort);
         // NOTE: We're assuming here that the response is encoded in UTF-8 
     }
     catch(const std::exception& e)
@@ -84,85 +95,7 @@ std::vector<LyricDataRaw> AZLyricsComSource::search(std::string_view artist, std
         return {};
     }
 
-    std::string lyric_text;
-    TidyBuffer tidy_output = {};
-    TidyBuffer tidy_error = {};
-
-    TidyDoc tidy_doc = tidyCreate();
-    tidySetErrorBuffer(tidy_doc, &tidy_error);
-    tidyOptSetBool(tidy_doc, TidyXhtmlOut, yes);
-    tidyOptSetBool(tidy_doc, TidyForceOutput, yes);
-    tidyParseString(tidy_doc, content.c_str());
-    tidyCleanAndRepair(tidy_doc);
-    tidyRunDiagnostics(tidy_doc);
-    tidySaveBuffer(tidy_doc, &tidy_output);
-
-    if(tidyErrorCount(tidy_doc) == 0)
-    {
-        pugi::xml_document doc;
-        doc.load_buffer(tidy_output.bp, tidy_output.size);
-
-        pugi::xpath_query query_lyricdivs("//div[@class='lyricsh']");
-        pugi::xpath_node_set lyricdivs = query_lyricdivs.evaluate_node_set(doc);
-        if(!lyricdivs.empty())
-        {
-            pugi::xml_node target_node;
-            for(const pugi::xpath_node& node : lyricdivs)
-            {
-                if(node.node().type() == pugi::node_element)
-                {
-                    target_node = node.node();
-                    break;
-                }
-            }
-            while(target_node.type() != pugi::node_null)
-            {
-                const auto attr_is_class = [](const pugi::xml_attribute& attr) { return strcmp(attr.name(), "class") == 0; };
-                bool is_div = (strcmp(target_node.name(), "div") == 0);
-                bool has_class = std::find_if(target_node.attributes_begin(), target_node.attributes_end(), attr_is_class) != target_node.attributes_end();
-                if(is_div && !has_class)
-                {
-                    break;
-                }
-
-                target_node = target_node.next_sibling();
-            }
-
-            if(target_node.type() != pugi::node_null)
-            {
-                for(const pugi::xml_node& child : target_node.children())
-                {
-                    if(child.type() == pugi::node_pcdata)
-                    {
-                        // We assume the text is already UTF-8
-                        std::string_view line_text = trim_surrounding_whitespace(child.value());
-                        lyric_text += line_text;
-                    }
-                    else if(child.type() == pugi::node_element)
-                    {
-                        if(strcmp(child.name(), "br") == 0)
-                        {
-                            lyric_text += "\r\n";
-                        }
-                    }
-                }
-            }
-        }
-        else
-        {
-            LOG_INFO("No appropriate lyric header divs found on page: %s", url.c_str());
-        }
-    }
-    else
-    {
-        tidyErrorSummary(tidy_doc); // Write more complete error info to the error_buffer
-        LOG_INFO("Failed to convert retrieved HTML from %s to XHTML:\n%s", url.c_str(), tidy_error.bp);
-    }
-
-    tidyBufFree(&tidy_output);
-    tidyBufFree(&tidy_error);
-    tidyRelease(tidy_doc);
-
+    const std::string lyric_text = g_rules.extract(content, title);
     if(lyric_text.empty())
     {
         throw new std::runtime_error("Failed to parse lyrics, the page format may have changed");
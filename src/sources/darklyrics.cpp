@@ -1,12 +1,12 @@
 #include "stdafx.h"
 #include <cctype>
+#include <list>
+#include <mutex>
 
-#include "tidy.h"
-#include "tidybuffio.h"
-#include "pugixml.hpp"
-
+#include "http_cache.h"
 #include "logging.h"
 #include "lyric_source.h"
+#include "scrape_rules.h"
 #include "tag_util.h"
 
 static const GUID src_guid = { 0x5901c128, 0xc67f, 0x4eec, { 0x8f, 0x10, 0x47, 0x5d, 0x12, 0x52, 0x89, 0xe9 } };
@@ -16,7 +16,6 @@ class DarkLyricsSource : public LyricSourceRemote
     const GUID& id() const final { return src_guid; }
     std::tstring_view friendly_name() const final { return _T("DarkLyrics.com"); }
 
-    void add_all_text_to_string(std::string& output, pugi::xml_node node) const;
     std::vector<LyricDataRaw> search(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort) final;
     bool lookup(LyricDataRaw& data, abort_callback& abort) final;
 };
@@ -40,131 +39,116 @@ static std::string remove_chars_for_url(const std::string_view input)
     return output;
 }
 
-void DarkLyricsSource::add_all_text_to_string(std::string& output, pugi::xml_node node) const
+static scrape::RuleSet darklyrics_rules()
 {
-    if(node.type() == pugi::node_null)
-    {
-        return;
-    }
+    // Album pages contain a single div with class "lyrics" that contains the lyrics for every track.
+    // Each track starts with a header of the form: <h3><a name="3">3. Track Title</a></h3>
+    // which is followed by the lyric text (separated by <br> tags) for that track.
+    scrape::RuleSet rules = {};
+    rules.url_template = "http://darklyrics.com/lyrics/{artist}/{album}.html";
+    rules.url_component = remove_chars_for_url;
+    rules.container = "div[class=lyrics]";
+    rules.track_header = "h3";
+    rules.track_title = "a[name]";
+    rules.text_scope = scrape::TextScope::Descendants;
+    rules.text_trim = scrape::TextTrim::Whitespace;
+    rules.newline_after_container = false;
+    return rules;
+}
+static const scrape::CompiledRuleSet g_rules(darklyrics_rules());
 
-    pugi::xml_node current = node;
-    while(current != nullptr)
+// Album pages contain the lyrics for every track on the album, so when we download one we keep all of them.
+// Tracks from the same album are usually played (or bulk-searched) together, so this lets us find the
+// lyrics for the rest of the album without making any more requests.
+struct CachedAlbum
+{
+    std::string url;
+    std::vector<scrape::ExtractedTrack> tracks;
+};
+static const size_t MAX_CACHED_ALBUMS = 16;
+static std::mutex g_album_cache_mutex;
+static std::list<CachedAlbum> g_album_cache; // Ordered from most- to least-recently used
+
+static std::string find_track_text(const std::vector<scrape::ExtractedTrack>& tracks, std::string_view title)
+{
+    for(const scrape::ExtractedTrack& track : tracks)
     {
-        if(current.type() == pugi::node_pcdata)
+        if(tag_values_match(track.title, title))
         {
-            // We assume the text is already UTF-8
-            std::string_view node_text = trim_surrounding_whitespace(current.value());
-            output += node_text;
+            return track.text;
         }
-        else if(current.type() == pugi::node_element)
+    }
+    return {};
+}
+
+static std::optional<std::string> find_cached_track_text(const std::string& url, std::string_view title)
+{
+    std::lock_guard lock(g_album_cache_mutex);
+    for(auto iter = g_album_cache.begin(); iter != g_album_cache.end(); iter++)
+    {
+        if(iter->url == url)
         {
-            const std::string_view current_name = current.name();
-            if(current_name == "br")
-            {
-                output += "\r\n";
-            }
-            else if((current_name == "h3") || (current_name == "div"))
-            {
-                break;
-            }
-            else
-            {
-                add_all_text_to_string(output, current.first_child());
-            }
+            g_album_cache.splice(g_album_cache.begin(), g_album_cache, iter);
+            return find_track_text(g_album_cache.front().tracks, title);
         }
+    }
+    return {};
+}
 
-        current = current.next_sibling();
+static void add_cached_album(const std::string& url, std::vector<scrape::ExtractedTrack> tracks)
+{
+    std::lock_guard lock(g_album_cache_mutex);
+    const auto url_matches = [&url](const CachedAlbum& album) { return album.url == url; };
+    g_album_cache.remove_if(url_matches); // In case another search downloaded the same album at the same time
+    g_album_cache.push_front({url, std::move(tracks)});
+    if(g_album_cache.size() > MAX_CACHED_ALBUMS)
+    {
+        g_album_cache.pop_back();
     }
 }
 
 std::vector<LyricDataRaw> DarkLyricsSource::search(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort)
 {
-    http_request::ptr request = http_client::get()->create_request("GET");
-
-    const std::string url_artist = remove_chars_for_url(artist);
-    const std::string url_album = remove_chars_for_url(album);
-    const std::string url_title = remove_chars_for_url(title);
-    const std::string url = "http://darklyrics.com/lyrics/" + url_artist + "/" + url_album + ".html";
-    LOG_INFO("Querying for lyrics from %s...", url.c_str());
-
-    pfc::string8 content;
-    try
+    const std::string url = g_rules.format_url(artist, album, title);
+    std::optional<std::string> lyric_text = find_cached_track_text(url, title);
+    if(lyric_text.has_value())
     {
-        file_ptr response_file = request->run(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
-        // NOTE: We're assuming here that the response is encoded in UTF-8 
+        LOG_INFO("Using previously-harvested lyrics from %s", url.c_str());
     }
-    catch(const std::exception& e)
+    else
     {
-        LOG_WARN("Failed to download darklyrics.com page %s: %s", url.c_str(), e.what());
-        return {};
-    }
-
-    std::string lyric_text;
-    TidyBuffer tidy_output = {};
-    TidyBuffer tidy_error = {};
+        LOG_INFO("Querying for lyrics from %s...", url.c_str());
 
-    TidyDoc tidy_doc = tidyCreate();
-    tidySetErrorBuffer(tidy_doc, &tidy_error);
-    tidyOptSetBool(tidy_doc, TidyXhtmlOut, yes);
-    tidyOptSetBool(tidy_doc, TidyForceOutput, yes);
-    tidyParseString(tidy_doc, content.c_str());
-    tidyCleanAndRepair(tidy_doc);
-    tidyRunDiagnostics(tidy_doc);
-    tidySaveBuffer(tidy_doc, &tidy_output);
-
-    if(tidyErrorCount(tidy_doc) == 0)
-    {
-        pugi::xml_document doc;
-        doc.load_buffer(tidy_output.bp, tidy_output.size);
+        std::string content;
+        try
+        {
+            http_request::ptr request = http_client::get()->create_request("GET");
+            content = http_cache::get(request, url, abort);
+            // NOTE: We're assuming here that the response is encoded in UTF-8
+        }
+        catch(const std::exception& e)
+        {
+            LOG_WARN("Failed to download darklyrics.com page %s: %s", url.c_str(), e.what());
+            return {};
+        }
 
-        pugi::xpath_query query_lyricdivs("//div[@class='lyrics']/h3/a[@name]");
-        pugi::xpath_node_set lyricdivs = query_lyricdivs.evaluate_node_set(doc);
-        if(!lyricdivs.empty())
+        std::vector<scrape::ExtractedTrack> album_tracks = g_rules.extract_tracks(content);
+        LOG_INFO("Harvested lyrics for %d tracks from %s", int(album_tracks.size()), url.c_str());
+        lyric_text = find_track_text(album_tracks, title);
+        if(!album_tracks.empty())
         {
-            for(const pugi::xpath_node& node : lyricdivs)
-            {
-                if(node.node().type() != pugi::node_element) continue;
-                if(node.node().first_child().type() != pugi::node_pcdata) continue;
-
-                std::string_view title_text = node.node().first_child().value();
-                size_t title_dot_index = title_text.find('.');
-
-                if(title_dot_index == std::string_view::npos) continue;
-
-                title_text.remove_prefix(title_dot_index + 1); // +1 to include the '.' that we found
-                title_text = trim_surrounding_whitespace(title_text);
-                if(!tag_values_match(title_text, title))
-                {
-                    continue;
-                }
-
-                if(node.parent().type() != pugi::node_null)
-                {
-                    add_all_text_to_string(lyric_text, node.parent().next_sibling());
-                    break;
-                }
-            }
+            add_cached_album(url, std::move(album_tracks));
         }
     }
-    else
-    {
-        tidyErrorSummary(tidy_doc); // Write more complete error info to the error_buffer
-        LOG_INFO("Failed to convert retrieved HTML from %s to XHTML:\n%s", url.c_str(), tidy_error.bp);
-    }
-
-    tidyBufFree(&tidy_output);
-    tidyBufFree(&tidy_error);
-    tidyRelease(tidy_doc);
 
-    if(lyric_text.empty())
+    if(lyric_text.value().empty())
     {
         throw new std::runtime_error("Failed to parse lyrics, the page format may have changed");
     }
     else
     {
         LOG_INFO("Successfully retrieved lyrics from %s", url.c_str());
-        const std::string_view trimmed_text = trim_surrounding_whitespace(lyric_text);
+        const std::string_view trimmed_text = trim_surrounding_whitespace(lyric_text.value());
 
         LyricDataRaw result = {};
         result.source_id = id();
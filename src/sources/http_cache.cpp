@@ -0,0 +1,317 @@
+#include "stdafx.h"
+
+#include "http_cache.h"
+#include "logging.h"
+
+// Entries written with a different version are ignored (and replaced by the next successful download)
+static const uint32_t CACHE_ENTRY_VERSION = 1;
+
+// How long a response remains fresh if the server did not tell us anything more specific.
+// Lyric pages very rarely change, so we can afford to be fairly generous here.
+static const t_filetimestamp DEFAULT_FRESHNESS_LIFETIME = system_time_periods::day;
+
+// Entries that have not been written in this long are deleted on startup, to stop the cache from growing forever
+static const t_filetimestamp MAX_ENTRY_AGE = 4 * system_time_periods::week;
+
+struct cache_entry
+{
+    t_filetimestamp expiry_time;
+    std::string etag;
+    std::string last_modified;
+    std::string body;
+};
+
+static std::string cache_directory()
+{
+    std::string result = core_api::get_profile_path();
+    result += "\\openlyrics-http-cache\\";
+    return result;
+}
+
+static std::string cache_entry_path(const std::string& url)
+{
+    const hasher_md5_result url_hash = static_api_ptr_t<hasher_md5>()->process_single_string(url.c_str());
+    return cache_directory() + url_hash.asString().c_str() + ".bin";
+}
+
+static std::optional<cache_entry> load_entry(const std::string& path, abort_callback& abort)
+{
+    try
+    {
+        if(!filesystem::g_exists(path.c_str(), abort))
+        {
+            return {};
+        }
+
+        file_ptr file;
+        filesystem::g_open_read(file, path.c_str(), abort);
+
+        uint32_t version = 0;
+        file->read_lendian_t(version, abort);
+        if(version != CACHE_ENTRY_VERSION)
+        {
+            LOG_INFO("Ignoring HTTP cache entry %s with unsupported version %u", path.c_str(), version);
+            return {};
+        }
+
+        cache_entry result = {};
+        file->read_lendian_t(result.expiry_time, abort);
+        result.etag = file->read_string(abort).c_str();
+        result.last_modified = file->read_string(abort).c_str();
+
+        pfc::string8 body;
+        file->read_string(body, abort);
+        result.body = std::string(body.c_str(), body.length());
+        return result;
+    }
+    catch(const exception_aborted&)
+    {
+        throw;
+    }
+    catch(const std::exception& e)
+    {
+        LOG_WARN("Failed to read HTTP cache entry %s: %s", path.c_str(), e.what());
+        return {};
+    }
+}
+
+static void store_entry(const std::string& path, const cache_entry& entry, abort_callback& abort)
+{
+    try
+    {
+        const std::string directory = cache_directory();
+        if(!filesystem::g_exists(directory.c_str(), abort))
+        {
+            filesystem::g_create_directory(directory.c_str(), abort);
+        }
+
+        // Write the entry to a temporary file first and then move it into place, so that a
+        // concurrent search for the same URL never reads a partially-written entry.
+        const std::string tmp_path = path + "." + std::to_string(GetCurrentThreadId()) + ".tmp";
+        {
+            file_ptr file;
+            filesystem::g_open_write_new(file, tmp_path.c_str(), abort);
+            file->write_lendian_t(CACHE_ENTRY_VERSION, abort);
+            file->write_lendian_t(entry.expiry_time, abort);
+            file->write_string(entry.etag.c_str(), entry.etag.length(), abort);
+            file->write_string(entry.last_modified.c_str(), entry.last_modified.length(), abort);
+            file->write_string(entry.body.c_str(), entry.body.length(), abort);
+        }
+
+        service_ptr_t<filesystem> fs = filesystem::get(path.c_str());
+        fs->move_overwrite(tmp_path.c_str(), path.c_str(), abort);
+    }
+    catch(const exception_aborted&)
+    {
+        throw;
+    }
+    catch(const std::exception& e)
+    {
+        LOG_WARN("Failed to write HTTP cache entry %s: %s", path.c_str(), e.what());
+    }
+}
+
+static void remove_entry(const std::string& path, abort_callback& abort)
+{
+    try
+    {
+        filesystem::g_remove(path.c_str(), abort);
+    }
+    catch(const exception_aborted&)
+    {
+        throw;
+    }
+    catch(const std::exception& e)
+    {
+        LOG_WARN("Failed to remove HTTP cache entry %s: %s", path.c_str(), e.what());
+    }
+}
+
+static int get_status_code(http_reply::ptr reply)
+{
+    pfc::string8 status_line;
+    reply->get_status(status_line);
+
+    // The status line is usually something like "200 OK", but may or may not include the protocol version.
+    // Take the first 3-digit token that we find.
+    std::string_view status(status_line.c_str(), status_line.length());
+    while(!status.empty())
+    {
+        const size_t token_len = std::min(status.find(' '), status.length());
+        const std::string_view token = status.substr(0, token_len);
+        if((token.length() == 3) && std::all_of(token.begin(), token.end(), pfc::char_is_numeric<char>))
+        {
+            return (token[0] - '0')*100 + (token[1] - '0')*10 + (token[2] - '0');
+        }
+        status.remove_prefix(std::min(token_len + 1, status.length()));
+    }
+    return -1;
+}
+
+// Returns how long the response may be served from the cache without revalidation,
+// or an empty optional if the response must not be stored at all.
+static std::optional<t_filetimestamp> get_freshness_lifetime(http_reply::ptr reply)
+{
+    pfc::string8 cache_control_header;
+    if(!reply->get_http_header("cache-control", cache_control_header))
+    {
+        return DEFAULT_FRESHNESS_LIFETIME;
+    }
+
+    std::string cache_control(cache_control_header.c_str(), cache_control_header.length());
+    std::transform(cache_control.begin(), cache_control.end(), cache_control.begin(),
+                   [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+
+    if(cache_control.find("no-store") != std::string::npos)
+    {
+        return {};
+    }
+    if(cache_control.find("no-cache") != std::string::npos)
+    {
+        return 0;
+    }
+
+    const std::string_view max_age_prefix = "max-age=";
+    const size_t max_age_index = cache_control.find(max_age_prefix);
+    if(max_age_index != std::string::npos)
+    {
+        t_filetimestamp max_age_seconds = 0;
+        for(size_t i=max_age_index + max_age_prefix.length(); (i < cache_control.length()) && pfc::char_is_numeric(cache_control[i]); i++)
+        {
+            max_age_seconds = max_age_seconds*10 + (cache_control[i] - '0');
+        }
+        return max_age_seconds * system_time_periods::second;
+    }
+
+    return DEFAULT_FRESHNESS_LIFETIME;
+}
+
+std::string http_cache::get(http_request::ptr request, const std::string& url, abort_callback& abort)
+{
+    const std::string entry_path = cache_entry_path(url);
+    std::optional<cache_entry> entry = load_entry(entry_path, abort);
+
+    const t_filetimestamp now = filetimestamp_from_system_timer();
+    if(entry.has_value() && (now < entry->expiry_time))
+    {
+        LOG_INFO("Using cached copy of %s", url.c_str());
+        return std::move(entry->body);
+    }
+
+    if(entry.has_value())
+    {
+        if(!entry->etag.empty())
+        {
+            request->add_header("If-None-Match", entry->etag.c_str());
+        }
+        if(!entry->last_modified.empty())
+        {
+            request->add_header("If-Modified-Since", entry->last_modified.c_str());
+        }
+    }
+
+    file_ptr response_file = request->run_ex(url.c_str(), abort);
+
+    http_reply::ptr reply;
+    if(!response_file->service_query_t(reply))
+    {
+        // Without the reply status or headers we can't know whether it is safe to cache this response
+        LOG_INFO("No HTTP reply information available for %s, skipping the HTTP cache", url.c_str());
+        pfc::string8 content;
+        response_file->read_string_raw(content, abort);
+        return std::string(content.c_str(), content.length());
+    }
+
+    const int status = get_status_code(reply);
+    const std::optional<t_filetimestamp> lifetime = get_freshness_lifetime(reply);
+    if((status == 304) && entry.has_value())
+    {
+        LOG_INFO("Cached copy of %s has not been modified, skipping download", url.c_str());
+        if(lifetime.has_value())
+        {
+            pfc::string8 header_value;
+            if(reply->get_http_header("etag", header_value))
+            {
+                entry->etag = header_value.c_str();
+            }
+            entry->expiry_time = now + lifetime.value();
+            store_entry(entry_path, entry.value(), abort);
+        }
+        else
+        {
+            remove_entry(entry_path, abort);
+        }
+        return std::move(entry->body);
+    }
+
+    if((status < 200) || (status >= 300))
+    {
+        pfc::string8 status_line;
+        reply->get_status(status_line);
+        throw std::runtime_error(std::string("Unexpected HTTP response: ") + status_line.c_str());
+    }
+
+    pfc::string8 content;
+    response_file->read_string_raw(content, abort);
+
+    cache_entry new_entry = {};
+    new_entry.body = std::string(content.c_str(), content.length());
+    if(lifetime.has_value())
+    {
+        pfc::string8 header_value;
+        if(reply->get_http_header("etag", header_value))
+        {
+            new_entry.etag = header_value.c_str();
+        }
+        if(reply->get_http_header("last-modified", header_value))
+        {
+            new_entry.last_modified = header_value.c_str();
+        }
+        new_entry.expiry_time = now + lifetime.value();
+        store_entry(entry_path, new_entry, abort);
+    }
+    else if(entry.has_value())
+    {
+        // The server no longer allows this page to be stored, so don't leave the stale copy lying around
+        remove_entry(entry_path, abort);
+    }
+    return new_entry.body;
+}
+
+class HttpCachePruneOnInit : public initquit
+{
+    void on_init() override
+    {
+        fb2k::splitTask([](){
+            abort_callback& abort = async_task_manager::get()->get_aborter();
+            try
+            {
+                const std::string directory = cache_directory();
+                if(!filesystem::g_exists(directory.c_str(), abort))
+                {
+                    return;
+                }
+
+                directory_callback_impl entries(false);
+                filesystem::g_list_directory(directory.c_str(), entries, abort);
+
+                const t_filetimestamp oldest_allowed = filetimestamp_from_system_timer() - MAX_ENTRY_AGE;
+                int removed_count = 0;
+                for(size_t i=0; i<entries.get_count(); i++)
+                {
+                    if(entries.get_item_stats(i).m_timestamp < oldest_allowed)
+                    {
+                        filesystem::g_remove(entries.get_item(i), abort);
+                        removed_count++;
+                    }
+                }
+                LOG_INFO("Removed %d expired entries from the HTTP cache", removed_count);
+            }
+            catch(const std::exception& e)
+            {
+                LOG_WARN("Failed to prune the HTTP cache: %s", e.what());
+            }
+        });
+    }
+};
+static initquit_factory_t<HttpCachePruneOnInit> g_http_cache_prune_factory;
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "stdafx.h"
+
+namespace http_cache
+{
+    // Retrieves the body of the page at the given URL.
+    // Responses are stored (along with their ETag/Last-Modified validators) in the foobar profile
+    // directory. Entries that are still fresh are returned without making any request at all, and
+    // stale entries are revalidated with a conditional request so that unchanged pages need not be
+    // downloaded again.
+    // Throws in the same circumstances as http_request::run (connection failure, non-2XX reply etc).
+    std::string get(http_request::ptr request, const std::string& url, abort_callback& abort);
+}
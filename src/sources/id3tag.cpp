@@ -1,5 +1,8 @@
 #include "stdafx.h"
 
+#include <mutex>
+#include <unordered_map>
+
 #include "logging.h"
 #include "lyric_source.h"
 #include "tag_util.h"
@@ -13,18 +16,158 @@ class ID3TagLyricSource : public LyricSourceBase
     std::tstring_view friendly_name() const final { return _T("Metadata tags"); }
     bool is_local() const final { return true; }
 
-    std::vector<LyricDataRaw> search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, abort_callback& abort) final;
+    std::vector<LyricDataRaw> search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, const TrackKey& track_key, abort_callback& abort) final;
     bool lookup(LyricDataRaw& data, abort_callback& abort) final;
 
+    std::string get_save_path(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped) final;
     std::string save(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped, std::string_view lyrics, bool allow_overwrite, abort_callback& abort) final;
     bool delete_persisted(metadb_handle_ptr track, const std::string& path) final;
+    void flush_pending_saves() final;
 
     std::tstring get_file_path(metadb_handle_ptr track, const LyricData& lyrics) final;
 };
 
 static const LyricSourceFactory<ID3TagLyricSource> src_factory;
 
-std::vector<LyricDataRaw> ID3TagLyricSource::search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, abort_callback& /*abort*/)
+// Tag updates are collected and then written for many tracks at once, so that (for example) a bulk search
+// that saves to tags does a single tag update (with a single UI refresh) for every batch of tracks rather than for each track.
+struct PendingTagUpdate
+{
+    std::string tag_name;
+    std::string lyrics;
+    bool allow_overwrite;
+};
+
+struct PendingTrackUpdates
+{
+    metadb_handle_ptr track;
+    std::vector<PendingTagUpdate> tags;
+};
+
+static std::mutex g_tag_update_mutex;
+static std::unordered_map<const metadb_handle*, PendingTrackUpdates> g_pending_tag_updates;
+static bool g_tag_update_flush_scheduled = false;
+
+static void flush_tag_updates()
+{
+    core_api::ensure_main_thread(); // metadb_io_v2 can only be used from the main thread
+
+    std::unordered_map<const metadb_handle*, PendingTrackUpdates> updates;
+    {
+        std::lock_guard lock(g_tag_update_mutex);
+        updates.swap(g_pending_tag_updates);
+        g_tag_update_flush_scheduled = false;
+    }
+    if(updates.empty())
+    {
+        return;
+    }
+
+    struct MetaCompletionLogger : public completion_notify
+    {
+        const size_t track_count;
+        MetaCompletionLogger(size_t count) : track_count(count) {}
+        void on_completion(unsigned int result_code) final
+        {
+            if(result_code == metadb_io::update_info_success)
+            {
+                LOG_INFO("Successfully saved lyrics to tags for %d tracks", int(track_count));
+            }
+            else
+            {
+                LOG_WARN("Failed to save lyrics to tags for %d tracks: %u", int(track_count), result_code);
+            }
+        }
+    };
+
+    metadb_handle_list tracks;
+    tracks.prealloc(updates.size());
+    for(const auto& [key, track_updates] : updates)
+    {
+        tracks.add_item(track_updates.track);
+    }
+
+    const auto update_meta_tags = [updates = std::move(updates)](trackRef location, t_filestats /*stats*/, file_info& info)
+    {
+        const auto iter = updates.find(location.get_ptr());
+        if(iter == updates.end())
+        {
+            return false;
+        }
+
+        bool modified = false;
+        for(const PendingTagUpdate& update : iter->second.tags)
+        {
+            t_size tag_index = info.meta_find_ex(update.tag_name.data(), update.tag_name.length());
+            if(!update.allow_overwrite && (tag_index != pfc::infinite_size))
+            {
+                LOG_INFO("Save tag already exists and overwriting is disallowed. The tag will not be modified");
+                continue;
+            }
+            info.meta_set_ex(update.tag_name.data(), update.tag_name.length(), update.lyrics.data(), update.lyrics.length());
+            modified = true;
+        }
+        return modified;
+    };
+
+    LOG_INFO("Writing lyrics to tags for %d tracks...", int(tracks.get_count()));
+    service_ptr_t<file_info_filter> updater = file_info_filter::create(update_meta_tags);
+    service_ptr_t<MetaCompletionLogger> completion = fb2k::service_new<MetaCompletionLogger>(tracks.get_count());
+    service_ptr_t<metadb_io_v2> meta_io = metadb_io_v2::get();
+    meta_io->update_info_async(tracks,
+                               updater,
+                               core_api::get_main_window(),
+                               metadb_io_v2::op_flag_delay_ui | metadb_io_v2::op_flag_partial_info_aware,
+                               completion);
+}
+
+static void queue_tag_update(metadb_handle_ptr track, PendingTagUpdate update)
+{
+    std::lock_guard lock(g_tag_update_mutex);
+    PendingTrackUpdates& track_updates = g_pending_tag_updates[track.get_ptr()];
+    track_updates.track = track;
+
+    // A newer save to the same tag replaces any that hasn't been written yet
+    const auto same_tag = [&update](const PendingTagUpdate& other){ return other.tag_name == update.tag_name; };
+    track_updates.tags.erase(std::remove_if(track_updates.tags.begin(), track_updates.tags.end(), same_tag), track_updates.tags.end());
+    track_updates.tags.push_back(std::move(update));
+
+    if(g_pending_tag_updates.size() >= preferences::saving::tag_batch_size())
+    {
+        g_tag_update_flush_scheduled = true;
+        fb2k::inMainThread2(flush_tag_updates);
+    }
+    else if(!g_tag_update_flush_scheduled)
+    {
+        g_tag_update_flush_scheduled = true;
+        const double interval = preferences::saving::tag_batch_interval_seconds();
+        fb2k::inMainThread2([interval](){ fb2k::callLater(interval, flush_tag_updates); });
+    }
+}
+
+// Returns true if there was a pending update to the given tag of the given track, which has now been discarded
+static bool discard_pending_tag_update(metadb_handle_ptr track, const std::string& tag_name)
+{
+    std::lock_guard lock(g_tag_update_mutex);
+    const auto iter = g_pending_tag_updates.find(track.get_ptr());
+    if(iter == g_pending_tag_updates.end())
+    {
+        return false;
+    }
+
+    std::vector<PendingTagUpdate>& tags = iter->second.tags;
+    const auto same_tag = [&tag_name](const PendingTagUpdate& other){ return other.tag_name == tag_name; };
+    const auto new_end = std::remove_if(tags.begin(), tags.end(), same_tag);
+    const bool discarded = (new_end != tags.end());
+    tags.erase(new_end, tags.end());
+    if(tags.empty())
+    {
+        g_pending_tag_updates.erase(iter);
+    }
+    return discarded;
+}
+
+std::vector<LyricDataRaw> ID3TagLyricSource::search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, const TrackKey& track_key, abort_callback& /*abort*/)
 {
     std::vector<LyricDataRaw> result;
     const file_info& info = track_info.info->info();
@@ -41,9 +184,9 @@ std::vector<LyricDataRaw> ID3TagLyricSource::search(metadb_handle_ptr track, con
         LyricDataRaw lyric = {};
         lyric.source_id = src_guid;
         lyric.source_path = tag;
-        lyric.artist = track_metadata(track_info, "artist");
-        lyric.album = track_metadata(track_info, "album");
-        lyric.title = track_metadata(track_info, "title");
+        lyric.artist = track_key.artist;
+        lyric.album = track_key.album;
+        lyric.title = track_key.title;
 
         std::string text;
         size_t value_count = info.meta_enum_value_count(lyric_value_index);
@@ -71,93 +214,55 @@ bool ID3TagLyricSource::lookup(LyricDataRaw& /*data*/, abort_callback& /*abort*/
     return false;
 }
 
-std::string ID3TagLyricSource::save(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped, std::string_view lyric_view, bool allow_overwrite, abort_callback& abort)
+std::string ID3TagLyricSource::get_save_path(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped)
 {
-    // We can't save lyrics for remote tracks to metadata (because we don't have a file to save
-    // the metadata into). Redirect to saving to localfiles if we find ourselves attempting to
-    // save lyrics for a remote track to metadata.
     if(track_is_remote(track))
     {
         LyricSourceBase* localfiles_source = LyricSourceBase::get(localfiles_src_guid);
         assert(localfiles_source != nullptr);
-        return localfiles_source->save(track, track_info, is_timestamped, lyric_view, allow_overwrite, abort);
+        return localfiles_source->get_save_path(track, track_info, is_timestamped);
     }
 
-    std::string tag_name;
     if(is_timestamped)
     {
-        tag_name = preferences::saving::timestamped_tag();
+        return std::string(preferences::saving::timestamped_tag());
     }
     else
     {
-        tag_name = preferences::saving::untimed_tag();
+        return std::string(preferences::saving::untimed_tag());
     }
+}
+
+std::string ID3TagLyricSource::save(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped, std::string_view lyric_view, bool allow_overwrite, abort_callback& abort)
+{
+    // We can't save lyrics for remote tracks to metadata (because we don't have a file to save
+    // the metadata into). Redirect to saving to localfiles if we find ourselves attempting to
+    // save lyrics for a remote track to metadata.
+    if(track_is_remote(track))
+    {
+        LyricSourceBase* localfiles_source = LyricSourceBase::get(localfiles_src_guid);
+        assert(localfiles_source != nullptr);
+        return localfiles_source->save(track, track_info, is_timestamped, lyric_view, allow_overwrite, abort);
+    }
+
+    const std::string tag_name = get_save_path(track, track_info, is_timestamped);
     LOG_INFO("Saving lyrics to ID3 tag %s...", tag_name.c_str());
 
     // NOTE: I'm actually not 100% sure this is necessary but lets ensure we've loaded the full tag data
     //       before we save it so that we don't accidentally overwrite some esoteric tag that wasn't loaded.
     track->get_full_info_ref(abort);
 
-    std::string lyrics(lyric_view);
-    const auto update_lyric_tag = [](metadb_handle_ptr track, const std::string& tag_name, const std::string& lyrics, bool allow_overwrite)
-    {
-        struct MetaCompletionLogger : public completion_notify
-        {
-            const std::string metatag;
-            MetaCompletionLogger(std::string_view tag) : metatag(tag) {}
-            void on_completion(unsigned int result_code) final
-            {
-                if(result_code == metadb_io::update_info_success)
-                {
-                    LOG_INFO("Successfully saved lyrics to %s", metatag.c_str());
-                }
-                else
-                {
-                    LOG_WARN("Failed to save lyrics to tag %s: %u", metatag.c_str(), result_code);
-                }
-            }
-        };
-
-        const auto update_meta_tag = [tag_name, lyrics, allow_overwrite](trackRef /*location*/, t_filestats /*stats*/, file_info& info)
-        {
-            t_size tag_index = info.meta_find_ex(tag_name.data(), tag_name.length());
-            if(!allow_overwrite && (tag_index != pfc::infinite_size))
-            {
-                LOG_INFO("Save tag already exists and overwriting is disallowed. The tag will not be modified");
-                return false;
-            }
-            info.meta_set_ex(tag_name.data(), tag_name.length(), lyrics.data(), lyrics.length());
-            return true;
-        };
-
-        service_ptr_t<file_info_filter> updater = file_info_filter::create(update_meta_tag);
-        service_ptr_t<MetaCompletionLogger> completion = fb2k::service_new<MetaCompletionLogger>(tag_name);
-        service_ptr_t<metadb_io_v2> meta_io = metadb_io_v2::get();
-        meta_io->update_info_async(pfc::list_single_ref_t<metadb_handle_ptr>(track),
-                                   updater,
-                                   core_api::get_main_window(),
-                                   metadb_io_v2::op_flag_delay_ui | metadb_io_v2::op_flag_partial_info_aware,
-                                   completion);
-        LOG_INFO("Successfully wrote lyrics to ID3 tag %s", tag_name.c_str());
-    };
-
-    // metadb_io_v2's async need to be called from the main thread, but we want to have some idea of
-    // whether or not we succeeded. So if we're already on the main thread then call it directly and
-    // return the result, otherwise queue the update for the main thread and assume we succeeded.
-    if(core_api::is_main_thread())
-    {
-        update_lyric_tag(track, tag_name, lyrics, allow_overwrite);
-    }
-    else
-    {
-        fb2k::inMainThread2([update_lyric_tag, track, tag_name, lyrics, allow_overwrite]() { update_lyric_tag(track, tag_name, lyrics, allow_overwrite); });
-    }
-
+    queue_tag_update(track, {tag_name, std::string(lyric_view), allow_overwrite});
     return tag_name;
 }
 
 bool ID3TagLyricSource::delete_persisted(metadb_handle_ptr track, const std::string& path)
 {
+    if(discard_pending_tag_update(track, path))
+    {
+        LOG_INFO("Discarded pending save of lyrics to tag '%s'", path.c_str());
+    }
+
     const auto delete_lyric_tag = [](metadb_handle_ptr track, const std::string& path) -> bool
     {
         struct MetaRemovalCompletionLogger : public completion_notify
@@ -232,6 +337,15 @@ bool ID3TagLyricSource::delete_persisted(metadb_handle_ptr track, const std::str
     }
 }
 
+void ID3TagLyricSource::flush_pending_saves()
+{
+    // NOTE: Anything still waiting for its batch would otherwise be lost. The flush that queue_tag_update scheduled
+    //       can't run now because it is posted to the main thread, which is busy shutting down, so we flush directly.
+    //       This is a best-effort attempt, the update is still asynchronous and so might not complete if foobar
+    //       finishes shutting down first.
+    flush_tag_updates();
+}
+
 std::tstring ID3TagLyricSource::get_file_path(metadb_handle_ptr track, const LyricData& lyrics)
 {
     const char* path = track->get_path();
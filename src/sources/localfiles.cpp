@@ -1,5 +1,11 @@
 #include "stdafx.h"
 
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+
+#include "localfiles_index.h"
 #include "logging.h"
 #include "lyric_source.h"
 #include "preferences.h"
@@ -14,52 +20,202 @@ class LocalFileSource : public LyricSourceBase
     std::tstring_view friendly_name() const final { return _T("Local files"); }
     bool is_local() const final { return true; }
 
-    std::vector<LyricDataRaw> search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, abort_callback& abort) final;
+    std::vector<LyricDataRaw> search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, const TrackKey& track_key, abort_callback& abort) final;
     bool lookup(LyricDataRaw& data, abort_callback& abort) final;
 
+    std::string get_save_path(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped) final;
     std::string save(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped, std::string_view lyrics, bool allow_overwrite, abort_callback& abort) final;
     bool delete_persisted(metadb_handle_ptr track, const std::string& path) final;
+    void flush_pending_saves() final;
 
     std::tstring get_file_path(metadb_handle_ptr track, const LyricData& lyrics) final;
 };
 static const LyricSourceFactory<LocalFileSource> src_factory;
 
-std::vector<LyricDataRaw> LocalFileSource::search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, abort_callback& abort)
+static void ensure_dir_exists(const pfc::string& dir_path, std::unordered_set<std::string>& known_dirs, abort_callback& abort)
 {
-    std::string file_path_prefix = preferences::saving::filename(track, track_info);
+    const std::string dir_path_str(dir_path.c_str(), dir_path.length());
+    if(known_dirs.count(dir_path_str) > 0)
+    {
+        return;
+    }
 
-    if(file_path_prefix.empty())
+    if(filesystem::g_exists(dir_path.c_str(), abort))
     {
-        LOG_ERROR("Failed to determine query file path");
-        return {};
+        known_dirs.insert(dir_path_str);
+        return;
     }
 
-    std::vector<LyricDataRaw> output;
-    const char* extensions[] = { ".lrc", ".txt" };
-    for (const char* ext : extensions)
+    pfc::string parent = pfc::io::path::getParent(dir_path);
+    if(parent == "file://\\\\")
     {
-        std::string file_path = file_path_prefix;
-        file_path += ext;
-        LOG_INFO("Querying for lyrics in %s...", file_path.c_str());
+        // If the parent path is "file://\\" then dir_path is something like "file:://\\machine_name" (a path on a network filesystem).
+        // filesystem::g_exists fails (at least in SDK version 20200728 with fb2k version 1.6.7) on a path like that.
+        // This is fine because we couldn't "create that directory" anyway, if it decided it didn't exist, so we'll just return here
+        // as if it does and then either the existence checks further down the path tree will fail, or the actual file write will fail.
+        // Both are guarded against IO failure, so that'd be fine (we'd just do slightly more work).
+        return;
+    }
 
-        try
+    if(!parent.isEmpty())
+    {
+        ensure_dir_exists(parent, known_dirs, abort);
+    }
+
+    LOG_INFO("Save directory '%s' does not exist. Creating it...", dir_path.c_str());
+    filesystem::g_create_directory(dir_path.c_str(), abort);
+    known_dirs.insert(dir_path_str);
+}
+
+// Saves are written to disk on a background thread, so that (for example) a bulk search
+// doesn't need to wait for each file to be written before moving on to the next track.
+struct PendingSave
+{
+    std::string text;
+    bool allow_overwrite;
+    uint64_t generation; // Incremented every time the save is replaced, so that we know if it changed while we were writing it
+};
+
+static std::mutex g_save_queue_mutex;
+static std::condition_variable g_save_queue_idle;
+static std::condition_variable g_save_written;
+static std::map<std::string, PendingSave> g_pending_saves; // Keyed by output path, which keeps saves to the same directory together
+static std::optional<std::string> g_save_in_progress_path; // The output path that the worker is currently writing to (outside of the lock)
+static uint64_t g_next_save_generation = 0;
+static bool g_save_worker_running = false;
+
+static void write_lyrics_file(const std::string& output_path_str, const PendingSave& save, std::unordered_set<std::string>& known_dirs, abort_callback& abort)
+{
+    const pfc::string output_path(output_path_str.c_str(), output_path_str.length());
+    ensure_dir_exists(pfc::io::path::getParent(output_path), known_dirs, abort);
+
+    if(!save.allow_overwrite && filesystem::g_exists(output_path.c_str(), abort))
+    {
+        LOG_INFO("Save file %s already exists and overwriting is disallowed. The file will not be modified", output_path.c_str());
+        return;
+    }
+
+    // NOTE: We write to a temporary file in the same directory and then rename it over the output file.
+    //       Being in the same directory guarantees that the rename doesn't need to copy any data, and means
+    //       that the output file is only ever replaced by a complete file, never a partially-written one.
+    const std::string tmp_path = output_path_str + ".tmp";
+    {
+        // NOTE: Scoping to close the file and flush writes to disk (hopefully preventing "file in use" errors)
+        file_ptr tmp_file;
+        filesystem::g_open_write_new(tmp_file, tmp_path.c_str(), abort);
+        tmp_file->write_object(save.text.data(), save.text.size(), abort);
+    }
+
+    filesystem::get(output_path.c_str())->move_overwrite(tmp_path.c_str(), output_path.c_str(), abort);
+    LOG_INFO("Successfully saved lyrics to %s", output_path.c_str());
+}
+
+static void run_save_queue()
+{
+    std::unordered_set<std::string> known_dirs; // Directories that we know exist, so that we don't re-check them for every file in a batch
+    while(true)
+    {
+        std::string output_path;
+        PendingSave save = {};
         {
-            if (filesystem::g_exists(file_path.c_str(), abort))
+            std::lock_guard lock(g_save_queue_mutex);
+            if(g_pending_saves.empty())
             {
-                LyricDataRaw result = {};
-                result.source_id = id();
-                result.source_path = file_path;
-                result.artist = track_metadata(track_info, "artist");
-                result.album = track_metadata(track_info, "album");
-                result.title = track_metadata(track_info, "title");
-                result.lookup_id = file_path;
-                output.push_back(std::move(result));
+                g_save_worker_running = false;
+                g_save_queue_idle.notify_all();
+                return;
             }
+
+            // NOTE: We leave the save in the queue until it has been written, so that lookups
+            //       will continue to find the new text until it is actually in the file.
+            const auto iter = g_pending_saves.begin();
+            output_path = iter->first;
+            save = iter->second;
+            g_save_in_progress_path = output_path;
+        }
+
+        try
+        {
+            write_lyrics_file(output_path, save, known_dirs, fb2k::noAbort);
         }
         catch(const std::exception& e)
         {
-            LOG_WARN("Failed to open lyrics file %s: %s", file_path.c_str(), e.what());
+            LOG_ERROR("Failed to save lyrics to %s: %s", output_path.c_str(), e.what());
+        }
+
+        std::lock_guard lock(g_save_queue_mutex);
+        const auto iter = g_pending_saves.find(output_path);
+        if((iter != g_pending_saves.end()) && (iter->second.generation == save.generation))
+        {
+            g_pending_saves.erase(iter);
         }
+        g_save_in_progress_path.reset();
+        g_save_written.notify_all();
+    }
+}
+
+static void enqueue_save(const std::string& output_path, std::string_view text, bool allow_overwrite)
+{
+    std::lock_guard lock(g_save_queue_mutex);
+    const auto existing = g_pending_saves.find(output_path);
+    if(existing != g_pending_saves.end())
+    {
+        if(!allow_overwrite)
+        {
+            LOG_INFO("Lyrics are already being saved to %s and overwriting is disallowed. The pending save will not be modified", output_path.c_str());
+            return;
+        }
+
+        // Repeated saves of the same track (e.g when applying several edits in quick succession) only need to write the latest text
+        LOG_INFO("Replacing pending save to %s", output_path.c_str());
+    }
+
+    PendingSave& save = g_pending_saves[output_path];
+    save.text = std::string(text);
+    save.allow_overwrite = allow_overwrite;
+    save.generation = g_next_save_generation++;
+
+    if(!g_save_worker_running)
+    {
+        g_save_worker_running = true;
+        fb2k::splitTask(run_save_queue);
+    }
+}
+
+static std::optional<std::string> get_pending_save_text(const std::string& path)
+{
+    std::lock_guard lock(g_save_queue_mutex);
+    const auto iter = g_pending_saves.find(path);
+    if(iter == g_pending_saves.end())
+    {
+        return {};
+    }
+    return iter->second.text;
+}
+
+std::vector<LyricDataRaw> LocalFileSource::search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, const TrackKey& track_key, abort_callback& abort)
+{
+    std::string file_path_prefix = preferences::saving::filename(track, track_info);
+
+    if(file_path_prefix.empty())
+    {
+        LOG_ERROR("Failed to determine query file path");
+        return {};
+    }
+
+    LOG_INFO("Querying for lyrics in %s.lrc/.txt...", file_path_prefix.c_str());
+    std::vector<LyricDataRaw> output;
+    const std::vector<std::string> file_paths = localfiles_index::find_files(file_path_prefix, { ".lrc", ".txt" }, abort);
+    for(const std::string& file_path : file_paths)
+    {
+        LyricDataRaw result = {};
+        result.source_id = id();
+        result.source_path = file_path;
+        result.artist = track_key.artist;
+        result.album = track_key.album;
+        result.title = track_key.title;
+        result.lookup_id = file_path;
+        output.push_back(std::move(result));
     }
 
     LOG_INFO("Found %d lyrics in local files: %s", output.size(), file_path_prefix.c_str());
@@ -71,23 +227,56 @@ bool LocalFileSource::lookup(LyricDataRaw& data, abort_callback& abort)
     std::string& file_path = data.lookup_id;
     LOG_INFO("Lookup local-file %s for lyrics...", file_path.c_str());
 
+    std::optional<std::string> pending_text = get_pending_save_text(file_path);
+    if(pending_text.has_value())
+    {
+        LOG_INFO("Retrieved lyrics for %s from a save that has not yet been written", file_path.c_str());
+        data.text_file = nullptr;
+        const uint8_t* pending_bytes = reinterpret_cast<const uint8_t*>(pending_text.value().data());
+        data.text_bytes.assign(pending_bytes, pending_bytes + pending_text.value().size());
+        return true;
+    }
+
+    // Files on fixed local drives are mapped into memory and decoded from there, rather than being copied into a buffer first.
+    // Anything else (or any file that we fail to map) is read through the foobar filesystem API as normal.
+    pfc::string8 native_path;
+    if(foobar2000_io::extract_native_path_ex(file_path.c_str(), native_path))
+    {
+        std::shared_ptr<const MappedFile> mapped_file = MappedFile::open(to_tstring(native_path));
+        if(mapped_file != nullptr)
+        {
+            LOG_INFO("Successfully mapped lyrics from %s", file_path.c_str());
+            data.text_bytes.clear();
+            data.text_file = std::move(mapped_file);
+            return true;
+        }
+    }
+
     try
     {
         file_ptr file;
         filesystem::g_open_read(file, file_path.c_str(), abort);
 
-        // NOTE: We need to use `read_till_eof` instead of `read_string_raw` because otherwise on some
+        // NOTE: We need to read the raw bytes instead of using `read_string_raw` because otherwise on some
         //       encodings it will see a null byte mid-way through and stop reading, dropping the rest
         //       of the string.
         //       For example if the input file is UTF-16 but only contains ASCII characters, then
         //       every second byte is 0x00 and it will stop reading almost immediately, discarding
         //       most of the actual lyric data. Issue #232 on github.
-        pfc::array_t<uint8_t> file_bytes;
-        file->read_till_eof(file_bytes, abort);
+        data.text_file = nullptr;
+        const t_filesize file_size = file->get_size(abort);
+        if((file_size != filesize_invalid) && (file_size <= SIZE_MAX))
+        {
+            data.text_bytes.resize(size_t(file_size));
+            file->read_object(data.text_bytes.data(), data.text_bytes.size(), abort);
+        }
+        else
+        {
+            pfc::array_t<uint8_t> file_bytes;
+            file->read_till_eof(file_bytes, abort);
+            data.text_bytes.assign(file_bytes.get_ptr(), file_bytes.get_ptr() + file_bytes.get_size());
+        }
         LOG_INFO("Successfully retrieved lyrics from %s", file_path.c_str());
-
-        data.text_bytes.clear();
-        data.text_bytes.insert(data.text_bytes.begin(), file_bytes.begin(), file_bytes.end());
         return true;
     }
     catch(const std::exception& e)
@@ -97,36 +286,8 @@ bool LocalFileSource::lookup(LyricDataRaw& data, abort_callback& abort)
     }
 }
 
-static void ensure_dir_exists(const pfc::string& dir_path, abort_callback& abort)
-{
-    if(filesystem::g_exists(dir_path.c_str(), abort))
-    {
-        return;
-    }
-
-    pfc::string parent = pfc::io::path::getParent(dir_path);
-    if(parent == "file://\\\\")
-    {
-        // If the parent path is "file://\\" then dir_path is something like "file:://\\machine_name" (a path on a network filesystem).
-        // filesystem::g_exists fails (at least in SDK version 20200728 with fb2k version 1.6.7) on a path like that.
-        // This is fine because we couldn't "create that directory" anyway, if it decided it didn't exist, so we'll just return here
-        // as if it does and then either the existence checks further down the path tree will fail, or the actual file write will fail.
-        // Both are guarded against IO failure, so that'd be fine (we'd just do slightly more work).
-        return;
-    }
-
-    if(!parent.isEmpty())
-    {
-        ensure_dir_exists(parent, abort);
-    }
-
-    LOG_INFO("Save directory '%s' does not exist. Creating it...", dir_path.c_str());
-    filesystem::g_create_directory(dir_path.c_str(), abort);
-}
-
-std::string LocalFileSource::save(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped, std::string_view lyrics, bool allow_overwrite, abort_callback& abort)
+std::string LocalFileSource::get_save_path(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped)
 {
-    LOG_INFO("Saving lyrics to a local file...");
     std::string output_path_str = preferences::saving::filename(track, track_info);
     if(output_path_str.empty())
     {
@@ -142,46 +303,40 @@ std::string LocalFileSource::save(metadb_handle_ptr track, const metadb_v2_rec_t
     {
         throw std::exception("Calculated file path does not contain a file leaf node");
     }
-    ensure_dir_exists(pfc::io::path::getParent(output_path), abort);
-    LOG_INFO("Saving lyrics to %s...", output_path.c_str());
-
-    if(!allow_overwrite && filesystem::g_exists(output_path.c_str(), abort))
-    {
-        LOG_INFO("Save file already exists and overwriting is disallowed. The file will not be modified");
-        return output_path_str;
-    }
-
-    TCHAR temp_path_str[MAX_PATH+1];
-    DWORD temp_path_str_len = GetTempPath(MAX_PATH+1, temp_path_str);
-    std::string tmp_path = from_tstring(std::tstring_view{temp_path_str, temp_path_str_len});
-    tmp_path += std::string_view(output_file_name.c_str(), output_file_name.length());
-
-    {
-        // NOTE: Scoping to close the file and flush writes to disk (hopefully preventing "file in use" errors)
-        file_ptr tmp_file;
-        filesystem::g_open_write_new(tmp_file, tmp_path.c_str(), abort);
-        tmp_file->write_object(lyrics.data(), lyrics.size(), abort);
-    }
+    return output_path_str;
+}
 
-    service_ptr_t<filesystem> fs = filesystem::get(output_path.c_str());
-    if(fs->is_our_path(tmp_path.c_str()))
-    {
-        fs->move_overwrite(tmp_path.c_str(), output_path.c_str(), abort);
-        LOG_INFO("Successfully saved lyrics to %s", output_path.c_str());
-    }
-    else
-    {
-        LOG_WARN("Cannot save lyrics file. Temp path (%s) and output path (%s) are on different filesystems", tmp_path.c_str(), output_path.c_str());
-    }
+std::string LocalFileSource::save(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped, std::string_view lyrics, bool allow_overwrite, abort_callback& /*abort*/)
+{
+    LOG_INFO("Saving lyrics to a local file...");
+    const std::string output_path_str = get_save_path(track, track_info, is_timestamped);
+    LOG_INFO("Queueing lyrics to be saved to %s...", output_path_str.c_str());
 
+    enqueue_save(output_path_str, lyrics, allow_overwrite);
+    localfiles_index::notify_file_saved(output_path_str);
     return output_path_str;
 }
 
 bool LocalFileSource::delete_persisted(metadb_handle_ptr /*track*/, const std::string& path)
 {
+    {
+        std::unique_lock lock(g_save_queue_mutex);
+        g_pending_saves.erase(path); // Don't re-create the file after we delete it
+
+        // NOTE: The worker writes its copy of the save without holding the lock, so erasing the queue entry doesn't
+        //       stop a write that has already started. If we deleted the file now then that write would just
+        //       re-create it afterwards, so wait for it to finish first and then delete whatever it wrote.
+        if(g_save_in_progress_path == path)
+        {
+            LOG_INFO("Waiting for in-progress save to %s to complete before deleting it...", path.c_str());
+            g_save_written.wait(lock, [&path](){ return g_save_in_progress_path != path; });
+        }
+    }
+
     try
     {
         filesystem::g_remove(path.c_str(), fb2k::noAbort);
+        localfiles_index::notify_file_deleted(path);
         return true;
     }
     catch(const std::exception& ex)
@@ -192,6 +347,22 @@ bool LocalFileSource::delete_persisted(metadb_handle_ptr /*track*/, const std::s
     return false;
 }
 
+void LocalFileSource::flush_pending_saves()
+{
+    std::unique_lock lock(g_save_queue_mutex);
+    if(!g_save_worker_running)
+    {
+        return;
+    }
+
+    LOG_INFO("Waiting for %d pending lyric file writes to complete...", int(g_pending_saves.size()));
+    const bool finished = g_save_queue_idle.wait_for(lock, std::chrono::seconds(10), [](){ return !g_save_worker_running; });
+    if(!finished)
+    {
+        LOG_WARN("Timed out waiting for lyric file writes to complete. %d saves were lost", int(g_pending_saves.size()));
+    }
+}
+
 std::tstring LocalFileSource::get_file_path(metadb_handle_ptr /*track*/, const LyricData& lyrics)
 {
     if(lyrics.source_id == src_guid)
@@ -0,0 +1,275 @@
+#include "stdafx.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "localfiles_index.h"
+#include "logging.h"
+
+// Files created or removed by anything other than us are picked up by re-listing the directory once its listing is this old
+static const t_filetimestamp RESCAN_INTERVAL = 2 * system_time_periods::minute;
+
+// When listing more directories than this (e.g when saving lyrics alongside each track), the least-recently-used listing is dropped
+static const size_t MAX_INDEXED_DIRECTORIES = 64;
+
+struct DirectoryListing
+{
+    t_filetimestamp scan_time;
+    t_filetimestamp last_used_time;
+    std::unordered_set<std::string> names;
+    std::unordered_map<std::string, std::string> loose_names; // Loose match key -> file name
+};
+
+static std::mutex g_index_mutex;
+static std::unordered_map<std::string, DirectoryListing> g_directories; // Directory path -> listing
+
+static char ascii_tolower(char c)
+{
+    if((c >= 'A') && (c <= 'Z'))
+    {
+        return c - 'A' + 'a';
+    }
+    return c;
+}
+
+std::string localfiles_index::loose_file_name_key(std::string_view file_name)
+{
+    const size_t extension_index = file_name.rfind('.');
+    const std::string_view stem = file_name.substr(0, extension_index);
+
+    std::string key;
+    key.reserve(file_name.length());
+    for(char c : stem)
+    {
+        // NOTE: We only ignore ASCII punctuation & whitespace. Any non-ASCII bytes are part of multi-byte UTF-8
+        //       characters which we keep exactly as they are.
+        const bool is_ascii = ((static_cast<unsigned char>(c) & 0x80) == 0);
+        if(!is_ascii || pfc::char_is_ascii_alphanumeric(c))
+        {
+            key += ascii_tolower(c);
+        }
+    }
+
+    if(key.empty())
+    {
+        return {};
+    }
+
+    if(extension_index != std::string_view::npos)
+    {
+        for(char c : file_name.substr(extension_index))
+        {
+            key += ascii_tolower(c);
+        }
+    }
+    return key;
+}
+
+// Returns the index of the separator between the directory and file name in the given path
+static size_t find_file_name_separator(std::string_view path)
+{
+    return path.find_last_of("\\/");
+}
+
+static void add_name(DirectoryListing& listing, std::string_view name)
+{
+    listing.names.emplace(name);
+
+    std::string loose_key = localfiles_index::loose_file_name_key(name);
+    if(!loose_key.empty())
+    {
+        listing.loose_names.emplace(std::move(loose_key), name);
+    }
+}
+
+static void remove_name(DirectoryListing& listing, std::string_view name)
+{
+    listing.names.erase(std::string(name));
+
+    const std::string loose_key = localfiles_index::loose_file_name_key(name);
+    const auto iter = listing.loose_names.find(loose_key);
+    if((iter == listing.loose_names.end()) || (iter->second != name))
+    {
+        return;
+    }
+    listing.loose_names.erase(iter);
+
+    // Another file might have the same key, in which case it should now be found instead
+    for(const std::string& other_name : listing.names)
+    {
+        if(localfiles_index::loose_file_name_key(other_name) == loose_key)
+        {
+            listing.loose_names.emplace(loose_key, other_name);
+            break;
+        }
+    }
+}
+
+static std::optional<std::string> find_name(const DirectoryListing& listing, std::string_view name)
+{
+    const std::string name_str(name);
+    if(listing.names.count(name_str) > 0)
+    {
+        return name_str;
+    }
+
+    const std::string loose_key = localfiles_index::loose_file_name_key(name);
+    if(loose_key.empty())
+    {
+        return {};
+    }
+
+    const auto iter = listing.loose_names.find(loose_key);
+    if(iter == listing.loose_names.end())
+    {
+        return {};
+    }
+    return iter->second;
+}
+
+static std::optional<DirectoryListing> list_directory(const std::string& directory, abort_callback& abort)
+{
+    DirectoryListing listing = {};
+    try
+    {
+        directory_callback_impl entries(false);
+        filesystem::g_list_directory(directory.c_str(), entries, abort);
+
+        for(size_t i=0; i<entries.get_count(); i++)
+        {
+            const std::string_view entry_path = entries.get_item(i);
+            add_name(listing, entry_path.substr(find_file_name_separator(entry_path) + 1));
+        }
+        LOG_INFO("Indexed %d files in lyrics directory %s", int(listing.names.size()), directory.c_str());
+    }
+    catch(const exception_io_not_found&)
+    {
+        // The directory doesn't exist (yet), so there are no files in it. If we save lyrics there later then we'll add them then.
+        LOG_INFO("Lyrics directory %s does not exist", directory.c_str());
+    }
+    catch(const std::exception& e)
+    {
+        LOG_WARN("Failed to list lyrics directory %s: %s", directory.c_str(), e.what());
+        return {};
+    }
+
+    listing.scan_time = filetimestamp_from_system_timer();
+    return listing;
+}
+
+static void evict_least_recently_used_directory()
+{
+    auto oldest = g_directories.begin();
+    for(auto iter = g_directories.begin(); iter != g_directories.end(); iter++)
+    {
+        if(iter->second.last_used_time < oldest->second.last_used_time)
+        {
+            oldest = iter;
+        }
+    }
+
+    if(oldest != g_directories.end())
+    {
+        g_directories.erase(oldest);
+    }
+}
+
+std::vector<std::string> localfiles_index::find_files(std::string_view path_prefix, const std::vector<std::string_view>& extensions, abort_callback& abort)
+{
+    const size_t separator_index = find_file_name_separator(path_prefix);
+    if(separator_index == std::string_view::npos)
+    {
+        LOG_WARN("Cannot search for lyric files with path prefix that contains no directory: %s", std::string(path_prefix).c_str());
+        return {};
+    }
+    const std::string directory(path_prefix.substr(0, separator_index));
+    const std::string_view name_prefix = path_prefix.substr(separator_index + 1);
+    const t_filetimestamp now = filetimestamp_from_system_timer();
+
+    bool needs_scan = false;
+    {
+        std::lock_guard lock(g_index_mutex);
+        const auto iter = g_directories.find(directory);
+        needs_scan = (iter == g_directories.end()) || ((iter->second.scan_time + RESCAN_INTERVAL) < now);
+    }
+
+    if(needs_scan)
+    {
+        // NOTE: We don't hold the lock while listing the directory because that might be slow (e.g on a network share)
+        //       and would block lookups in every other directory.
+        std::optional<DirectoryListing> listing = list_directory(directory, abort);
+        if(!listing.has_value())
+        {
+            return {};
+        }
+
+        std::lock_guard lock(g_index_mutex);
+        if((g_directories.count(directory) == 0) && (g_directories.size() >= MAX_INDEXED_DIRECTORIES))
+        {
+            evict_least_recently_used_directory();
+        }
+        g_directories[directory] = std::move(listing.value());
+    }
+
+    std::vector<std::string> output;
+    std::lock_guard lock(g_index_mutex);
+    const auto iter = g_directories.find(directory);
+    if(iter == g_directories.end())
+    {
+        return {};
+    }
+
+    DirectoryListing& listing = iter->second;
+    listing.last_used_time = now;
+    for(std::string_view extension : extensions)
+    {
+        std::string file_name(name_prefix);
+        file_name += extension;
+
+        std::optional<std::string> found_name = find_name(listing, file_name);
+        if(found_name.has_value())
+        {
+            if(found_name.value() != file_name)
+            {
+                LOG_INFO("Matched lyrics file %s for requested name %s", found_name.value().c_str(), file_name.c_str());
+            }
+            output.push_back(std::string(path_prefix.substr(0, separator_index + 1)) + found_name.value());
+        }
+    }
+    return output;
+}
+
+void localfiles_index::notify_file_saved(std::string_view path)
+{
+    const size_t separator_index = find_file_name_separator(path);
+    if(separator_index == std::string_view::npos)
+    {
+        return;
+    }
+
+    // NOTE: If we haven't listed this directory yet then there is nothing to update,
+    //       the file will be included when we do list it.
+    std::lock_guard lock(g_index_mutex);
+    const auto iter = g_directories.find(std::string(path.substr(0, separator_index)));
+    if(iter != g_directories.end())
+    {
+        add_name(iter->second, path.substr(separator_index + 1));
+    }
+}
+
+void localfiles_index::notify_file_deleted(std::string_view path)
+{
+    const size_t separator_index = find_file_name_separator(path);
+    if(separator_index == std::string_view::npos)
+    {
+        return;
+    }
+
+    std::lock_guard lock(g_index_mutex);
+    const auto iter = g_directories.find(std::string(path.substr(0, separator_index)));
+    if(iter != g_directories.end())
+    {
+        remove_name(iter->second, path.substr(separator_index + 1));
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "stdafx.h"
+
+namespace localfiles_index
+{
+    // Returns the full paths of the existing files named by the given path prefix followed by each of the given extensions.
+    // Files whose names differ from the requested name only in case or punctuation are also found (e.g "AC-DC - Back in Black.lrc"
+    // for "ACDC - Back In Black.lrc"), although an exact match is always preferred if there is one.
+    // Each directory is only enumerated the first time it is used (and again once its contents may have gone stale)
+    // so that repeated lookups in the same directory do not need to touch the filesystem at all.
+    std::vector<std::string> find_files(std::string_view path_prefix, const std::vector<std::string_view>& extensions, abort_callback& abort);
+
+    // Keep the index up-to-date with changes that we made ourselves
+    void notify_file_saved(std::string_view path);
+    void notify_file_deleted(std::string_view path);
+
+    // Returns the key by which a file name is looked up when ignoring case and punctuation,
+    // or an empty string if the name contains nothing but punctuation (and so should only ever match exactly).
+    OPENLYRICS_TESTABLE_FUNC std::string loose_file_name_key(std::string_view file_name);
+}
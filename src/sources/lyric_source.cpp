@@ -85,20 +85,16 @@ bool LyricSourceRemote::is_local() const
     return false;
 }
 
-std::vector<LyricDataRaw> LyricSourceRemote::search(metadb_handle_ptr /*track*/, const metadb_v2_rec_t& track_info, abort_callback& abort)
+std::vector<LyricDataRaw> LyricSourceRemote::search(metadb_handle_ptr /*track*/, const metadb_v2_rec_t& /*track_info*/, const TrackKey& track_key, abort_callback& abort)
 {
-    std::string artist = track_metadata(track_info, "artist");
-    std::string album = track_metadata(track_info, "album");
-    std::string title = track_metadata(track_info, "title");
-
-    if(preferences::searching::exclude_trailing_brackets())
-    {
-        artist = trim_surrounding_whitespace(trim_trailing_text_in_brackets(artist));
-        album = trim_surrounding_whitespace(trim_trailing_text_in_brackets(album));
-        title = trim_surrounding_whitespace(trim_trailing_text_in_brackets(title));
-    }
+    return search(track_key.search_artist, track_key.search_album, track_key.search_title, abort);
+}
 
-    return search(artist, album, title, abort);
+std::string LyricSourceRemote::get_save_path(metadb_handle_ptr /*track*/, const metadb_v2_rec_t& /*track_info*/, bool /*is_timestamped*/)
+{
+    LOG_WARN("Cannot save lyrics to a remote source");
+    assert(false);
+    return "";
 }
 
 std::string LyricSourceRemote::save(metadb_handle_ptr /*track*/, const metadb_v2_rec_t& /*track_info*/, bool /*is_timestamped*/, std::string_view /*lyrics*/, bool /*allow_ovewrite*/, abort_callback& /*abort*/)
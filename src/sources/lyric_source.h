@@ -3,6 +3,7 @@
 #include "stdafx.h"
 
 #include "lyric_data.h"
+#include "tag_util.h"
 #include "win32_util.h"
 
 // TODO: Add sources for:
@@ -21,12 +22,27 @@ public:
     virtual std::tstring_view friendly_name() const = 0;
     virtual bool is_local() const = 0;
 
-    virtual std::vector<LyricDataRaw> search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, abort_callback& abort) = 0;
+    virtual std::vector<LyricDataRaw> search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, const TrackKey& track_key, abort_callback& abort) = 0;
     virtual bool lookup(LyricDataRaw& data, abort_callback& abort) = 0;
 
+    // The number of search results that may be looked up at the same time when searching for lyrics.
+    // Sources with slow lookups that often fail for the first result can look up several at once so that
+    // we don't have to wait for each failure in turn. The results are still used in the order they were returned.
+    virtual size_t max_concurrent_lookups() const { return 1; }
+
+    // Returns the path (on this source) at which `save` will persist lyrics for the given track, without saving anything.
+    // Throws if the path cannot be determined.
+    virtual std::string get_save_path(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped) = 0;
+
+    // NOTE: This may be called from any thread. Sources that need to do some part of the save on the main thread
+    //       (e.g updating metadata) are responsible for getting themselves onto the main thread for that part.
     virtual std::string save(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped, std::string_view lyrics, bool allow_overwrite, abort_callback& abort) = 0;
     virtual bool delete_persisted(metadb_handle_ptr track, const std::string& path) = 0;
 
+    // Writes out anything that an earlier call to `save` queued up but has not yet written, and waits (for a bounded time) for it to complete.
+    // NOTE: This is only called on the main thread during shutdown, once every queued save has been passed to `save`.
+    virtual void flush_pending_saves() {}
+
     virtual std::tstring get_file_path(metadb_handle_ptr track, const LyricData& lyrics) = 0;
 
 protected:
@@ -38,7 +54,8 @@ class LyricSourceRemote : public LyricSourceBase
 {
 public:
     bool is_local() const final;
-    std::vector<LyricDataRaw> search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, abort_callback& abort) final;
+    std::vector<LyricDataRaw> search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, const TrackKey& track_key, abort_callback& abort) final;
+    std::string get_save_path(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped) final;
     std::string save(metadb_handle_ptr track, const metadb_v2_rec_t& track_info, bool is_timestamped, std::string_view lyrics, bool allow_overwrite, abort_callback& abort) final;
     bool delete_persisted(metadb_handle_ptr track, const std::string& path) final;
     std::tstring get_file_path(metadb_handle_ptr track, const LyricData& lyrics) final;
@@ -1,5 +1,7 @@
 #include "stdafx.h"
 #include <cctype>
+#include <list>
+#include <mutex>
 
 #include "cJSON.h"
 #include "pugixml.hpp"
@@ -19,9 +21,11 @@ class MetalArchivesSource : public LyricSourceRemote
 
     std::vector<LyricDataRaw> search(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort) final;
     bool lookup(LyricDataRaw& data, abort_callback& abort) final;
+    size_t max_concurrent_lookups() const final { return 3; }
 
 private:
-    std::vector<LyricDataRaw> parse_song_ids(cJSON* json) const;
+    std::vector<LyricDataRaw> parse_song_ids(cJSON* json, bool& out_is_complete) const;
+    std::vector<LyricDataRaw> query_songs(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort, bool& out_is_complete) const;
 };
 static const LyricSourceFactory<MetalArchivesSource> lnrc_factory;
 
@@ -100,8 +104,9 @@ static pugi::xml_document load_html(const char* src)
     return doc;
 }
 
-std::vector<LyricDataRaw> MetalArchivesSource::parse_song_ids(cJSON* json) const
+std::vector<LyricDataRaw> MetalArchivesSource::parse_song_ids(cJSON* json, bool& out_is_complete) const
 {
+    out_is_complete = false;
     if((json == nullptr) || (json->type != cJSON_Object))
     {
         LOG_INFO("Root object is null or not an object");
@@ -179,11 +184,63 @@ std::vector<LyricDataRaw> MetalArchivesSource::parse_song_ids(cJSON* json) const
         output.push_back(std::move(data));
     }
 
+    // Results are paginated, so we only have every matching song if there were no more than fit on one page
+    const cJSON* total_records_item = cJSON_GetObjectItem(json, "iTotalRecords");
+    if((total_records_item != nullptr) && (total_records_item->type == cJSON_Number))
+    {
+        out_is_complete = (total_records_item->valueint == result_arr_len);
+    }
+    else
+    {
+        LOG_INFO("No valid 'iTotalRecords' property available");
+    }
+
     return output;
 }
 
-std::vector<LyricDataRaw> MetalArchivesSource::search(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort)
+// Searching for a song returns the lyric IDs for every matching song, and searching with an empty
+// song title returns every song on the matching release(s). Tracks from the same release are usually
+// played (or bulk-searched) together, so we search for whole releases and keep the results around.
+// That way the rest of the release only needs to make the (unavoidable) lyric lookup requests.
+struct CachedRelease
+{
+    std::string artist;
+    std::string album;
+    std::vector<LyricDataRaw> tracks;
+};
+static const size_t MAX_CACHED_RELEASES = 16;
+static std::mutex g_release_cache_mutex;
+static std::list<CachedRelease> g_release_cache; // Ordered from most- to least-recently used
+
+static std::optional<std::vector<LyricDataRaw>> find_cached_release(std::string_view artist, std::string_view album)
+{
+    std::lock_guard lock(g_release_cache_mutex);
+    for(auto iter = g_release_cache.begin(); iter != g_release_cache.end(); iter++)
+    {
+        if((iter->artist == artist) && (iter->album == album))
+        {
+            g_release_cache.splice(g_release_cache.begin(), g_release_cache, iter);
+            return g_release_cache.front().tracks;
+        }
+    }
+    return {};
+}
+
+static void add_cached_release(std::string_view artist, std::string_view album, const std::vector<LyricDataRaw>& tracks)
 {
+    std::lock_guard lock(g_release_cache_mutex);
+    const auto release_matches = [artist, album](const CachedRelease& release) { return (release.artist == artist) && (release.album == album); };
+    g_release_cache.remove_if(release_matches); // In case another search retrieved the same release at the same time
+    g_release_cache.push_front({std::string(artist), std::string(album), tracks});
+    if(g_release_cache.size() > MAX_CACHED_RELEASES)
+    {
+        g_release_cache.pop_back();
+    }
+}
+
+std::vector<LyricDataRaw> MetalArchivesSource::query_songs(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort, bool& out_is_complete) const
+{
+    out_is_complete = false;
     http_request::ptr request = http_client::get()->create_request("GET");
 
     const std::string url_artist = urlencode(artist);
@@ -209,13 +266,59 @@ std::vector<LyricDataRaw> MetalArchivesSource::search(std::string_view artist, s
     }
 
     cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
-    std::vector<LyricDataRaw> song_ids = parse_song_ids(json);
+    std::vector<LyricDataRaw> song_ids = parse_song_ids(json, out_is_complete);
     cJSON_Delete(json);
     LOG_INFO("Retrieved %d tracks from %s", int(song_ids.size()), url.c_str());
 
     return song_ids;
 }
 
+std::vector<LyricDataRaw> MetalArchivesSource::search(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort)
+{
+    bool is_complete = false;
+    if(album.empty())
+    {
+        // Without an album we'd be retrieving every song by the artist, which is far more than we need
+        return query_songs(artist, album, title, abort, is_complete);
+    }
+
+    std::optional<std::vector<LyricDataRaw>> release_tracks = find_cached_release(artist, album);
+    if(release_tracks.has_value())
+    {
+        LOG_INFO("Using previously-retrieved metal-archives.com results for release %s - %s", std::string(artist).c_str(), std::string(album).c_str());
+    }
+    else
+    {
+        release_tracks = query_songs(artist, album, "", abort, is_complete);
+
+        // NOTE: The artist & album are substring matches on the server, so short names (e.g "Live" or "Demo")
+        //       can match far more songs than fit in a single page of results. We only keep results that
+        //       we know contain the whole release, otherwise other tracks could be missing from the cache.
+        if(is_complete && !release_tracks.value().empty())
+        {
+            add_cached_release(artist, album, release_tracks.value());
+        }
+    }
+
+    std::vector<LyricDataRaw> song_ids;
+    for(LyricDataRaw& track : release_tracks.value())
+    {
+        if(tag_values_match(track.title, title))
+        {
+            song_ids.push_back(std::move(track));
+        }
+    }
+
+    if(song_ids.empty())
+    {
+        // The track may not have been in the page of results that we got for the release, or its title may
+        // only match the server's (looser) title matching, so fall back to asking the server for this track.
+        LOG_INFO("Track not found in metal-archives.com results for release %s - %s, searching for it directly", std::string(artist).c_str(), std::string(album).c_str());
+        song_ids = query_songs(artist, album, title, abort, is_complete);
+    }
+    return song_ids;
+}
+
 bool MetalArchivesSource::lookup(LyricDataRaw& data, abort_callback& abort)
 {
     assert(data.source_id == id());
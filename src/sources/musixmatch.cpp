@@ -1,10 +1,11 @@
 #include "stdafx.h"
 
-#include "cJSON.h"
+#include <mutex>
 
 #include "logging.h"
 #include "lyric_data.h"
 #include "lyric_source.h"
+#include "parsers.h"
 
 static const GUID src_guid = { 0xf94ba31a, 0x7b33, 0x49e4, { 0x81, 0x9b, 0x0, 0xc, 0x36, 0x44, 0x29, 0xcd } };
 
@@ -13,6 +14,7 @@ struct SongSearchResult
     int64_t track_id;
     bool has_synced_lyrics;
     bool has_unsynced_lyrics;
+    int request_count; // The number of requests made to Musixmatch to find this result
 };
 
 class MusixmatchLyricsSource : public LyricSourceRemote
@@ -22,28 +24,47 @@ class MusixmatchLyricsSource : public LyricSourceRemote
 
     std::vector<LyricDataRaw> search(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort) final;
     bool lookup(LyricDataRaw& data, abort_callback& abort) final;
+    size_t max_concurrent_lookups() const final { return 2; } // Keep this low, Musixmatch is quick to rate-limit tokens
 
 private:
-    std::vector<LyricDataRaw> get_song_ids(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort) const;
-    bool get_lyrics(LyricDataRaw& data, int64_t track_id, abort_callback& abort, const char* method, const char* body_entry_name, const char* text_entry_name) const;
-    bool get_unsynced_lyrics(LyricDataRaw& data, int64_t track_id, abort_callback& abort) const;
-    bool get_synced_lyrics(LyricDataRaw& data, int64_t track_id, abort_callback& abort) const;
+    std::optional<LyricDataRaw> get_macro_lyrics(std::string_view artist, std::string_view album, std::string_view title, const std::string& token, abort_callback& abort) const;
+    std::vector<LyricDataRaw> get_song_ids(std::string_view artist, std::string_view album, std::string_view title, const std::string& token, int previous_request_count, abort_callback& abort) const;
+    bool get_lyrics(LyricDataRaw& data, int64_t track_id, const std::string& token, abort_callback& abort, const char* method, const char* body_entry_name, const char* text_entry_name) const;
+    bool get_unsynced_lyrics(LyricDataRaw& data, int64_t track_id, const std::string& token, abort_callback& abort) const;
+    bool get_synced_lyrics(LyricDataRaw& data, int64_t track_id, const std::string& token, abort_callback& abort) const;
 };
 static const LyricSourceFactory<MusixmatchLyricsSource> src_factory;
 
 static const char* g_api_url = "https://apic-desktop.musixmatch.com/ws/1.1/";
 static const char* g_common_params = "user_language=en&app_id=web-desktop-app-v1.0";
 
+// NOTE: Musixmatch doesn't tell us how long the tokens that it gives us are valid for,
+//       so we just refresh them periodically in the background.
+static const t_filetimestamp TOKEN_LIFETIME = system_time_periods::day;
+static const t_filetimestamp TOKEN_REFRESH_RETRY_INTERVAL = 10 * 60 * system_time_periods::second;
+
+// The token that we send with every request. This starts out as the token given in the preferences, but if
+// Musixmatch tells us that it is no longer valid then we fetch a new one in the background and share that
+// between all subsequent searches (until the token in the preferences is changed).
+static std::mutex g_token_mutex;
+static std::string g_token_configured; // The preferences value from which g_token was derived
+static std::string g_token;
+static t_filetimestamp g_token_refresh_time = 0; // When the current token should be refreshed, or 0 if it doesn't need to be
+static t_filetimestamp g_token_next_refresh_attempt = 0;
+static bool g_token_refresh_in_progress = false;
+
 static std::string EncodeSearchResult(SongSearchResult search_result)
 {
     std::string output;
     output += (search_result.has_unsynced_lyrics ? '1' : '0');
     output += (search_result.has_synced_lyrics ? '1' : '0');
     output += std::to_string(search_result.track_id);
+    output += ':';
+    output += std::to_string(search_result.request_count);
     return output;
 }
 
-static std::optional<SongSearchResult> DecodeSearchResult(std::string_view str)
+static std::optional<SongSearchResult> DecodeSearchResult(const std::string& str)
 {
     if(str.length() < 3)
     {
@@ -61,245 +82,433 @@ static std::optional<SongSearchResult> DecodeSearchResult(std::string_view str)
     SongSearchResult result = {};
     result.has_unsynced_lyrics = (str[0] == '1');
     result.has_synced_lyrics = (str[1] == '1');
-    result.track_id = strtoll(&str[2], nullptr, 10);
+
+    char* track_id_end = nullptr;
+    result.track_id = strtoll(&str[2], &track_id_end, 10);
+    result.request_count = (*track_id_end == ':') ? atoi(track_id_end + 1) : 1;
     return result;
 }
 
-std::vector<LyricDataRaw> MusixmatchLyricsSource::get_song_ids(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort) const
+// NOTE: Must be called with g_token_mutex held
+static void start_token_refresh()
 {
-    const std::string_view apikey = preferences::searching::musixmatch_api_key();
-    std::string url = std::string(g_api_url) + "track.search?" + g_common_params + "&subtitle_format=lrc";
-    url += "&q_artist=" + urlencode(artist);
-    url += "&q_album=" + urlencode(album);
-    url += "&q_track=" + urlencode(title);
-    url += "&usertoken=";
-    LOG_INFO("Querying for track ID from %s", url.c_str());
-    url +=  apikey; // Add this after logging so we don't log sensitive info
-
-    pfc::string8 content;
-    try
+    const t_filetimestamp now = filetimestamp_from_system_timer();
+    if(g_token_refresh_in_progress || (now < g_token_next_refresh_attempt))
     {
-        http_request::ptr request = http_client::get()->create_request("GET");
+        return;
+    }
+    g_token_refresh_in_progress = true;
+    g_token_next_refresh_attempt = now + TOKEN_REFRESH_RETRY_INTERVAL;
 
-        // NOTE: Without adding the AWSELB and AWSELBCORS headers, we get a 301 (permanent redirect back)
-        //       with a header instructing us to set those cookies to the given hash.
-        //       The fb2k http API automatically follows the redirect but does not honour the Set-Cookie headers.
-        //       The redirect goes to the same URL and the request then fails after a while (presumably because
-        //       ELB thinks we're DoS'ing them and kills the connection).
-        //       Setting the headers here to just *some* value (even if its not a useful one) seems to make it work.
-        //       We may need to upgrade this in future to actually set the cookies that we're asked to set.
-        request->add_header("cookie", "AWSELBCORS=0; AWSELB=0");
+    fb2k::splitTask([](){
+        abort_callback& abort = async_task_manager::get()->get_aborter();
+        const std::string new_token = musixmatch_get_token(abort);
 
-        file_ptr response_file = request->run(url.c_str(), abort);
+        std::lock_guard<std::mutex> lock(g_token_mutex);
+        g_token_refresh_in_progress = false;
+        if(new_token.empty())
+        {
+            LOG_WARN("Failed to refresh the Musixmatch token, will continue using the existing one");
+        }
+        else
+        {
+            LOG_INFO("Refreshed the Musixmatch token");
+            g_token = new_token;
+            g_token_refresh_time = filetimestamp_from_system_timer() + TOKEN_LIFETIME;
+        }
+    });
+}
 
-        response_file->read_string_raw(content, abort);
-    }
-    catch(const std::exception& e)
+static std::string get_user_token()
+{
+    std::lock_guard<std::mutex> lock(g_token_mutex);
+
+    const std::string_view configured = preferences::searching::musixmatch_api_key();
+    if(configured != g_token_configured)
     {
-        LOG_WARN("Failed to make Musixmatch search request: %s", e.what());
-        return {};
+        g_token_configured = configured;
+        g_token = configured;
+        g_token_refresh_time = 0;
     }
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
-    if((json == nullptr) || (json->type != cJSON_Object))
+    if((g_token_refresh_time != 0) && (filetimestamp_from_system_timer() >= g_token_refresh_time))
     {
-        LOG_WARN("Received musixmatch search result but root was malformed: %s", content.c_str());
-        cJSON_Delete(json);
-        return {};
+        // Keep using the current token until the new one arrives, rather than making every search wait for it
+        start_token_refresh();
     }
+    return g_token;
+}
 
-    cJSON* json_message = cJSON_GetObjectItem(json, "message");
-    if((json_message == nullptr) || (json_message->type != cJSON_Object))
+static void check_status_code(int status_code, const std::string& token)
+{
+    if(status_code != 401)
     {
-        LOG_WARN("Received musixmatch search result but message was malformed: %s", content.c_str());
-        cJSON_Delete(json);
-        return {};
+        return;
     }
 
-    cJSON* json_body = cJSON_GetObjectItem(json_message, "body");
-    if((json_body == nullptr) || (json_body->type != cJSON_Object))
+    std::lock_guard<std::mutex> lock(g_token_mutex);
+    if(token == g_token)
     {
-        LOG_WARN("Received musixmatch search result but body was malformed: %s", content.c_str());
-        cJSON_Delete(json);
-        return {};
+        LOG_WARN("Musixmatch rejected the current token, requesting a new one...");
+        start_token_refresh();
     }
+}
+
+static pfc::string8 make_request(const std::string& url, abort_callback& abort)
+{
+    http_request::ptr request = http_client::get()->create_request("GET");
+
+    // NOTE: Without adding the AWSELB and AWSELBCORS headers, we get a 301 (permanent redirect back)
+    //       with a header instructing us to set those cookies to the given hash.
+    //       The fb2k http API automatically follows the redirect but does not honour the Set-Cookie headers.
+    //       The redirect goes to the same URL and the request then fails after a while (presumably because
+    //       ELB thinks we're DoS'ing them and kills the connection).
+    //       Setting the headers here to just *some* value (even if its not a useful one) seems to make it work.
+    //       We may need to upgrade this in future to actually set the cookies that we're asked to set.
+    request->add_header("cookie", "AWSELBCORS=0; AWSELB=0");
+
+    file_ptr response_file = request->run(url.c_str(), abort);
+
+    pfc::string8 content;
+    response_file->read_string_raw(content, abort);
+    return content;
+}
 
-    cJSON* json_tracklist = cJSON_GetObjectItem(json_body, "track_list");
-    if((json_tracklist == nullptr) || (json_tracklist->type != cJSON_Array))
+// Positions the reader inside the message.body object that wraps every Musixmatch API response.
+// The status code in the message header is returned if it comes before the body.
+static bool enter_message_body(parsers::json::Reader& reader, int& out_status_code)
+{
+    out_status_code = 0;
+    if(!reader.enter_object() || !reader.find_key("message") || (reader.peek() != parsers::json::ValueType::Object) || !reader.enter_object())
     {
-        LOG_WARN("Received musixmatch search result but track_list was malformed: %s", content.c_str());
-        cJSON_Delete(json);
-        return {};
+        return false;
     }
 
-    std::vector<LyricDataRaw> results;
-    cJSON* json_track = nullptr;
-    cJSON_ArrayForEach(json_track, json_tracklist)
+    bool seen_header = false;
+    std::string_view key;
+    while(reader.next_key(key))
     {
-        if((json_track == nullptr) || (json_track->type != cJSON_Object))
+        if(key == "body")
         {
-            LOG_WARN("Received musixmatch search result but track was malformed: %s", content.c_str());
-            break;
+            return (reader.peek() == parsers::json::ValueType::Object) && reader.enter_object();
         }
-
-        cJSON* json_tracktrack = cJSON_GetObjectItem(json_track, "track");
-        if((json_tracktrack == nullptr) || (json_tracktrack->type != cJSON_Object))
+        else if((key == "header") && parsers::json::is_first_occurrence(seen_header) && (reader.peek() == parsers::json::ValueType::Object))
         {
-            LOG_WARN("Received musixmatch search result but tracktrack was malformed: %s", content.c_str());
-            break;
+            reader.enter_object();
+            if(reader.find_key("status_code"))
+            {
+                double status_code = 0.0;
+                if((reader.peek() == parsers::json::ValueType::Number) && reader.read_number(status_code))
+                {
+                    out_status_code = int(status_code);
+                }
+                else
+                {
+                    reader.skip_value();
+                }
+                reader.exit_object();
+            }
         }
-
-        cJSON* json_artist = cJSON_GetObjectItem(json_tracktrack, "artist_name");
-        if((json_artist == nullptr) || (json_artist->type != cJSON_String))
+        else
         {
-            LOG_WARN("Received musixmatch search result but artist_name was malformed");
-            break;
+            reader.skip_value();
         }
+    }
+    return false;
+}
 
-        cJSON* json_album = cJSON_GetObjectItem(json_tracktrack, "album_name");
-        if((json_album == nullptr) || (json_album->type != cJSON_String))
+// Reads the members of a track object, returning false if any of the fields that we need are missing
+static bool read_track(parsers::json::Reader& reader, LyricDataRaw& data, SongSearchResult& result)
+{
+    std::optional<double> track_id;
+    std::optional<double> has_lyrics;
+    std::optional<double> has_subtitles;
+    bool has_artist = false;
+    bool has_album = false;
+    bool has_title = false;
+
+    bool seen_artist = false;
+    bool seen_album = false;
+    bool seen_title = false;
+    bool seen_has_lyrics = false;
+    bool seen_has_subtitles = false;
+    bool seen_track_id = false;
+    std::string_view key;
+    while(reader.next_key(key))
+    {
+        using parsers::json::is_first_occurrence;
+        const parsers::json::ValueType value_type = reader.peek();
+        double number = 0.0;
+        if((key == "artist_name") && is_first_occurrence(seen_artist) && (value_type == parsers::json::ValueType::String))
         {
-            LOG_WARN("Received musixmatch search result but album_name was malformed");
-            break;
+            has_artist = reader.read_string(data.artist);
         }
-
-        cJSON* json_title = cJSON_GetObjectItem(json_tracktrack, "track_name");
-        if((json_title == nullptr) || (json_title->type != cJSON_String))
+        else if((key == "album_name") && is_first_occurrence(seen_album) && (value_type == parsers::json::ValueType::String))
         {
-            LOG_WARN("Received musixmatch search result but track_name was malformed");
-            break;
+            has_album = reader.read_string(data.album);
         }
-
-        cJSON* json_haslyrics = cJSON_GetObjectItem(json_tracktrack, "has_lyrics");
-        if((json_haslyrics == nullptr) || (json_haslyrics->type != cJSON_Number))
+        else if((key == "track_name") && is_first_occurrence(seen_title) && (value_type == parsers::json::ValueType::String))
         {
-            LOG_WARN("Received musixmatch search result but has-lyrics was malformed: %s", content.c_str());
-            break;
+            has_title = reader.read_string(data.title);
         }
-
-        cJSON* json_hassubtitles = cJSON_GetObjectItem(json_tracktrack, "has_subtitles");
-        if((json_hassubtitles == nullptr) || (json_hassubtitles->type != cJSON_Number))
+        else if((key == "has_lyrics") && is_first_occurrence(seen_has_lyrics) && (value_type == parsers::json::ValueType::Number) && reader.read_number(number))
         {
-            LOG_WARN("Received musixmatch search result but has-subtitles was malformed: %s", content.c_str());
-            break;
+            has_lyrics = number;
         }
-
-        cJSON* json_trackid = cJSON_GetObjectItem(json_tracktrack, "commontrack_id");
-        if((json_tracktrack == nullptr) || (json_trackid->type != cJSON_Number))
+        else if((key == "has_subtitles") && is_first_occurrence(seen_has_subtitles) && (value_type == parsers::json::ValueType::Number) && reader.read_number(number))
         {
-            LOG_WARN("Received musixmatch search result but track ID was malformed: %s", content.c_str());
-            break;
+            has_subtitles = number;
         }
+        else if((key == "commontrack_id") && is_first_occurrence(seen_track_id) && (value_type == parsers::json::ValueType::Number) && reader.read_number(number))
+        {
+            track_id = number;
+        }
+        else
+        {
+            reader.skip_value();
+        }
+    }
 
-        SongSearchResult search_result = {};
-        search_result.track_id = json_trackid->valueint;
-        search_result.has_unsynced_lyrics = (json_haslyrics->valueint != 0);
-        search_result.has_synced_lyrics = (json_hassubtitles->valueint != 0);
+    if(reader.failed() || !has_artist || !has_album || !has_title || !has_lyrics.has_value() || !has_subtitles.has_value() || !track_id.has_value())
+    {
+        return false;
+    }
 
-        LyricDataRaw data = {};
-        data.source_id = id();
-        data.artist = json_artist->valuestring;
-        data.album = json_album->valuestring;
-        data.title = json_title->valuestring;
-        data.lookup_id = EncodeSearchResult(search_result);
-        results.push_back(std::move(data));
+    result.track_id = (int64_t)track_id.value();
+    result.has_unsynced_lyrics = (has_lyrics.value() != 0.0);
+    result.has_synced_lyrics = (has_subtitles.value() != 0.0);
+    return true;
+}
+
+// Returns the text from a message.body.<body_entry_name>.<text_entry_name> response, or an empty string if there isn't any
+static std::string read_lyric_text(std::string_view json, const char* body_entry_name, const char* text_entry_name, int& out_status_code)
+{
+    parsers::json::Reader reader(json);
+    if(!enter_message_body(reader, out_status_code) ||
+        !reader.find_key(body_entry_name) || (reader.peek() != parsers::json::ValueType::Object) || !reader.enter_object() ||
+        !reader.find_key(text_entry_name) || (reader.peek() != parsers::json::ValueType::String))
+    {
+        return "";
     }
 
-    cJSON_Delete(json);
-    return results;
+    std::string text;
+    reader.read_string(text);
+    return text;
 }
 
-bool MusixmatchLyricsSource::get_lyrics(LyricDataRaw& data, int64_t track_id, abort_callback& abort, const char* method, const char* body_entry_name, const char* text_entry_name) const
+// Returns the text of the first subtitle in a macro track.subtitles.get response, or an empty string if there isn't one
+static std::string read_subtitle_list_text(std::string_view json)
 {
-    assert(data.source_id == id());
+    parsers::json::Reader reader(json);
+    int status_code = 0;
+    if(!enter_message_body(reader, status_code) ||
+        !reader.find_key("subtitle_list") || (reader.peek() != parsers::json::ValueType::Array) || !reader.enter_array() ||
+        !reader.next_element() || (reader.peek() != parsers::json::ValueType::Object) || !reader.enter_object() ||
+        !reader.find_key("subtitle") || (reader.peek() != parsers::json::ValueType::Object) || !reader.enter_object() ||
+        !reader.find_key("subtitle_body") || (reader.peek() != parsers::json::ValueType::String))
+    {
+        return "";
+    }
 
-    const std::string_view apikey = preferences::searching::musixmatch_api_key();
-    std::string url = std::string(g_api_url) + method + "?" + g_common_params + "&commontrack_id=" + std::to_string(track_id) + "&usertoken=";
-    LOG_INFO("Get Musixmatch lyrics from %s", url.c_str());
-    url += apikey; // Add this after logging so we don't log sensitive info
-    data.source_path = url;
+    std::string text;
+    reader.read_string(text);
+    return text;
+}
+
+std::optional<LyricDataRaw> MusixmatchLyricsSource::get_macro_lyrics(std::string_view artist, std::string_view album, std::string_view title, const std::string& token, abort_callback& abort) const
+{
+    // NOTE: The macro call does the track matching and fetches both kinds of lyrics for the matched track
+    //       all in one go, so in the common case we only need to make a single request.
+    std::string url = std::string(g_api_url) + "macro.subtitles.get?" + g_common_params + "&format=json&namespace=lyrics_richsynched&subtitle_format=lrc";
+    url += "&q_artist=" + urlencode(artist);
+    url += "&q_album=" + urlencode(album);
+    url += "&q_track=" + urlencode(title);
+    url += "&usertoken=";
+    LOG_INFO("Querying for lyrics from %s", url.c_str());
+    const std::string source_path = url; // Take this before adding the token so that we don't store sensitive info
+    url += token; // Add this after logging so we don't log sensitive info
 
     pfc::string8 content;
     try
     {
-        http_request::ptr request = http_client::get()->create_request("GET");
-        request->add_header("cookie", "AWSELBCORS=0; AWSELB=0"); // NOTE: See the comment on the cookie in the track ID query
+        content = make_request(url, abort);
+    }
+    catch(const std::exception& e)
+    {
+        LOG_WARN("Failed to make Musixmatch macro request: %s", e.what());
+        return {};
+    }
 
-        file_ptr response_file = request->run(url.c_str(), abort);
+    parsers::json::Reader reader(std::string_view(content.c_str(), content.get_length()));
+    int status_code = 0;
+    if(!enter_message_body(reader, status_code) || !reader.find_key("macro_calls") || (reader.peek() != parsers::json::ValueType::Object))
+    {
+        check_status_code(status_code, token);
+        LOG_INFO("Received musixmatch macro response but macro_calls was malformed: %s", content.c_str());
+        return {};
+    }
+    reader.enter_object();
 
-        response_file->read_string_raw(content, abort);
+    std::string_view matcher_json;
+    std::string_view lyrics_json;
+    std::string_view subtitles_json;
+    std::string_view key;
+    while(reader.next_key(key))
+    {
+        // The first of any duplicate keys is used, see parsers::json::is_first_occurrence
+        if((key == "matcher.track.get") && matcher_json.empty()) reader.read_raw(matcher_json);
+        else if((key == "track.lyrics.get") && lyrics_json.empty()) reader.read_raw(lyrics_json);
+        else if((key == "track.subtitles.get") && subtitles_json.empty()) reader.read_raw(subtitles_json);
+        else reader.skip_value();
     }
-    catch(const std::exception& e)
+
+    LyricDataRaw data = {};
+    data.source_id = id();
+    data.source_path = source_path;
+
+    SongSearchResult track = {};
+    parsers::json::Reader matcher_reader(matcher_json);
+    if(!enter_message_body(matcher_reader, status_code) ||
+        !matcher_reader.find_key("track") || (matcher_reader.peek() != parsers::json::ValueType::Object) || !matcher_reader.enter_object() ||
+        !read_track(matcher_reader, data, track))
     {
-        LOG_WARN("Failed to make Musixmatch %s request: %s", method, e.what());
-        return false;
+        check_status_code(status_code, token);
+        LOG_INFO("Musixmatch macro request did not match any track");
+        return {};
     }
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
-    if((json == nullptr) || (json->type != cJSON_Object))
+    std::string lyric_text;
+    if(track.has_synced_lyrics)
     {
-        LOG_INFO("Received musixmatch %s response but root was malformed: %s", method, content.c_str());
-        cJSON_Delete(json);
-        return false;
+        lyric_text = read_subtitle_list_text(subtitles_json);
+    }
+    if(lyric_text.empty() && track.has_unsynced_lyrics)
+    {
+        lyric_text = read_lyric_text(lyrics_json, "lyrics", "lyrics_body", status_code);
     }
 
-    cJSON* json_message = cJSON_GetObjectItem(json, "message");
-    if((json_message == nullptr) || (json_message->type != cJSON_Object))
+    if(lyric_text.empty())
     {
-        LOG_INFO("Received musixmatch %s response but message was malformed: %s", method, content.c_str());
-        cJSON_Delete(json);
-        return false;
+        LOG_INFO("Musixmatch macro request matched track %lld but did not return any lyrics for it", (long long)track.track_id);
+        return {};
     }
 
-    cJSON* json_body = cJSON_GetObjectItem(json_message, "body");
-    if((json_body == nullptr) || (json_body->type != cJSON_Object))
+    data.text_bytes = string_to_raw_bytes(lyric_text);
+    return data;
+}
+
+std::vector<LyricDataRaw> MusixmatchLyricsSource::get_song_ids(std::string_view artist, std::string_view album, std::string_view title, const std::string& token, int previous_request_count, abort_callback& abort) const
+{
+    std::string url = std::string(g_api_url) + "track.search?" + g_common_params + "&subtitle_format=lrc";
+    url += "&q_artist=" + urlencode(artist);
+    url += "&q_album=" + urlencode(album);
+    url += "&q_track=" + urlencode(title);
+    url += "&usertoken=";
+    LOG_INFO("Querying for track ID from %s", url.c_str());
+    url += token; // Add this after logging so we don't log sensitive info
+
+    pfc::string8 content;
+    try
     {
-        LOG_INFO("Received musixmatch %s response but body was malformed: %s", method, content.c_str());
-        cJSON_Delete(json);
-        return false;
+        content = make_request(url, abort);
+    }
+    catch(const std::exception& e)
+    {
+        LOG_WARN("Failed to make Musixmatch search request: %s", e.what());
+        return {};
     }
 
-    cJSON* json_lyrics = cJSON_GetObjectItem(json_body, body_entry_name);
-    if((json_lyrics == nullptr) || (json_lyrics->type != cJSON_Object))
+    parsers::json::Reader reader(std::string_view(content.c_str(), content.get_length()));
+    int status_code = 0;
+    if(!enter_message_body(reader, status_code))
     {
-        LOG_INFO("Received musixmatch %s response but %s was malformed: %s", method, body_entry_name, content.c_str());
-        cJSON_Delete(json);
-        return false;
+        check_status_code(status_code, token);
+        LOG_WARN("Received musixmatch search result but message body was malformed: %s", content.c_str());
+        return {};
+    }
+
+    if(!reader.find_key("track_list") || (reader.peek() != parsers::json::ValueType::Array))
+    {
+        LOG_WARN("Received musixmatch search result but track_list was malformed: %s", content.c_str());
+        return {};
+    }
+    reader.enter_array();
+
+    std::vector<LyricDataRaw> results;
+    while(reader.next_element())
+    {
+        if((reader.peek() != parsers::json::ValueType::Object) || !reader.enter_object() ||
+            !reader.find_key("track") || (reader.peek() != parsers::json::ValueType::Object) || !reader.enter_object())
+        {
+            LOG_WARN("Received musixmatch search result but track was malformed: %s", content.c_str());
+            break;
+        }
+
+        LyricDataRaw data = {};
+        data.source_id = id();
+        SongSearchResult search_result = {};
+        if(!read_track(reader, data, search_result))
+        {
+            LOG_WARN("Received musixmatch search result but track was malformed: %s", content.c_str());
+            break;
+        }
+        reader.exit_object(); // Skip anything else that was included alongside the track
+
+        search_result.request_count = previous_request_count + 1;
+        data.lookup_id = EncodeSearchResult(search_result);
+        results.push_back(std::move(data));
     }
 
-    cJSON* json_lyricstext = cJSON_GetObjectItem(json_lyrics, text_entry_name);
-    if((json_lyricstext == nullptr) || (json_lyricstext->type != cJSON_String))
+    return results;
+}
+
+bool MusixmatchLyricsSource::get_lyrics(LyricDataRaw& data, int64_t track_id, const std::string& token, abort_callback& abort, const char* method, const char* body_entry_name, const char* text_entry_name) const
+{
+    assert(data.source_id == id());
+
+    std::string url = std::string(g_api_url) + method + "?" + g_common_params + "&commontrack_id=" + std::to_string(track_id) + "&usertoken=";
+    LOG_INFO("Get Musixmatch lyrics from %s", url.c_str());
+    data.source_path = url; // Set this before adding the token so that we don't store sensitive info
+    url += token; // Add this after logging so we don't log sensitive info
+
+    pfc::string8 content;
+    try
+    {
+        content = make_request(url, abort);
+    }
+    catch(const std::exception& e)
     {
-        LOG_INFO("Received musixmatch %s response but %s was malformed: %s", method, text_entry_name, content.c_str());
-        cJSON_Delete(json);
+        LOG_WARN("Failed to make Musixmatch %s request: %s", method, e.what());
         return false;
     }
 
-    if(strlen(json_lyricstext->valuestring) == 0)
+    int status_code = 0;
+    const std::string lyric_text = read_lyric_text(std::string_view(content.c_str(), content.get_length()), body_entry_name, text_entry_name, status_code);
+    check_status_code(status_code, token);
+    if(lyric_text.empty())
     {
-        LOG_INFO("Received an empty lyric string from musixmatch, no lyrics will be returned");
-        cJSON_Delete(json);
+        LOG_INFO("Received musixmatch %s response but it did not contain any %s.%s: %s", method, body_entry_name, text_entry_name, content.c_str());
         return false;
     }
 
-    data.text_bytes = string_to_raw_bytes(json_lyricstext->valuestring);
-    cJSON_Delete(json);
+    data.text_bytes = string_to_raw_bytes(lyric_text);
     return true;
 }
 
-bool MusixmatchLyricsSource::get_unsynced_lyrics(LyricDataRaw& data, int64_t track_id, abort_callback& abort) const
+bool MusixmatchLyricsSource::get_unsynced_lyrics(LyricDataRaw& data, int64_t track_id, const std::string& token, abort_callback& abort) const
 {
-    return get_lyrics(data, track_id, abort, "track.lyrics.get", "lyrics", "lyrics_body");
+    return get_lyrics(data, track_id, token, abort, "track.lyrics.get", "lyrics", "lyrics_body");
 }
 
-bool MusixmatchLyricsSource::get_synced_lyrics(LyricDataRaw& data, int64_t track_id, abort_callback& abort) const
+bool MusixmatchLyricsSource::get_synced_lyrics(LyricDataRaw& data, int64_t track_id, const std::string& token, abort_callback& abort) const
 {
-    return get_lyrics(data, track_id, abort, "track.subtitle.get", "subtitle", "subtitle_body");
+    return get_lyrics(data, track_id, token, abort, "track.subtitle.get", "subtitle", "subtitle_body");
 }
 
 std::vector<LyricDataRaw> MusixmatchLyricsSource::search(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort)
 {
-    if(preferences::searching::musixmatch_api_key().empty())
+    const std::string token = get_user_token();
+    if(token.empty())
     {
         // An API key is required.
         // Skip the search if we don't have one so we don't accidentally spam their servers with obviously-bad requests.
@@ -307,7 +516,21 @@ std::vector<LyricDataRaw> MusixmatchLyricsSource::search(std::string_view artist
         return {};
     }
 
-    return get_song_ids(artist, album, title, abort);
+    int request_count = 0;
+    if(!artist.empty() && !title.empty())
+    {
+        std::optional<LyricDataRaw> macro_result = get_macro_lyrics(artist, album, title, token, abort);
+        if(macro_result.has_value())
+        {
+            LOG_INFO("Retrieved Musixmatch lyrics in 1 round-trip");
+            std::vector<LyricDataRaw> results;
+            results.push_back(std::move(macro_result.value()));
+            return results;
+        }
+        request_count++;
+    }
+
+    return get_song_ids(artist, album, title, token, request_count, abort);
 }
 
 bool MusixmatchLyricsSource::lookup(LyricDataRaw& data, abort_callback& abort)
@@ -326,18 +549,22 @@ bool MusixmatchLyricsSource::lookup(LyricDataRaw& data, abort_callback& abort)
         return false;
     }
 
+    const std::string token = get_user_token();
+    bool success = false;
     if(search_result.has_synced_lyrics)
     {
-        return get_synced_lyrics(data, search_result.track_id, abort);
+        success = get_synced_lyrics(data, search_result.track_id, token, abort);
     }
     else if(search_result.has_unsynced_lyrics)
     {
-        return get_unsynced_lyrics(data, search_result.track_id, abort);
+        success = get_unsynced_lyrics(data, search_result.track_id, token, abort);
     }
-    else
+
+    if(success)
     {
-        return false;
+        LOG_INFO("Retrieved Musixmatch lyrics in %d round-trips", search_result.request_count + 1);
     }
+    return success;
 }
 
 std::string musixmatch_get_token(abort_callback& abort)
@@ -348,12 +575,7 @@ std::string musixmatch_get_token(abort_callback& abort)
     pfc::string8 content;
     try
     {
-        http_request::ptr request = http_client::get()->create_request("GET");
-        request->add_header("cookie", "AWSELBCORS=0; AWSELB=0"); // NOTE: See the comment on the cookie in the track ID query
-
-        file_ptr response_file = request->run(url.c_str(), abort);
-
-        response_file->read_string_raw(content, abort);
+        content = make_request(url, abort);
     }
     catch(const std::exception& e)
     {
@@ -361,39 +583,20 @@ std::string musixmatch_get_token(abort_callback& abort)
         return "";
     }
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
-    if((json == nullptr) || (json->type != cJSON_Object))
-    {
-        LOG_WARN("Received musixmatch token response but root was malformed: %s", content.c_str());
-        cJSON_Delete(json);
-        return "";
-    }
-
-    cJSON* json_message = cJSON_GetObjectItem(json, "message");
-    if((json_message == nullptr) || (json_message->type != cJSON_Object))
-    {
-        LOG_WARN("Received musixmatch token response but message was malformed: %s", content.c_str());
-        cJSON_Delete(json);
-        return "";
-    }
-
-    cJSON* json_body = cJSON_GetObjectItem(json_message, "body");
-    if((json_body == nullptr) || (json_body->type != cJSON_Object))
+    parsers::json::Reader reader(std::string_view(content.c_str(), content.get_length()));
+    int status_code = 0;
+    if(!enter_message_body(reader, status_code))
     {
-        LOG_WARN("Received musixmatch token response but body was malformed: %s", content.c_str());
-        cJSON_Delete(json);
+        LOG_WARN("Received musixmatch token response but message body was malformed: %s", content.c_str());
         return "";
     }
 
-    cJSON* json_token = cJSON_GetObjectItem(json_body, "user_token");
-    if((json_token == nullptr) || (json_token->type != cJSON_String))
+    std::string result;
+    if(!reader.find_key("user_token") || (reader.peek() != parsers::json::ValueType::String) || !reader.read_string(result))
     {
         LOG_WARN("Received musixmatch token response but user_token was malformed: %s", content.c_str());
-        cJSON_Delete(json);
         return "";
     }
 
-    std::string result = json_token->valuestring;
-    cJSON_Delete(json);
     return result;
 }
@@ -1,10 +1,9 @@
 #include "stdafx.h"
 
-#include "cJSON.h"
-
 #include "logging.h"
 #include "lyric_data.h"
 #include "lyric_source.h"
+#include "parsers.h"
 #include "tag_util.h"
 
 static const GUID src_guid = { 0xaac13215, 0xe32e, 0x4667, { 0xac, 0xd7, 0x1f, 0xd, 0xbd, 0x84, 0x27, 0xe4 } };
@@ -16,9 +15,10 @@ class NetEaseLyricsSource : public LyricSourceRemote
 
     std::vector<LyricDataRaw> search(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort) final;
     bool lookup(LyricDataRaw& data, abort_callback& abort) final;
+    size_t max_concurrent_lookups() const final { return 3; } // The first result is frequently a live or instrumental version with no lyrics
 
 private:
-    std::vector<LyricDataRaw> parse_song_ids(cJSON* json);
+    std::vector<LyricDataRaw> parse_song_ids(std::string_view json);
 };
 static const LyricSourceFactory<NetEaseLyricsSource> src_factory;
 
@@ -40,96 +40,138 @@ static http_request::ptr make_post_request()
     return request;
 }
 
-std::vector<LyricDataRaw> NetEaseLyricsSource::parse_song_ids(cJSON* json)
+static void read_string_or_skip(parsers::json::Reader& reader, std::string& out_value)
 {
-    if((json == nullptr) || (json->type != cJSON_Object))
+    if(reader.peek() == parsers::json::ValueType::String)
     {
-        LOG_INFO("Root object is null or not an object");
-        return {};
+        reader.read_string(out_value);
     }
+    else
+    {
+        reader.skip_value();
+    }
+}
 
-    cJSON* result_obj = cJSON_GetObjectItem(json, "result");
-    if((result_obj == nullptr) || (result_obj->type != cJSON_Object))
+static void read_first_artist_name(parsers::json::Reader& reader, std::string& out_artist)
+{
+    reader.enter_array();
+    if(!reader.next_element())
     {
-        LOG_INFO("No valid 'result' property available");
+        return; // The array was empty
+    }
+
+    if(reader.peek() == parsers::json::ValueType::Object)
+    {
+        reader.enter_object();
+        if(reader.find_key("name"))
+        {
+            read_string_or_skip(reader, out_artist);
+            reader.exit_object();
+        }
+    }
+    else
+    {
+        reader.skip_value();
+    }
+    reader.exit_array();
+}
+
+std::vector<LyricDataRaw> NetEaseLyricsSource::parse_song_ids(std::string_view json)
+{
+    // NOTE: We only need result.songs[].{id, name, artists[0].name, album.name}, so rather than parsing
+    //       the whole (often quite large) response we pick just those fields out as we read through it.
+    parsers::json::Reader reader(json);
+    if(!reader.enter_object())
+    {
+        LOG_INFO("Root object is null or not an object");
         return {};
     }
-    cJSON* song_arr = cJSON_GetObjectItem(result_obj, "songs");
-    if((song_arr == nullptr) || (song_arr->type != cJSON_Array))
+
+    if(!reader.find_key("result") || (reader.peek() != parsers::json::ValueType::Object))
     {
-        LOG_INFO("No valid 'songs' property available");
+        LOG_INFO("No valid 'result' property available");
         return {};
     }
+    reader.enter_object();
 
-    int song_arr_len = cJSON_GetArraySize(song_arr);
-    if(song_arr_len <= 0)
+    if(!reader.find_key("songs") || (reader.peek() != parsers::json::ValueType::Array))
     {
-        LOG_INFO("Songs array has no items available");
+        LOG_INFO("No valid 'songs' property available");
         return {};
     }
+    reader.enter_array();
 
     std::vector<LyricDataRaw> output;
-    for(int song_index=0; song_index<song_arr_len; song_index++)
+    int song_index = 0;
+    while(reader.next_element())
     {
-        cJSON* song_item = cJSON_GetArrayItem(song_arr, song_index);
-        if((song_item == nullptr) || (song_item->type != cJSON_Object))
+        if(reader.peek() != parsers::json::ValueType::Object)
         {
             LOG_INFO("Song array entry %d not available or invalid", song_index);
+            reader.skip_value();
+            song_index++;
             continue;
         }
+        reader.enter_object();
 
-        const char* result_artist = nullptr;
-        const char* result_album = nullptr;
-        const char* result_title = nullptr;
-
-        cJSON* artist_list_item = cJSON_GetObjectItem(song_item, "artists");
-        if((artist_list_item != nullptr) && (artist_list_item->type == cJSON_Array))
+        LyricDataRaw data = {};
+        data.source_id = src_guid;
+        std::optional<double> song_id;
+
+        bool seen_id = false;
+        bool seen_name = false;
+        bool seen_artists = false;
+        bool seen_album = false;
+        std::string_view key;
+        while(reader.next_key(key))
         {
-            int artist_list_len = cJSON_GetArraySize(artist_list_item);
-            if(artist_list_len > 0)
+            using parsers::json::is_first_occurrence;
+            const parsers::json::ValueType value_type = reader.peek();
+            if((key == "id") && is_first_occurrence(seen_id) && (value_type == parsers::json::ValueType::Number))
             {
-                cJSON* artist_item = cJSON_GetArrayItem(artist_list_item, 0);
-                if((artist_item != nullptr) && (artist_item->type == cJSON_Object))
+                double id_value = 0.0;
+                reader.read_number(id_value);
+                song_id = id_value;
+            }
+            else if((key == "name") && is_first_occurrence(seen_name) && (value_type == parsers::json::ValueType::String))
+            {
+                reader.read_string(data.title);
+            }
+            else if((key == "artists") && is_first_occurrence(seen_artists) && (value_type == parsers::json::ValueType::Array))
+            {
+                read_first_artist_name(reader, data.artist);
+            }
+            else if((key == "album") && is_first_occurrence(seen_album) && (value_type == parsers::json::ValueType::Object))
+            {
+                reader.enter_object();
+                if(reader.find_key("name"))
                 {
-                    cJSON* artist_name = cJSON_GetObjectItem(artist_item, "name");
-                    if((artist_name != nullptr) && (artist_name->type == cJSON_String))
-                    {
-                        result_artist = artist_name->valuestring;
-                    }
+                    read_string_or_skip(reader, data.album);
+                    reader.exit_object();
                 }
             }
-        }
-
-        cJSON* album_item = cJSON_GetObjectItem(song_item, "album");
-        if((album_item != nullptr) && (album_item->type == cJSON_Object))
-        {
-            cJSON* album_title_item = cJSON_GetObjectItem(album_item, "name");
-            if((album_title_item != nullptr) && (album_title_item->type == cJSON_String))
+            else
             {
-                result_album = album_title_item->valuestring;
+                reader.skip_value();
             }
         }
 
-        cJSON* title_item = cJSON_GetObjectItem(song_item, "name");
-        if((title_item != nullptr) && (title_item->type == cJSON_String))
+        if(reader.failed())
         {
-            result_title = title_item->valuestring;
+            LOG_INFO("Song array entry %d is malformed", song_index);
+            break;
         }
 
-        cJSON* song_id_item = cJSON_GetObjectItem(song_item, "id");
-        if((song_id_item == nullptr) || (song_id_item->type != cJSON_Number))
+        if(!song_id.has_value())
         {
             LOG_INFO("Song item ID field is not available or invalid");
+            song_index++;
             continue;
         }
 
-        LyricDataRaw data = {};
-        data.source_id = src_guid;
-        if(result_artist != nullptr) data.artist = result_artist;
-        if(result_album != nullptr) data.album = result_album;
-        if(result_title != nullptr) data.title = result_title;
-        data.lookup_id = std::to_string((int64_t)song_id_item->valuedouble);
+        data.lookup_id = std::to_string((int64_t)song_id.value());
         output.push_back(std::move(data));
+        song_index++;
     }
 
     return output;
@@ -154,11 +196,7 @@ std::vector<LyricDataRaw> NetEaseLyricsSource::search(std::string_view artist, s
         return {};
     }
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
-    std::vector<LyricDataRaw> song_ids = parse_song_ids(json);
-    cJSON_Delete(json);
-
-    return song_ids;
+    return parse_song_ids(std::string_view(content.c_str(), content.get_length()));
 }
 
 bool NetEaseLyricsSource::lookup(LyricDataRaw& data, abort_callback& abort)
@@ -188,22 +226,19 @@ bool NetEaseLyricsSource::lookup(LyricDataRaw& data, abort_callback& abort)
     }
 
     bool success = false;
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
-    if((json != nullptr) && (json->type == cJSON_Object))
+    parsers::json::Reader reader(std::string_view(content.c_str(), content.get_length()));
+    if(reader.enter_object() && reader.find_key("lrc") && (reader.peek() == parsers::json::ValueType::Object))
     {
-        cJSON* lrc_item = cJSON_GetObjectItem(json, "lrc");
-        if((lrc_item != nullptr) && (lrc_item->type == cJSON_Object))
+        reader.enter_object();
+
+        std::string lyric_text;
+        if(reader.find_key("lyric") && (reader.peek() == parsers::json::ValueType::String) && reader.read_string(lyric_text))
         {
-            cJSON* lrc_lyric = cJSON_GetObjectItem(lrc_item, "lyric");
-            if((lrc_lyric != nullptr) && (lrc_lyric->type == cJSON_String))
-            {
-                const std::string_view trimmed_text = trim_surrounding_whitespace(lrc_lyric->valuestring);
-                data.text_bytes = string_to_raw_bytes(trimmed_text);
-                success = true;
-            }
+            const std::string_view trimmed_text = trim_surrounding_whitespace(lyric_text);
+            data.text_bytes = string_to_raw_bytes(trimmed_text);
+            success = true;
         }
     }
-    cJSON_Delete(json);
 
     return success;
 }
@@ -1,10 +1,9 @@
 #include "stdafx.h"
 
-#include "cJSON.h"
-
 #include "logging.h"
 #include "lyric_data.h"
 #include "lyric_source.h"
+#include "parsers.h"
 
 static const GUID src_guid = { 0x4b0b5722, 0x3a84, 0x4b8e, { 0x82, 0x7a, 0x26, 0xb9, 0xea, 0xb3, 0xb4, 0xe8 } };
 
@@ -15,9 +14,10 @@ class QQMusicLyricsSource : public LyricSourceRemote
 
     std::vector<LyricDataRaw> search(std::string_view artist, std::string_view album, std::string_view title, abort_callback& abort) final;
     bool lookup(LyricDataRaw& data, abort_callback& abort) final;
+    size_t max_concurrent_lookups() const final { return 3; }
 
 private:
-    std::vector<LyricDataRaw> parse_song_ids(cJSON* json) const;
+    std::vector<LyricDataRaw> parse_song_ids(std::string_view json) const;
 };
 static const LyricSourceFactory<QQMusicLyricsSource> src_factory;
 
@@ -28,79 +28,95 @@ static http_request::ptr make_get_request()
     return request;
 }
 
-std::vector<LyricDataRaw> QQMusicLyricsSource::parse_song_ids(cJSON* json) const
+std::vector<LyricDataRaw> QQMusicLyricsSource::parse_song_ids(std::string_view json) const
 {
-    if((json == nullptr) || (json->type != cJSON_Object))
+    // NOTE: We only need data.song.itemlist[].{mid, name, singer}, so rather than parsing the whole
+    //       response we pick just those fields out as we read through it.
+    parsers::json::Reader reader(json);
+    if(!reader.enter_object())
     {
         LOG_INFO("Root object is null or not an object");
         return {};
     }
 
-    cJSON* result_obj = cJSON_GetObjectItem(json, "data");
-    if((result_obj == nullptr) || (result_obj->type != cJSON_Object))
+    if(!reader.find_key("data") || (reader.peek() != parsers::json::ValueType::Object))
     {
         LOG_INFO("No valid 'data' property available");
-        return {}; 
-    }
-    cJSON* song_obj = cJSON_GetObjectItem(result_obj, "song");
-    if((song_obj == nullptr) || (song_obj->type != cJSON_Object))
-    {
-        LOG_INFO("No valid 'song' property available");
         return {};
     }
+    reader.enter_object();
 
-    cJSON* song_arr = cJSON_GetObjectItem(song_obj, "itemlist");
-    if((song_arr == nullptr) || (song_arr->type != cJSON_Array))
+    if(!reader.find_key("song") || (reader.peek() != parsers::json::ValueType::Object))
     {
-        LOG_INFO("No valid 'list' property available");
+        LOG_INFO("No valid 'song' property available");
         return {};
     }
+    reader.enter_object();
 
-    int song_arr_len = cJSON_GetArraySize(song_arr);
-    if(song_arr_len <= 0)
+    if(!reader.find_key("itemlist") || (reader.peek() != parsers::json::ValueType::Array))
     {
-        LOG_INFO("Songs array has no items available");
+        LOG_INFO("No valid 'list' property available");
         return {};
     }
+    reader.enter_array();
 
     std::vector<LyricDataRaw> output;
-    for(int song_index=0; song_index<song_arr_len; song_index++)
+    int song_index = 0;
+    while(reader.next_element())
     {
-        cJSON* song_item = cJSON_GetArrayItem(song_arr, song_index);
-        if((song_item == nullptr) || (song_item->type != cJSON_Object))
+        if(reader.peek() != parsers::json::ValueType::Object)
         {
             LOG_INFO("Song array entry %d not available or invalid", song_index);
+            reader.skip_value();
+            song_index++;
             continue;
         }
+        reader.enter_object();
 
-        const char* result_artist = nullptr;
-        const char* result_title = nullptr;
+        LyricDataRaw data = {};
+        data.source_id = src_guid;
 
-        cJSON* artist_item = cJSON_GetObjectItem(song_item, "singer");
-        if((artist_item != nullptr) && (artist_item->type == cJSON_String))
+        bool seen_singer = false;
+        bool seen_name = false;
+        bool seen_mid = false;
+        std::string_view key;
+        while(reader.next_key(key))
         {
-            result_artist = artist_item->valuestring;
+            using parsers::json::is_first_occurrence;
+            const bool is_string = (reader.peek() == parsers::json::ValueType::String);
+            if((key == "singer") && is_first_occurrence(seen_singer) && is_string)
+            {
+                reader.read_string(data.artist);
+            }
+            else if((key == "name") && is_first_occurrence(seen_name) && is_string)
+            {
+                reader.read_string(data.title);
+            }
+            else if((key == "mid") && is_first_occurrence(seen_mid) && is_string)
+            {
+                reader.read_string(data.lookup_id);
+            }
+            else
+            {
+                reader.skip_value();
+            }
         }
 
-        cJSON* title_item = cJSON_GetObjectItem(song_item, "name");
-        if((title_item != nullptr) && (title_item->type == cJSON_String))
+        if(reader.failed())
         {
-            result_title = title_item->valuestring;
+            LOG_INFO("Song array entry %d is malformed", song_index);
+            break;
         }
 
-        cJSON* song_id_item = cJSON_GetObjectItem(song_item, "mid");
-        if((song_id_item == nullptr) || (song_id_item->type != cJSON_String))
+        if(data.lookup_id.empty())
         {
             LOG_INFO("Song item ID field is not available or invalid");
+            song_index++;
             continue;
         }
 
-        LyricDataRaw data = {};
-        data.source_id = src_guid;
-        if(result_artist != nullptr) data.artist = result_artist;
-        if(result_title != nullptr) data.title = result_title;
-        data.lookup_id = song_id_item->valuestring;
         output.push_back(std::move(data));
+        song_index++;
     }
 
     return output;
@@ -125,11 +141,7 @@ std::vector<LyricDataRaw> QQMusicLyricsSource::search(std::string_view artist, s
         return {};
     }
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
-    std::vector<LyricDataRaw> song_ids = parse_song_ids(json);
-    cJSON_Delete(json);
-
-    return song_ids;
+    return parse_song_ids(std::string_view(content.c_str(), content.get_length()));
 }
 
 bool QQMusicLyricsSource::lookup(LyricDataRaw& data, abort_callback& abort)
@@ -159,20 +171,16 @@ bool QQMusicLyricsSource::lookup(LyricDataRaw& data, abort_callback& abort)
     }
 
     bool success = false;
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
-    if((json != nullptr) && (json->type == cJSON_Object))
+    parsers::json::Reader reader(std::string_view(content.c_str(), content.get_length()));
+    std::string lyric_base64;
+    if(reader.enter_object() && reader.find_key("lyric") && (reader.peek() == parsers::json::ValueType::String) && reader.read_string(lyric_base64))
     {
-        cJSON* lyric_item = cJSON_GetObjectItem(json, "lyric");
-        if((lyric_item != nullptr) && (lyric_item->type == cJSON_String))
-        {
-            pfc::string8 lyric_str;
-            pfc::base64_decode_to_string(lyric_str, lyric_item->valuestring);
+        pfc::string8 lyric_str;
+        pfc::base64_decode_to_string(lyric_str, lyric_base64.c_str());
 
-            data.text_bytes = string_to_raw_bytes(std::string_view(lyric_str.c_str(), lyric_str.length()));
-            success = true;
-        }
+        data.text_bytes = string_to_raw_bytes(std::string_view(lyric_str.c_str(), lyric_str.length()));
+        success = true;
     }
-    cJSON_Delete(json);
 
     return success;
 }
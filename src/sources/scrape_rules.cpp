@@ -0,0 +1,526 @@
+#include "stdafx.h"
+
+#include "logging.h"
+#include "parsers.h"
+#include "scrape_rules.h"
+#include "tag_util.h"
+
+using namespace parsers::html;
+
+static bool is_selector_name_char(char c)
+{
+    return pfc::char_is_ascii_alphanumeric(c) || (c == '-') || (c == '_');
+}
+
+static std::string_view strip_quotes(std::string_view value)
+{
+    if((value.length() >= 2) && ((value.front() == '"') || (value.front() == '\'')) && (value.back() == value.front()))
+    {
+        return value.substr(1, value.length() - 2);
+    }
+    return value;
+}
+
+scrape::Selector::Selector(std::string_view selector)
+{
+    const std::string selector_str(selector); // For logging
+    selector = trim_surrounding_whitespace(selector);
+
+    size_t index = 0;
+    while((index < selector.length()) && is_selector_name_char(selector[index]))
+    {
+        index++;
+    }
+    m_tag = selector.substr(0, index);
+
+    while(index < selector.length())
+    {
+        const std::string_view remaining = selector.substr(index);
+        if(remaining[0] == '.')
+        {
+            size_t class_len = 1;
+            while((class_len < remaining.length()) && is_selector_name_char(remaining[class_len]))
+            {
+                class_len++;
+            }
+            m_attribute_tests.push_back({"class", AttributeOp::HasClass, std::string(remaining.substr(1, class_len - 1))});
+            index += class_len;
+        }
+        else if((remaining[0] == '[') && (remaining.find(']') != std::string_view::npos))
+        {
+            const size_t close_index = remaining.find(']');
+            const std::string_view test = remaining.substr(1, close_index - 1);
+            const size_t contains_index = test.find("*=");
+            const size_t equals_index = test.find('=');
+            if(contains_index != std::string_view::npos)
+            {
+                m_attribute_tests.push_back({std::string(test.substr(0, contains_index)), AttributeOp::Contains, std::string(strip_quotes(test.substr(contains_index + 2)))});
+            }
+            else if(equals_index != std::string_view::npos)
+            {
+                m_attribute_tests.push_back({std::string(test.substr(0, equals_index)), AttributeOp::Equals, std::string(strip_quotes(test.substr(equals_index + 1)))});
+            }
+            else
+            {
+                m_attribute_tests.push_back({std::string(test), AttributeOp::Present, {}});
+            }
+            index += close_index + 1;
+        }
+        else if((remaining.substr(0, 6) == ":not([") && (remaining.find("])") != std::string_view::npos))
+        {
+            const size_t close_index = remaining.find("])");
+            m_attribute_tests.push_back({std::string(remaining.substr(6, close_index - 6)), AttributeOp::Absent, {}});
+            index += close_index + 2;
+        }
+        else
+        {
+            LOG_ERROR("Unrecognised syntax at index %d of scraping selector '%s'", int(index), selector_str.c_str());
+            assert(false);
+
+            // Make sure that a selector we could not understand cannot match anything
+            m_attribute_tests.push_back({"class", AttributeOp::Present, {}});
+            m_attribute_tests.push_back({"class", AttributeOp::Absent, {}});
+            break;
+        }
+    }
+}
+
+bool scrape::Selector::matches_tag(const Token& token) const
+{
+    return tag_is(token, m_tag);
+}
+
+bool scrape::Selector::matches(const Token& token) const
+{
+    if((token.type != TokenType::StartTag) || !matches_tag(token))
+    {
+        return false;
+    }
+
+    for(const AttributeTest& test : m_attribute_tests)
+    {
+        const std::optional<std::string_view> value = get_attribute(token.attributes, test.name);
+        switch(test.op)
+        {
+            case AttributeOp::Present:
+                if(!value.has_value()) return false;
+                break;
+
+            case AttributeOp::Absent:
+                if(value.has_value()) return false;
+                break;
+
+            case AttributeOp::Equals:
+                if(!value.has_value() || (value.value() != test.value)) return false;
+                break;
+
+            case AttributeOp::Contains:
+                if(!value.has_value() || (value.value().find(test.value) == std::string_view::npos)) return false;
+                break;
+
+            case AttributeOp::HasClass:
+            {
+                if(!value.has_value()) return false;
+
+                bool found = false;
+                std::string_view classes = value.value();
+                while(!classes.empty() && !found)
+                {
+                    const size_t space_index = std::min(classes.find(' '), classes.length());
+                    found = (classes.substr(0, space_index) == test.value);
+                    classes.remove_prefix(std::min(space_index + 1, classes.length()));
+                }
+                if(!found) return false;
+            } break;
+        }
+    }
+
+    return true;
+}
+
+scrape::CompiledRuleSet::CompiledRuleSet(const RuleSet& rules)
+    : m_rules(rules)
+{
+    std::string_view containers = rules.container;
+    while(!containers.empty())
+    {
+        const size_t comma_index = std::min(containers.find(','), containers.length());
+        m_containers.emplace_back(containers.substr(0, comma_index));
+        containers.remove_prefix(std::min(comma_index + 1, containers.length()));
+    }
+
+    if(!rules.container_follows.empty())
+    {
+        m_container_follows.emplace(rules.container_follows);
+    }
+    if(!rules.track_header.empty())
+    {
+        m_track_header.emplace(rules.track_header);
+        m_track_title.emplace(rules.track_title);
+    }
+}
+
+std::string scrape::CompiledRuleSet::format_url(std::string_view artist, std::string_view album, std::string_view title) const
+{
+    const std::pair<std::string_view, std::string_view> placeholders[] =
+    {
+        {"{artist}", artist},
+        {"{album}", album},
+        {"{title}", title},
+    };
+
+    std::string url;
+    std::string_view url_template = m_rules.url_template;
+    while(!url_template.empty())
+    {
+        const size_t open_index = url_template.find('{');
+        url += url_template.substr(0, open_index);
+        if(open_index == std::string_view::npos)
+        {
+            break;
+        }
+        url_template.remove_prefix(open_index);
+
+        bool replaced = false;
+        for(const auto& [placeholder, value] : placeholders)
+        {
+            if(url_template.substr(0, placeholder.length()) == placeholder)
+            {
+                url += m_rules.url_component(value);
+                url_template.remove_prefix(placeholder.length());
+                replaced = true;
+                break;
+            }
+        }
+
+        if(!replaced)
+        {
+            url += '{';
+            url_template.remove_prefix(1);
+        }
+    }
+    return url;
+}
+
+std::vector<scrape::ExtractedTrack> scrape::CompiledRuleSet::extract_tracks(std::string_view page) const
+{
+    for(const Selector& container : m_containers)
+    {
+        std::vector<ExtractedTrack> tracks = extract_with_container(page, container);
+        const auto track_has_text = [](const ExtractedTrack& track) { return !track.text.empty(); };
+        if(std::any_of(tracks.begin(), tracks.end(), track_has_text))
+        {
+            return tracks;
+        }
+    }
+    return {};
+}
+
+std::string scrape::CompiledRuleSet::extract(std::string_view page, std::string_view title) const
+{
+    std::vector<ExtractedTrack> tracks = extract_tracks(page);
+    if(!m_track_header.has_value())
+    {
+        return tracks.empty() ? std::string() : std::move(tracks[0].text);
+    }
+
+    for(ExtractedTrack& track : tracks)
+    {
+        if(tag_values_match(track.title, title))
+        {
+            return std::move(track.text);
+        }
+    }
+    return {};
+}
+
+void scrape::CompiledRuleSet::append_text(std::string& output, std::string_view text) const
+{
+    // We assume the text is already UTF-8
+    if(m_rules.text_trim == TextTrim::Whitespace)
+    {
+        append_decoded_text(output, trim_surrounding_whitespace(text));
+    }
+    else
+    {
+        // Trim surrounding line-endings to get rid of the newlines in the HTML that don't affect rendering.
+        // Newlines in the middle of the text don't affect rendering either and should just be a space.
+        const size_t text_start = output.length();
+        append_decoded_text(output, trim_surrounding_line_endings(text));
+        output.erase(std::remove(output.begin() + text_start, output.end(), '\r'), output.end());
+        std::replace(output.begin() + text_start, output.end(), '\n', ' ');
+    }
+}
+
+// Returns the number of elements (counting from the top of the stack of open elements) that are implicitly closed
+// when the given start tag opens. This only handles the elements with optional end tags that are common on lyric
+// pages, i.e: a <p> is closed by the next <p> (or other block element) and an <li> is closed by the next <li> in the same list.
+static size_t count_implicitly_closed(const std::vector<Token>& open_elements, const Token& start_tag)
+{
+    const std::string_view paragraph_closers[] = { "address", "article", "aside", "blockquote", "div", "dl", "fieldset", "footer", "form", "h1", "h2", "h3", "h4", "h5", "h6", "header", "main", "nav", "ol", "p", "pre", "section", "table", "ul" };
+    const auto closes_paragraph = [&start_tag](std::string_view closer) { return tag_is(start_tag, closer); };
+    const bool opens_block = std::any_of(std::begin(paragraph_closers), std::end(paragraph_closers), closes_paragraph);
+    const bool opens_list_item = tag_is(start_tag, "li");
+    if(!opens_block && !opens_list_item)
+    {
+        return 0;
+    }
+
+    for(size_t i=open_elements.size(); i>0; i--)
+    {
+        const Token& element = open_elements[i-1];
+        if(opens_block && tag_is(element, "p"))
+        {
+            return open_elements.size() - (i-1);
+        }
+        if(opens_list_item)
+        {
+            if(tag_is(element, "li"))
+            {
+                return open_elements.size() - (i-1);
+            }
+            if(tag_is(element, "ul") || tag_is(element, "ol"))
+            {
+                return 0; // The new list item is in a nested list
+            }
+        }
+    }
+    return 0;
+}
+
+std::vector<scrape::ExtractedTrack> scrape::CompiledRuleSet::extract_with_container(std::string_view page, const Selector& container) const
+{
+    enum class State
+    {
+        FindContainer,
+        FindFollowingSibling,
+        SkipElement,
+        InContainer,
+        Done,
+    };
+    State state = State::FindContainer;
+    State state_after_skip = State::FindContainer;
+    std::vector<Token> skip_open_elements; // The skipped element, followed by all of the elements currently open inside it
+
+    int container_depth = 0; // Nesting of elements with the same tag as the container, so that we can find where it ends
+    int child_depth = 0; // Nesting of all elements inside the container, so that we know which text is a direct child
+    bool in_track_header = false;
+    bool in_track_title = false;
+    bool collecting = !m_track_header.has_value(); // Without track headers, all the text in the container is collected
+    std::string track_title;
+
+    std::vector<ExtractedTrack> tracks;
+    if(!m_track_header.has_value())
+    {
+        tracks.emplace_back();
+    }
+
+    Tokenizer tokenizer(page);
+    Token token = tokenizer.next();
+    while((state != State::Done) && (token.type != TokenType::EndOfInput))
+    {
+        const bool is_open = (token.type == TokenType::StartTag) && !token.self_closing;
+        bool token_consumed = true;
+        switch(state)
+        {
+            case State::FindContainer:
+            {
+                if(!is_open)
+                {
+                    break;
+                }
+
+                if(m_container_follows.has_value())
+                {
+                    if(m_container_follows->matches(token))
+                    {
+                        state = State::SkipElement;
+                        state_after_skip = State::FindFollowingSibling;
+                        skip_open_elements.assign(1, token);
+                    }
+                }
+                else if(container.matches(token))
+                {
+                    state = State::InContainer;
+                    container_depth = 1;
+                    child_depth = 0;
+                }
+            } break;
+
+            case State::FindFollowingSibling:
+            {
+                if(is_open)
+                {
+                    if(container.matches(token))
+                    {
+                        state = State::InContainer;
+                        container_depth = 1;
+                        child_depth = 0;
+                    }
+                    else
+                    {
+                        state = State::SkipElement;
+                        state_after_skip = State::FindFollowingSibling;
+                        skip_open_elements.assign(1, token);
+                    }
+                }
+                else if(token.type == TokenType::EndTag)
+                {
+                    state = State::Done; // The parent element ended without containing the container
+                }
+            } break;
+
+            case State::SkipElement:
+            {
+                // Not every element is closed explicitly (e.g "<p>One<p>Two</div>"), so the skipped element also ends
+                // when a sibling opens that implicitly closes it, or when the end tag of its parent is reached.
+                // In both of those cases the token belongs to whatever comes after the skipped element.
+                if(is_open)
+                {
+                    const size_t closed_count = count_implicitly_closed(skip_open_elements, token);
+                    skip_open_elements.resize(skip_open_elements.size() - closed_count);
+                    if(skip_open_elements.empty())
+                    {
+                        token_consumed = false;
+                    }
+                    else
+                    {
+                        skip_open_elements.push_back(token);
+                    }
+                }
+                else if((token.type == TokenType::EndTag) && !tag_is(token, "br")) // Browsers treat "</br>" as "<br>"
+                {
+                    const auto element_is_closed = [&token](const Token& element) { return tag_is(element, token.text); };
+                    const auto closed_element = std::find_if(skip_open_elements.rbegin(), skip_open_elements.rend(), element_is_closed);
+                    if(closed_element == skip_open_elements.rend())
+                    {
+                        skip_open_elements.clear(); // There is no open element with this tag, so this must be the end of the parent
+                        token_consumed = false;
+                    }
+                    else
+                    {
+                        skip_open_elements.erase(std::prev(closed_element.base()), skip_open_elements.end());
+                    }
+                }
+
+                if(skip_open_elements.empty())
+                {
+                    state = state_after_skip;
+                }
+            } break;
+
+            case State::InContainer:
+            {
+                if(container.matches_tag(token) && (is_open || (token.type == TokenType::EndTag)))
+                {
+                    container_depth += is_open ? 1 : -1;
+                    if(container_depth == 0)
+                    {
+                        if(m_rules.newline_after_container && collecting)
+                        {
+                            tracks.back().text += "\r\n";
+                        }
+
+                        state = m_container_follows.has_value() ? State::Done : State::FindContainer;
+                        in_track_header = false;
+                        in_track_title = false;
+                        collecting = !m_track_header.has_value();
+                        break;
+                    }
+                }
+
+                if(m_track_header.has_value())
+                {
+                    if(m_track_header->matches(token))
+                    {
+                        in_track_header = true;
+                        collecting = false;
+                        track_title.clear();
+                        break;
+                    }
+                    else if(in_track_header)
+                    {
+                        if((token.type == TokenType::EndTag) && m_track_header->matches_tag(token))
+                        {
+                            // Tracks are titled like "3. Title", so we skip over everything up to the first '.' (if there is one)
+                            std::string_view title_view = track_title;
+                            const size_t title_dot_index = title_view.find('.');
+                            if(title_dot_index != std::string_view::npos)
+                            {
+                                title_view.remove_prefix(title_dot_index + 1); // +1 to include the '.' that we found
+                            }
+
+                            tracks.push_back({std::string(trim_surrounding_whitespace(title_view)), {}});
+                            in_track_header = false;
+                            in_track_title = false;
+                            collecting = true;
+                            child_depth = 0;
+                        }
+                        else if(m_track_title->matches(token))
+                        {
+                            in_track_title = track_title.empty(); // We only consider the first title element in the header
+                        }
+                        else if(in_track_title && (token.type == TokenType::Text))
+                        {
+                            append_decoded_text(track_title, token.text);
+                        }
+                        else if(in_track_title && (token.type == TokenType::EndTag) && m_track_title->matches_tag(token))
+                        {
+                            in_track_title = false;
+                        }
+                        break;
+                    }
+                    else if(collecting && is_open && container.matches_tag(token))
+                    {
+                        collecting = false; // Nested elements of the same type as the container mark the end of the track
+                    }
+                }
+
+                if(!collecting)
+                {
+                    break;
+                }
+
+                const bool in_scope = (m_rules.text_scope == TextScope::Descendants) || (child_depth == 0);
+                if(token.type == TokenType::Text)
+                {
+                    if(in_scope)
+                    {
+                        append_text(tracks.back().text, token.text);
+                    }
+                }
+                else if(tag_is(token, "br"))
+                {
+                    if(in_scope)
+                    {
+                        tracks.back().text += "\r\n";
+                    }
+                }
+                else if(is_open)
+                {
+                    child_depth++;
+                }
+                else if(token.type == TokenType::EndTag)
+                {
+                    child_depth = std::max(0, child_depth - 1);
+                }
+            } break;
+
+            case State::Done:
+                break;
+        }
+
+        if(token_consumed)
+        {
+            token = tokenizer.next();
+        }
+    }
+
+    return tracks;
+}
+
+std::vector<scrape::ExtractedTrack> scrape::extract_tracks(const RuleSet& rules, std::string_view page)
+{
+    const CompiledRuleSet compiled(rules);
+    return compiled.extract_tracks(page);
+}
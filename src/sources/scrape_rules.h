@@ -0,0 +1,114 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "parsers.h"
+
+namespace scrape
+{
+    enum class TextScope
+    {
+        Descendants,    // All text inside the container, including text inside nested elements
+        DirectChildren, // Only text that is a direct child of the container
+    };
+
+    enum class TextTrim
+    {
+        Whitespace,  // Trim surrounding whitespace (spaces and line-endings) from each piece of text
+        LineEndings, // Trim surrounding line-endings from each piece of text and replace line-endings inside the text with spaces
+    };
+
+    // A description of how to find lyrics on a particular website.
+    // Selectors are a small subset of CSS selectors: a tag name optionally followed by any number of
+    // ".class", "[attr]", "[attr=value]", "[attr*=value]" or ":not([attr])" filters, e.g: "div[class*=Lyrics__Container]".
+    struct RuleSet
+    {
+        // The URL of the page for a track. "{artist}", "{album}" and "{title}" are replaced with
+        // the corresponding track metadata, after being passed through url_component.
+        std::string_view url_template;
+        std::string (*url_component)(std::string_view);
+
+        // Comma-separated selectors for the element(s) that contain the lyrics, in order of preference.
+        // Text is taken from every element on the page matching the first selector that matches anything.
+        std::string_view container;
+
+        // If non-empty, the container is only the first element matching the container selector
+        // that is a (following) sibling of the first element matching this selector.
+        std::string_view container_follows;
+
+        // If non-empty, each container holds lyrics for several tracks, with each track starting with an
+        // element matching track_header. The title of the track is the text of the element inside the
+        // header that matches track_title, excluding any leading track number (e.g "3. Title").
+        std::string_view track_header;
+        std::string_view track_title;
+
+        TextScope text_scope;
+        TextTrim text_trim;
+        bool newline_after_container; // Whether to add a line-break after the text from each container
+    };
+
+    class Selector
+    {
+    public:
+        explicit Selector(std::string_view selector);
+        bool matches(const parsers::html::Token& token) const;
+        bool matches_tag(const parsers::html::Token& token) const;
+
+    private:
+        enum class AttributeOp
+        {
+            Present,
+            Absent,
+            Equals,
+            Contains,
+            HasClass,
+        };
+
+        struct AttributeTest
+        {
+            std::string name;
+            AttributeOp op;
+            std::string value;
+        };
+
+        std::string m_tag;
+        std::vector<AttributeTest> m_attribute_tests;
+    };
+
+    struct ExtractedTrack
+    {
+        std::string title;
+        std::string text;
+    };
+
+    // A RuleSet with all of its selectors parsed up-front, so that extraction does nothing but match tokens
+    class CompiledRuleSet
+    {
+    public:
+        explicit CompiledRuleSet(const RuleSet& rules);
+
+        std::string format_url(std::string_view artist, std::string_view album, std::string_view title) const;
+
+        // Returns the lyric text found on the given page, or an empty string if no lyrics were found.
+        // For rules with a track_header, title selects which of the tracks on the page to return.
+        std::string extract(std::string_view page, std::string_view title) const;
+
+        // Returns the lyric text for every track found on the given page.
+        // For rules without a track_header, this is a single entry with an empty title.
+        std::vector<ExtractedTrack> extract_tracks(std::string_view page) const;
+
+    private:
+        std::vector<ExtractedTrack> extract_with_container(std::string_view page, const Selector& container) const;
+        void append_text(std::string& output, std::string_view text) const;
+
+        RuleSet m_rules;
+        std::vector<Selector> m_containers;
+        std::optional<Selector> m_container_follows;
+        std::optional<Selector> m_track_header;
+        std::optional<Selector> m_track_title;
+    };
+
+    // Compiles the given rules and returns the lyric text for every track found on the given page with them.
+    // Sources should keep a CompiledRuleSet around instead, this exists so that rules can be tested in isolation.
+    OPENLYRICS_TESTABLE_FUNC std::vector<ExtractedTrack> extract_tracks(const RuleSet& rules, std::string_view page);
+}
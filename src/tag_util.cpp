@@ -1,5 +1,7 @@
 #include "stdafx.h"
-#include <cctype>
+
+#include <mutex>
+#include <unordered_map>
 
 #include "logging.h"
 #include "preferences.h"
@@ -87,63 +89,163 @@ metadb_v2_rec_t get_full_metadata(metadb_handle_ptr track)
 #endif
 }
 
-static int compute_edit_distance(const std::string_view strA, const std::string_view strB)
+static unsigned char fold_case(char c)
 {
-    // 2-row levenshtein distance
-    int row_count = static_cast<int>(strA.length());
-    int row_len = static_cast<int>(strB.length());
+    // NOTE: This matches std::tolower in the "C" locale (which is what we used previously), but without
+    //       the locale lookup. Non-ASCII bytes (e.g parts of UTF-8 sequences) are compared exactly.
+    const unsigned char uc = static_cast<unsigned char>(c);
+    if((uc >= 'A') && (uc <= 'Z'))
+    {
+        return uc - 'A' + 'a';
+    }
+    return uc;
+}
 
-    int* prev_row = new int[row_len+1];
-    int* cur_row = new int[row_len+1];
-    for(int i=0; i<row_len+1; i++)
+// Myers' bit-parallel edit distance (in the formulation given by Hyyro), for patterns of at most 64 bytes
+static int bounded_edit_distance_bitparallel(std::string_view pattern, std::string_view text, int max_distance)
+{
+    assert(pattern.length() <= 64);
+    if(pattern.empty())
     {
-        prev_row[i] = i;
+        return std::min(static_cast<int>(text.length()), max_distance + 1);
     }
 
-    for(int row=0; row<row_count; row++)
+    uint64_t pattern_char_masks[256] = {};
+    for(size_t i=0; i<pattern.length(); i++)
     {
-        cur_row[0] = row + 1;
-        for(int i=0; i<row_len; i++)
+        pattern_char_masks[fold_case(pattern[i])] |= (uint64_t(1) << i);
+    }
+
+    const uint64_t last_bit = uint64_t(1) << (pattern.length() - 1);
+    uint64_t positive_vertical = ~uint64_t(0);
+    uint64_t negative_vertical = 0;
+    int distance = static_cast<int>(pattern.length());
+    int remaining_text = static_cast<int>(text.length());
+    for(char c : text)
+    {
+        const uint64_t equal = pattern_char_masks[fold_case(c)];
+        const uint64_t x_vertical = equal | negative_vertical;
+        const uint64_t x_horizontal = (((equal & positive_vertical) + positive_vertical) ^ positive_vertical) | equal;
+        uint64_t positive_horizontal = negative_vertical | ~(x_horizontal | positive_vertical);
+        uint64_t negative_horizontal = positive_vertical & x_horizontal;
+
+        if(positive_horizontal & last_bit)
         {
-            int delete_cost = prev_row[i+1] + 1;
-            int insert_cost = cur_row[i] + 1;
-            int subst_cost;
+            distance++;
+        }
+        else if(negative_horizontal & last_bit)
+        {
+            distance--;
+        }
 
-            int a_lower = std::tolower(static_cast<unsigned char>(strA[row]));
-            int b_lower = std::tolower(static_cast<unsigned char>(strB[i]));
-            if(a_lower == b_lower)
+        // Each remaining text character can reduce the distance by at most 1
+        remaining_text--;
+        if(distance - remaining_text > max_distance)
+        {
+            return max_distance + 1;
+        }
+
+        // The first row of the distance matrix increases by 1 in every column, so shift in a positive delta
+        positive_horizontal = (positive_horizontal << 1) | 1;
+        negative_horizontal = negative_horizontal << 1;
+        positive_vertical = negative_horizontal | ~(x_vertical | positive_horizontal);
+        negative_vertical = positive_horizontal & x_vertical;
+    }
+
+    return std::min(distance, max_distance + 1);
+}
+
+// Ukkonen's banded edit distance, which only computes the cells that are within max_distance of the diagonal
+static int bounded_edit_distance_banded(std::string_view strA, std::string_view strB, int max_distance)
+{
+    const int MAX_BAND_DISTANCE = 16;
+    assert(max_distance <= MAX_BAND_DISTANCE);
+    max_distance = std::min(max_distance, MAX_BAND_DISTANCE);
+
+    // Row i of the distance matrix is stored such that band[d] is the cell at column j=(i + d - max_distance)
+    const int too_far = max_distance + 1;
+    const int band_width = 2*max_distance + 1;
+    int band_storage[2][2*MAX_BAND_DISTANCE + 1];
+    int* prev_row = band_storage[0];
+    int* cur_row = band_storage[1];
+
+    const int row_count = static_cast<int>(strA.length());
+    const int row_len = static_cast<int>(strB.length());
+    for(int d=0; d<band_width; d++)
+    {
+        const int col = d - max_distance;
+        prev_row[d] = ((col >= 0) && (col <= row_len)) ? col : too_far;
+    }
+
+    for(int row=1; row<=row_count; row++)
+    {
+        const unsigned char a_folded = fold_case(strA[row-1]);
+        int row_min = too_far;
+        for(int d=0; d<band_width; d++)
+        {
+            const int col = row + d - max_distance;
+            int cell = too_far;
+            if(col == 0)
             {
-                subst_cost = prev_row[i];
+                cell = row;
             }
-            else
+            else if((col > 0) && (col <= row_len))
             {
-                subst_cost = prev_row[i] + 1;
+                const int subst_cost = prev_row[d] + ((a_folded == fold_case(strB[col-1])) ? 0 : 1);
+                const int delete_cost = (d+1 < band_width) ? (prev_row[d+1] + 1) : too_far;
+                const int insert_cost = (d > 0) ? (cur_row[d-1] + 1) : too_far;
+                cell = std::min(std::min(delete_cost, insert_cost), subst_cost);
             }
 
-            cur_row[i+1] = min(min(delete_cost, insert_cost), subst_cost);
+            cur_row[d] = std::min(cell, too_far);
+            row_min = std::min(row_min, cur_row[d]);
         }
 
-        int* tmp = cur_row;
-        cur_row = prev_row;
-        prev_row = tmp;
+        if(row_min > max_distance)
+        {
+            return too_far; // Every path through the rest of the matrix already costs too much
+        }
+        std::swap(prev_row, cur_row);
     }
 
-    int result = prev_row[row_len];
-    delete[] prev_row;
-    delete[] cur_row;
-    return result;
+    return prev_row[row_len - row_count + max_distance];
 }
 
-bool tag_values_match(std::string_view tagA, std::string_view tagB)
+int bounded_edit_distance(std::string_view strA, std::string_view strB, int max_distance)
+{
+    const int length_difference = std::abs(static_cast<int>(strA.length()) - static_cast<int>(strB.length()));
+    if(length_difference > max_distance)
+    {
+        return max_distance + 1;
+    }
+
+    std::string_view shorter = (strA.length() <= strB.length()) ? strA : strB;
+    std::string_view longer = (strA.length() <= strB.length()) ? strB : strA;
+    if(shorter.length() <= 64)
+    {
+        return bounded_edit_distance_bitparallel(shorter, longer, max_distance);
+    }
+    return bounded_edit_distance_banded(strA, strB, max_distance);
+}
+
+static std::string_view search_tag_value(std::string_view tag)
 {
     if(preferences::searching::exclude_trailing_brackets())
     {
-        tagA = trim_surrounding_whitespace(trim_trailing_text_in_brackets(tagA));
-        tagB = trim_surrounding_whitespace(trim_trailing_text_in_brackets(tagB));
+        return trim_surrounding_whitespace(trim_trailing_text_in_brackets(tag));
     }
+    return tag;
+}
 
+static bool search_tag_values_match(std::string_view searchA, std::string_view searchB)
+{
     const int MAX_TAG_EDIT_DISTANCE = 3; // Arbitrarily selected
-    return (compute_edit_distance(tagA, tagB) <= MAX_TAG_EDIT_DISTANCE);
+    return (bounded_edit_distance(searchA, searchB, MAX_TAG_EDIT_DISTANCE) <= MAX_TAG_EDIT_DISTANCE);
+}
+
+bool tag_values_match(std::string_view tagA, std::string_view tagB)
+{
+    return search_tag_values_match(search_tag_value(tagA), search_tag_value(tagB));
 }
 
 std::string track_metadata(const metadb_v2_rec_t& track, std::string_view key)
@@ -228,3 +330,75 @@ bool track_is_remote(metadb_handle_ptr track)
     return is_remote;
 #endif
 }
+
+titleformat_object::ptr compile_titleformat_cached(const char* script)
+{
+    // NOTE: The set of scripts that we format with is tiny (only those in the preferences), but editing the preferences
+    //       could introduce many intermediate versions so we just start again if the cache ever gets big.
+    const size_t MAX_CACHED_SCRIPTS = 32;
+    static std::mutex cache_mutex;
+    static std::unordered_map<std::string, titleformat_object::ptr> cache;
+
+    std::lock_guard lock(cache_mutex);
+    const auto iter = cache.find(script);
+    if(iter != cache.end())
+    {
+        return iter->second;
+    }
+
+    titleformat_object::ptr compiled;
+    const bool compile_success = titleformat_compiler::get()->compile(compiled, script);
+    if(!compile_success)
+    {
+        compiled.release();
+    }
+
+    if(cache.size() >= MAX_CACHED_SCRIPTS)
+    {
+        cache.clear();
+    }
+    cache.emplace(script, compiled);
+    return compiled;
+}
+
+TrackKey::TrackKey()
+    : hash(0)
+{
+}
+
+TrackKey::TrackKey(const file_info& info)
+    : artist(track_metadata(info, "artist"))
+    , album(track_metadata(info, "album"))
+    , title(track_metadata(info, "title"))
+    , search_artist(search_tag_value(artist))
+    , search_album(search_tag_value(album))
+    , search_title(search_tag_value(title))
+    , hash(compute_hash(artist, album, title))
+{
+}
+
+TrackKey::TrackKey(const metadb_v2_rec_t& track_info)
+    : TrackKey((track_info.info != nullptr) ? TrackKey(track_info.info->info()) : TrackKey())
+{
+}
+
+bool TrackKey::matches(std::string_view result_artist, std::string_view result_album, std::string_view result_title) const
+{
+    // NOTE: Some sources don't return an album so we ignore album data if the source didn't give us any.
+    //       Similarly, the local tag data might not contain an album, in which case we shouldn't reject
+    //       candidates because they have non-empty album data.
+    return (result_album.empty() || album.empty() || search_tag_values_match(search_album, search_tag_value(result_album))) &&
+           search_tag_values_match(search_artist, search_tag_value(result_artist)) &&
+           search_tag_values_match(search_title, search_tag_value(result_title));
+}
+
+metadb_index_hash TrackKey::compute_hash(std::string_view artist, std::string_view album, std::string_view title)
+{
+    // NOTE: This must remain the same forever, because it is used to look up data that is persisted by the search-avoidance index
+    std::string key;
+    key.reserve(artist.length() + album.length() + title.length());
+    key += artist;
+    key += album;
+    key += title;
+    return static_api_ptr_t<hasher_md5>()->process_single_string(key.c_str()).xorHalve();
+}
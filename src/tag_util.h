@@ -12,5 +12,40 @@ std::string track_metadata(const metadb_v2_rec_t& track, std::string_view key);
 std::string track_metadata(const file_info& track_info, std::string_view key);
 bool tag_values_match(std::string_view tagA, std::string_view tagB);
 
+// Returns the case-insensitive edit distance between the two strings if it is at most max_distance, or max_distance+1 otherwise
+OPENLYRICS_TESTABLE_FUNC int bounded_edit_distance(std::string_view strA, std::string_view strB, int max_distance);
+
 bool track_is_remote(metadb_handle_ptr track);
 
+// Returns the compiled form of the given titleformat script, or null if it fails to compile.
+// Compiled scripts are cached (and shared between all callers) so that formatting the same configured script
+// for every track in a bulk search only compiles it once. Changing the configured script naturally misses the cache.
+titleformat_object::ptr compile_titleformat_cached(const char* script);
+
+// The identifying metadata of a track, looked up once (e.g when the playing track changes or a search starts)
+// so that searching, result matching and search avoidance don't each need to look it up and normalise it again.
+struct TrackKey
+{
+    // The tag values, exactly as they are in the track metadata
+    std::string artist;
+    std::string album;
+    std::string title;
+
+    // The values with which to search for lyrics and to match search results against.
+    // These are the tag values with any trailing text in brackets removed, if the preferences ask for that.
+    std::string search_artist;
+    std::string search_album;
+    std::string search_title;
+
+    metadb_index_hash hash; // Identifies the track in the search-avoidance index
+
+    TrackKey();
+    explicit TrackKey(const file_info& info);
+    explicit TrackKey(const metadb_v2_rec_t& track_info);
+
+    // Returns true if the given metadata (from a search result) matches that of this track
+    bool matches(std::string_view result_artist, std::string_view result_album, std::string_view result_title) const;
+
+    static metadb_index_hash compute_hash(std::string_view artist, std::string_view album, std::string_view title);
+};
+
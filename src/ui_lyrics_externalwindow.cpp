@@ -539,9 +539,9 @@ void ExternalLyricWindow::DrawNoLyrics(D2DTextRenderContext& render)
 
     const D2D1_SIZE_F canvas_size = render.device->GetSize();
 
-    std::string artist = track_metadata(m_now_playing_info, "artist");
-    std::string album = track_metadata(m_now_playing_info, "album");
-    std::string title = track_metadata(m_now_playing_info, "title");
+    const std::string& artist = m_now_playing_key.artist;
+    const std::string& album = m_now_playing_key.album;
+    const std::string& title = m_now_playing_key.title;
 
     int total_height = 0;
     std::tstring artist_line;
@@ -937,6 +937,9 @@ void ExternalLyricWindow::OnPaint(CDCHandle)
         return;
     }
 
+    // NOTE: Unlike the panel, we don't compute when our text will next change and just keep redrawing every frame during playback
+    ScheduleNextFrame({0.0, {}, 0.0});
+
     if(m_search_pending)
     {
         m_search_pending = false;
@@ -948,7 +951,7 @@ void ExternalLyricWindow::OnPaint(CDCHandle)
         {
             if(should_panel_search(this))
             {
-                const SearchAvoidanceReason avoid_reason = search_avoidance_allows_search(m_now_playing, m_now_playing_info);
+                const SearchAvoidanceReason avoid_reason = search_avoidance_allows_search(m_now_playing, m_now_playing_info, m_now_playing_key);
                 InitiateLyricSearch(avoid_reason);
             }
         }
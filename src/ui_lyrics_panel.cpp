@@ -64,6 +64,7 @@ void LyricPanel::on_album_art_retrieved(album_art_data::ptr art_data)
     }
     m_albumart_original = std::move(maybe_img.value());
     compute_background_image();
+    Invalidate(); // Draw again to show the new background
 }
 
 CRect LyricPanel::compute_background_image_rect()
@@ -205,6 +206,50 @@ void LyricPanel::compute_background_image()
     }
 
     toggle_image_rgba_bgra_inplace(m_background_img);
+    ReleaseBackgroundBitmap(); // The bitmap is re-created from the new image the next time that we paint
+    m_background_bitmap_failed = false;
+}
+
+void LyricPanel::CreateBackgroundBitmap()
+{
+    assert(m_background_img.valid());
+    BITMAPINFO bmp = {};
+    bmp.bmiHeader.biSize = sizeof(bmp.bmiHeader);
+    bmp.bmiHeader.biWidth = m_background_img.width;
+    bmp.bmiHeader.biHeight = -m_background_img.height; // Positive for origin in bottom-left, negative for origin in top-left
+    bmp.bmiHeader.biPlanes = 1;
+    bmp.bmiHeader.biBitCount = 32;
+    bmp.bmiHeader.biCompression = BI_RGB;
+
+    // NOTE: We use a bitmap that is compatible with the back buffer (rather than a DIB section) so that
+    //       GDI can keep it in whatever format is fastest to copy into the back buffer.
+    m_background_bitmap = CreateCompatibleBitmap(m_back_buffer, m_background_img.width, m_background_img.height);
+    if(m_background_bitmap == nullptr)
+    {
+        LOG_WARN("Failed to create background bitmap: %d", GetLastError());
+        m_background_bitmap_failed = true;
+        return;
+    }
+
+    const int scan_lines_copied = SetDIBits(m_back_buffer, m_background_bitmap, 0, UINT(m_background_img.height), m_background_img.pixels, &bmp, DIB_RGB_COLORS);
+    if(scan_lines_copied == 0)
+    {
+        LOG_WARN("Failed to upload background image");
+        ReleaseBackgroundBitmap();
+        m_background_bitmap_failed = true;
+        return;
+    }
+
+    m_background_dc = CreateCompatibleDC(m_back_buffer);
+    SelectObject(m_background_dc, m_background_bitmap);
+}
+
+void LyricPanel::ReleaseBackgroundBitmap()
+{
+    if(m_background_dc != nullptr) DeleteDC(m_background_dc);
+    if(m_background_bitmap != nullptr) DeleteObject(m_background_bitmap);
+    m_background_dc = nullptr;
+    m_background_bitmap = nullptr;
 }
 
 void LyricPanel::on_playback_new_track(metadb_handle_ptr track)
@@ -212,6 +257,7 @@ void LyricPanel::on_playback_new_track(metadb_handle_ptr track)
     const bool track_changed = (track != m_now_playing);
     m_now_playing = track;
     m_now_playing_info = get_full_metadata(track);
+    m_now_playing_key = TrackKey(m_now_playing_info);
     m_manual_scroll_distance = 0;
     m_search_pending = !track_is_remote(track); // If this is an internet radio then don't search until we get dynamic track info
     m_now_playing_time_offset = 0.0;
@@ -230,12 +276,17 @@ void LyricPanel::on_playback_new_track(metadb_handle_ptr track)
         if(track_changed)
         {
             m_background_img = {};
+            ReleaseBackgroundBitmap();
         }
     }
     else
     {
         compute_background_image();
     }
+
+    // NOTE: The timer may still be marked as running but have no frame scheduled (e.g if the previous track ended on its
+    //       last line, which never needs redrawing), in which case StartTimer won't draw anything for us.
+    Invalidate(); // Draw again so that we start the search for the new track
 }
 
 void LyricPanel::on_playback_dynamic_info_track(const file_info& info)
@@ -248,6 +299,7 @@ void LyricPanel::on_playback_dynamic_info_track(const file_info& info)
     meta_record.info = info_container_impl;
 
     m_now_playing_info = meta_record;
+    m_now_playing_key = TrackKey(info);
     m_manual_scroll_distance = 0;
     m_search_pending = true;
 
@@ -257,13 +309,16 @@ void LyricPanel::on_playback_dynamic_info_track(const file_info& info)
     // just started playback or when the track changes.
     service_ptr_t<playback_control> playback = playback_control::get();
     m_now_playing_time_offset = playback->playback_get_position();
+    Invalidate(); // Draw again so that we start the search for the new track
 }
 
 void LyricPanel::on_playback_stop(play_control::t_stop_reason /*reason*/)
 {
     m_now_playing = nullptr;
     m_now_playing_info = {};
+    m_now_playing_key = {};
     m_lyrics = {};
+    InvalidateLyricLayout();
     m_auto_search_avoided_reason = SearchAvoidanceReason::Allowed;
     StopTimer();
 
@@ -331,6 +386,8 @@ void LyricPanel::OnWindowDestroy()
 
     if(m_back_buffer_bitmap != nullptr) DeleteObject(m_back_buffer_bitmap);
     if(m_back_buffer != nullptr) DeleteDC(m_back_buffer);
+    ReleaseBackgroundBitmap();
+    m_frame_scheduled = false; // Timers are destroyed along with the window
 
     // Prevent us from getting album-art callbacks after destruction
     now_playing_album_art_notify_manager::ptr art_manager = now_playing_album_art_notify_manager::get();
@@ -385,7 +442,23 @@ UINT LyricPanel::OnNonClientHitTest(CPoint /*point*/)
 
 LRESULT LyricPanel::OnTimer(WPARAM /*wParam*/)
 {
-    Invalidate();
+    // NOTE: The timer only needs to fire once, because the next frame gets scheduled when we paint this one.
+    //       This also means that we stop waking up entirely while the panel is hidden (or foobar is minimised),
+    //       because hidden windows are not painted. We'll be painted again as soon as the panel is shown.
+    CancelScheduledFrame();
+
+    // NOTE: We check that the dirty rect is still all that needs redrawing in case the timer fired late
+    //       (e.g because the UI thread was busy) and the lyrics have since started to scroll.
+    const double frame_seconds = 0.05;
+    if(m_scheduled_dirty_rect.has_value() &&
+       (get_playback_time().current_time + frame_seconds < m_scheduled_dirty_rect_end_time))
+    {
+        InvalidateRect(&m_scheduled_dirty_rect.value());
+    }
+    else
+    {
+        Invalidate();
+    }
     return 0;
 }
 
@@ -399,19 +472,16 @@ BOOL LyricPanel::OnEraseBkgnd(CDCHandle /*dc*/)
     return TRUE;
 }
 
-static int _WrapSimpleLyricsLineToRect(HDC dc, CRect clip_rect, std::tstring_view line, const CPoint* origin)
+// Splits a single (simple) line of text into rows that each fit within the given width, appending them to the given list.
+// Returns false if the text could not be measured.
+static bool _WrapSimpleLyricsLine(HDC dc, const TEXTMETRIC& font_metrics, int visible_width, std::tstring_view line, size_t line_start_index, std::vector<WrappedLyricLayout::Row>& rows)
 {
-    TEXTMETRIC font_metrics = {};
-    WIN32_OP_D(GetTextMetrics(dc, &font_metrics))
-    const int line_height = font_metrics.tmHeight + preferences::display::linegap();
-
     if(line.length() == 0)
     {
-        return line_height;
+        rows.push_back({line_start_index, 0});
+        return true;
     }
 
-    int visible_width = clip_rect.Width();
-
     // This serves as an upper bound on the number of chars we draw on a single line.
     // Used to prevent GDI from having to compute the size of very long strings.
     int generous_max_chars = 256;
@@ -424,7 +494,6 @@ static int _WrapSimpleLyricsLineToRect(HDC dc, CRect clip_rect, std::tstring_vie
 
     assert(line.length() <= INT_MAX);
     std::tstring_view text_outstanding = line;
-    int total_height = 0;
     while(text_outstanding.length() > 0)
     {
         size_t leading_spaces = text_outstanding.find_first_not_of(_T(' '));
@@ -449,7 +518,7 @@ static int _WrapSimpleLyricsLineToRect(HDC dc, CRect clip_rect, std::tstring_vie
             if(!extent_success)
             {
                 LOG_WARN("Failed to compute lyric line extents");
-                return 0;
+                return false;
             }
 
             if((chars_to_draw == 0) || (line_size.cx <= visible_width))
@@ -474,66 +543,181 @@ static int _WrapSimpleLyricsLineToRect(HDC dc, CRect clip_rect, std::tstring_vie
             }
         }
 
-        bool draw_requested = (origin != nullptr);
-        if(draw_requested)
-        {
-            int draw_y = origin->y + total_height;
-            bool clipped = (draw_y + font_metrics.tmDescent < clip_rect.top) || (draw_y - font_metrics.tmAscent > clip_rect.bottom);
-            if(!clipped)
-            {
-                BOOL draw_success = TextOut(dc, origin->x, draw_y, text_outstanding.data(), chars_to_draw);
-                if(!draw_success)
-                {
-                    LOG_WARN("Failed to draw lyrics text: %d", GetLastError());
-                    return 0;
-                }
-            }
-        }
-
-        total_height += line_height;
+        const size_t row_start_index = line_start_index + size_t(text_outstanding.data() - line.data());
+        rows.push_back({row_start_index, chars_to_draw});
         text_outstanding = text_outstanding.substr(next_line_start_index);
     }
 
-    return total_height;
+    return true;
 }
 
 // Ordinarily a single "line" from the lyric data is just one row (pre-wrapping) of text.
 // However if multiple lines have the exact same timestamp, they get combined and are presented
 // here as a single "line" that contains newline chars.
 // We refer to these here as simple & compound lines.
-static int _WrapCompoundLyricsLineToRect(HDC dc, CRect clip_rect, std::tstring_view line, CPoint* origin)
+static bool _WrapCompoundLyricsLine(HDC dc, const TEXTMETRIC& font_metrics, int visible_width, std::tstring_view line, std::vector<WrappedLyricLayout::Row>& rows)
 {
     if(line.length() == 0)
     {
-        return _WrapSimpleLyricsLineToRect(dc, clip_rect, line, origin);
+        return _WrapSimpleLyricsLine(dc, font_metrics, visible_width, line, 0, rows);
     }
 
-    int result = 0;
     size_t start_index = 0;
     while(start_index < line.length())
     {
         size_t end_index = min(line.length(), line.find('\n', start_index));
         size_t length = end_index - start_index;
         std::tstring_view view(&line.data()[start_index], length);
-        int row_height = _WrapSimpleLyricsLineToRect(dc, clip_rect, view, origin);
-        if(origin != nullptr)
+        if(!_WrapSimpleLyricsLine(dc, font_metrics, visible_width, view, start_index, rows))
         {
-            origin->y += row_height;
+            return false;
         }
-        result += row_height;
         start_index = end_index+1;
     }
-    return result;
+    return true;
+}
+
+// Draws the given rows of a line, with the baseline of the first row at the given origin.
+// Returns false if any of the text could not be drawn.
+static bool DrawLyricRows(HDC dc, CRect clip_rect, const TEXTMETRIC& font_metrics, int row_height, std::tstring_view line, const WrappedLyricLayout::Row* rows, size_t row_count, CPoint origin)
+{
+    for(size_t i=0; i<row_count; i++)
+    {
+        const int draw_y = origin.y + int(i)*row_height;
+        const bool clipped = (draw_y + font_metrics.tmDescent < clip_rect.top) || (draw_y - font_metrics.tmAscent > clip_rect.bottom);
+        if(clipped)
+        {
+            continue;
+        }
+
+        const WrappedLyricLayout::Row& row = rows[i];
+        const std::tstring_view row_text = line.substr(min(row.text_start, line.length()), size_t(row.text_length));
+        BOOL draw_success = TextOut(dc, origin.x, draw_y, row_text.data(), int(row_text.length()));
+        if(!draw_success)
+        {
+            LOG_WARN("Failed to draw lyrics text: %d", GetLastError());
+            return false;
+        }
+    }
+    return true;
 }
 
 static int ComputeWrappedLyricLineHeight(HDC dc, CRect clip_rect, const std::tstring& line)
 {
-    return _WrapCompoundLyricsLineToRect(dc, clip_rect, line, nullptr);
+    TEXTMETRIC font_metrics = {};
+    WIN32_OP_D(GetTextMetrics(dc, &font_metrics))
+    const int row_height = font_metrics.tmHeight + preferences::display::linegap();
+
+    std::vector<WrappedLyricLayout::Row> rows;
+    if(!_WrapCompoundLyricsLine(dc, font_metrics, clip_rect.Width(), line, rows))
+    {
+        return 0;
+    }
+    return int(rows.size()) * row_height;
 }
 
 static int DrawWrappedLyricLine(HDC dc, CRect clip_rect, const std::tstring_view line, CPoint origin)
 {
-    return _WrapCompoundLyricsLineToRect(dc, clip_rect, line, &origin);
+    TEXTMETRIC font_metrics = {};
+    WIN32_OP_D(GetTextMetrics(dc, &font_metrics))
+    const int row_height = font_metrics.tmHeight + preferences::display::linegap();
+
+    std::vector<WrappedLyricLayout::Row> rows;
+    if(!_WrapCompoundLyricsLine(dc, font_metrics, clip_rect.Width(), line, rows) ||
+       !DrawLyricRows(dc, clip_rect, font_metrics, row_height, line, rows.data(), rows.size(), origin))
+    {
+        return 0;
+    }
+    return int(rows.size()) * row_height;
+}
+
+// Draws one line of the (already wrapped) lyrics, with the baseline of its first row at the given origin.
+// Returns false if any of the text could not be drawn.
+static bool DrawLyricLayoutLine(HDC dc, CRect clip_rect, const TEXTMETRIC& font_metrics, const WrappedLyricLayout& layout, size_t line_index, std::tstring_view line, CPoint origin)
+{
+    const size_t first_row = layout.line_first_row[line_index];
+    const size_t row_count = layout.line_first_row[line_index+1] - first_row;
+    return DrawLyricRows(dc, clip_rect, font_metrics, layout.row_height, line, layout.rows.data() + first_row, row_count, origin);
+}
+
+struct VisibleLineRange
+{
+    size_t begin;
+    size_t end;
+};
+
+// Returns the range of lines that have at least one row within the given clip rect, if the first row of the first line is drawn with its baseline at the given height.
+// Only these lines need to be drawn at all, so the cost of drawing depends on the size of the panel rather than the length of the lyrics.
+static VisibleLineRange get_visible_lines(const WrappedLyricLayout& layout, const TEXTMETRIC& font_metrics, CRect clip_rect, int first_baseline_y)
+{
+    // NOTE: A row is visible if its baseline is in [clip_rect.top - descent, clip_rect.bottom + ascent], see DrawLyricRows.
+    //       A line is visible if the baseline of its last row is below the former and the baseline of its first row is above the latter.
+    //       Each line_top value is both the top of one line and the bottom of the previous one.
+    const int min_line_bottom = clip_rect.top - font_metrics.tmDescent - first_baseline_y + layout.row_height;
+    const int max_line_top = clip_rect.bottom + font_metrics.tmAscent - first_baseline_y;
+
+    const auto bottoms_begin = layout.line_top.begin() + 1;
+    const auto tops_end = layout.line_top.end() - 1;
+    const size_t begin = size_t(std::lower_bound(bottoms_begin, layout.line_top.end(), min_line_bottom) - bottoms_begin);
+    const size_t end = size_t(std::upper_bound(layout.line_top.begin(), tops_end, max_line_top) - layout.line_top.begin());
+    return {begin, max(begin, end)};
+}
+
+static bool fonts_equal(const LOGFONT& lhs, const LOGFONT& rhs)
+{
+    // NOTE: We don't compare the whole struct because the face name is only meaningful up to its null-terminator
+    return (memcmp(&lhs, &rhs, offsetof(LOGFONT, lfFaceName)) == 0) &&
+           (_tcsncmp(lhs.lfFaceName, rhs.lfFaceName, LF_FACESIZE) == 0);
+}
+
+const WrappedLyricLayout& LyricPanel::GetLyricLayout(HDC dc, CRect client_area)
+{
+    LOGFONT font = {};
+    GetObject(GetCurrentObject(dc, OBJ_FONT), sizeof(font), &font);
+    const int linegap = preferences::display::linegap();
+    const int width = client_area.Width();
+
+    WrappedLyricLayout& layout = m_lyrics_layout;
+    if(layout.valid &&
+       (layout.line_first_row.size() == m_lyrics.lines.size() + 1) &&
+       fonts_equal(layout.font, font) &&
+       (layout.linegap == linegap) &&
+       (layout.width == width))
+    {
+        return layout;
+    }
+
+    TEXTMETRIC font_metrics = {};
+    WIN32_OP_D(GetTextMetrics(dc, &font_metrics))
+
+    layout.rows.clear();
+    layout.line_first_row.clear();
+    layout.line_top.clear();
+    layout.line_first_row.reserve(m_lyrics.lines.size() + 1);
+    layout.line_top.reserve(m_lyrics.lines.size() + 1);
+    layout.row_height = font_metrics.tmHeight + linegap;
+    for(const LyricDataLine& line : m_lyrics.lines)
+    {
+        layout.line_first_row.push_back(layout.rows.size());
+        layout.line_top.push_back(int(layout.rows.size()) * layout.row_height);
+        if(!_WrapCompoundLyricsLine(dc, font_metrics, width, line.text, layout.rows))
+        {
+            LOG_WARN("Failed to compute the layout of a lyric line");
+        }
+    }
+    layout.line_first_row.push_back(layout.rows.size());
+    layout.line_top.push_back(int(layout.rows.size()) * layout.row_height);
+
+    layout.valid = true;
+    layout.font = font;
+    layout.linegap = linegap;
+    layout.width = width;
+    return layout;
+}
+
+void LyricPanel::InvalidateLyricLayout()
+{
+    m_lyrics_layout.valid = false;
 }
 
 static CPoint get_text_origin(CRect client_rect, TEXTMETRIC& font_metrics)
@@ -610,11 +794,11 @@ static bool is_text_top_aligned()
     }
 }
 
-void LyricPanel::DrawNoLyrics(HDC dc, CRect client_rect)
+LyricPanel::NextFrame LyricPanel::DrawNoLyrics(HDC dc, CRect client_rect)
 {
     if(m_now_playing == nullptr)
     {
-        return;
+        return {DBL_MAX, {}, 0.0};
     }
 
     // TODO: If we make this text configurable in future and we want to also show some text
@@ -622,9 +806,9 @@ void LyricPanel::DrawNoLyrics(HDC dc, CRect client_rect)
     //       metadb.h (in foo_SDK) -> metadb_display_field_provider
     //       which exists to let you hook into the title format process and add new fields.
 
-    std::string artist = track_metadata(m_now_playing_info, "artist");
-    std::string album = track_metadata(m_now_playing_info, "album");
-    std::string title = track_metadata(m_now_playing_info, "title");
+    const std::string& artist = m_now_playing_key.artist;
+    const std::string& album = m_now_playing_key.album;
+    const std::string& title = m_now_playing_key.title;
 
     int total_height = 0;
     std::tstring artist_line;
@@ -667,6 +851,9 @@ void LyricPanel::DrawNoLyrics(HDC dc, CRect client_rect)
         origin.y += DrawWrappedLyricLine(dc, client_rect, title_line, origin);
     }
 
+    // NOTE: We don't need to redraw to keep the progress message up-to-date because
+    //       lyric updates repaint all the panels whenever their progress changes.
+    double seconds_until_change = DBL_MAX;
     std::optional<std::string> progress_msg = LyricUpdateQueue::get_progress_message();
     if(progress_msg.has_value())
     {
@@ -686,6 +873,7 @@ void LyricPanel::DrawNoLyrics(HDC dc, CRect client_rect)
         uint64_t ticks_since_search_avoided = filetimestamp_from_system_timer() - m_auto_search_avoided_timestamp;
         if(ticks_since_search_avoided < search_avoided_msg_ticks)
         {
+            seconds_until_change = double(search_avoided_msg_ticks - ticks_since_search_avoided)/10'000'000.0;
             origin.y += DrawWrappedLyricLine(dc, client_rect, _T(""), origin);
             switch(m_auto_search_avoided_reason)
             {
@@ -713,25 +901,26 @@ void LyricPanel::DrawNoLyrics(HDC dc, CRect client_rect)
             }
         }
     }
+
+    return {seconds_until_change, {}, 0.0};
 }
 
-void LyricPanel::DrawUntimedLyrics(HDC dc, CRect client_area)
+LyricPanel::NextFrame LyricPanel::DrawUntimedLyrics(HDC dc, CRect client_area, CRect paint_area)
 {
     double track_fraction = 0.0;
+    double track_length = 0.0;
     if(preferences::display::scroll_type() == LineScrollType::Automatic)
     {
         const PlaybackTimeInfo playback_time = get_playback_time();
         track_fraction = playback_time.current_time / playback_time.track_length;
+        track_length = playback_time.track_length;
     }
 
     TEXTMETRIC font_metrics = {};
     WIN32_OP_D(GetTextMetrics(dc, &font_metrics))
 
-    const int total_height = std::accumulate(m_lyrics.lines.begin(), m_lyrics.lines.end(), 0,
-        [dc, client_area](int x, const LyricDataLine& line)
-        {
-            return x + ComputeWrappedLyricLineHeight(dc, client_area, line.text);
-        });
+    const WrappedLyricLayout& layout = GetLyricLayout(dc, client_area);
+    const int total_height = layout.line_top.back();
     const int total_scrollable_height = total_height - font_metrics.tmHeight - preferences::display::linegap();
 
     CPoint origin = get_text_origin(client_area, font_metrics);
@@ -759,17 +948,31 @@ void LyricPanel::DrawUntimedLyrics(HDC dc, CRect client_area)
     m_manual_scroll_distance = min(max(m_manual_scroll_distance, min_scroll), max_scroll);
     origin.y += m_manual_scroll_distance;
 
-    for(const LyricDataLine& line : m_lyrics.lines)
+    const VisibleLineRange visible = get_visible_lines(layout, font_metrics, paint_area, origin.y);
+    for(size_t line_index=visible.begin; line_index < visible.end; line_index++)
     {
-        int wrapped_line_height = DrawWrappedLyricLine(dc, client_area, line.text, origin);
-        if(wrapped_line_height <= 0)
+        const CPoint line_origin(origin.x, origin.y + layout.line_top[line_index]);
+        if(!DrawLyricLayoutLine(dc, paint_area, font_metrics, layout, line_index, m_lyrics.lines[line_index].text, line_origin))
         {
             LOG_WARN("Failed to draw unsynced text: %d", GetLastError());
             StopTimer();
             break;
         }
-        origin.y += wrapped_line_height;
     }
+
+    // NOTE: With automatic scrolling, the text moves by one pixel at a time at a constant rate. Otherwise it only ever moves when scrolled manually.
+    double seconds_until_change = DBL_MAX;
+    const double scrolled_pixels = track_fraction * total_scrollable_height;
+    const double pixels_per_second = (track_length == 0.0) ? 0.0 : (double(total_scrollable_height) / track_length);
+    if(pixels_per_second > 0.0)
+    {
+        seconds_until_change = (std::floor(scrolled_pixels) + 1.0 - scrolled_pixels) / pixels_per_second;
+    }
+    else if(pixels_per_second < 0.0)
+    {
+        seconds_until_change = 1.0 / -pixels_per_second;
+    }
+    return {seconds_until_change, {}, 0.0};
 }
 
 struct LyricScrollPosition
@@ -797,7 +1000,28 @@ static LyricScrollPosition get_scroll_position(const LyricData& lyrics, double c
     return {active_line_index, next_line_scroll_factor};
 }
 
-void LyricPanel::DrawTimestampedLyrics(HDC dc, CRect client_area)
+// Returns the number of seconds until the given active line starts to scroll or fade to the next line, or zero if it already has
+static double get_seconds_until_line_transition(const LyricData& lyrics, int active_line_index, double current_time, double transition_duration)
+{
+    const double next_line_time = lyrics.LineTimestamp(active_line_index+1);
+    if(next_line_time == DBL_MAX)
+    {
+        return DBL_MAX; // There is no next line to move to, so nothing will change
+    }
+
+    const double transition_start_time = max(lyrics.LineTimestamp(active_line_index), next_line_time - transition_duration);
+    return max(0.0, transition_start_time - current_time);
+}
+
+// Returns the area covered by the given line, if the first row of the first line is drawn with its baseline at the given height
+static CRect get_line_rect(const WrappedLyricLayout& layout, const TEXTMETRIC& font_metrics, CRect client_area, int first_baseline_y, size_t line_index)
+{
+    const int top_baseline_y = first_baseline_y + layout.line_top[line_index];
+    const int bottom_baseline_y = max(top_baseline_y, first_baseline_y + layout.line_top[line_index+1] - layout.row_height);
+    return CRect(client_area.left, top_baseline_y - font_metrics.tmAscent, client_area.right, bottom_baseline_y + font_metrics.tmDescent);
+}
+
+LyricPanel::NextFrame LyricPanel::DrawTimestampedLyrics(HDC dc, CRect client_area, CRect paint_area)
 {
     // NOTE: The drawing call uses the glyph baseline as the origin.
     //       We want our text to be perfectly vertically centered, so we need to offset it
@@ -816,23 +1040,21 @@ void LyricPanel::DrawTimestampedLyrics(HDC dc, CRect client_area)
     const double fade_duration = preferences::display::highlight_fade_seconds();
     const LyricScrollPosition fade = get_scroll_position(m_lyrics, playback_time.current_time, fade_duration);
 
+    const WrappedLyricLayout& layout = GetLyricLayout(dc, client_area);
     int text_height_above_active_line = 0;
     int active_line_height = 0;
     if(scroll.active_line_index >= 0)
     {
-        for(int i=0; i<scroll.active_line_index; i++)
-        {
-            text_height_above_active_line += ComputeWrappedLyricLineHeight(dc, client_area, m_lyrics.lines[i].text);
-        }
-        active_line_height = ComputeWrappedLyricLineHeight(dc, client_area, m_lyrics.lines[scroll.active_line_index].text);
+        text_height_above_active_line = layout.line_top[scroll.active_line_index];
+        active_line_height = layout.line_top[scroll.active_line_index+1] - text_height_above_active_line;
     }
 
     int next_line_scroll = (int)((double)active_line_height * scroll.next_line_scroll_factor);
     CPoint origin = get_text_origin(client_area, font_metrics);
     origin.y -= text_height_above_active_line + next_line_scroll;
 
-    const int lyric_line_count = static_cast<int>(m_lyrics.lines.size());
-    for(int line_index=0; line_index < lyric_line_count; line_index++)
+    const VisibleLineRange visible = get_visible_lines(layout, font_metrics, paint_area, origin.y);
+    for(int line_index=int(visible.begin); line_index < int(visible.end); line_index++)
     {
         const LyricDataLine& line = m_lyrics.lines[line_index];
         if(line_index == scroll.active_line_index)
@@ -854,16 +1076,34 @@ void LyricPanel::DrawTimestampedLyrics(HDC dc, CRect client_area)
             SetTextColor(dc, main_text_colour);
         }
 
-        int wrapped_line_height = DrawWrappedLyricLine(dc, client_area, line.text, origin);
-        if(wrapped_line_height == 0)
+        const CPoint line_origin(origin.x, origin.y + layout.line_top[line_index]);
+        if(!DrawLyricLayoutLine(dc, paint_area, font_metrics, layout, size_t(line_index), line.text, line_origin))
         {
             LOG_ERROR("Failed to draw synced text");
             StopTimer();
             break;
         }
+    }
+
+    NextFrame next_frame = {};
+    next_frame.delay_seconds = get_seconds_until_line_transition(m_lyrics, scroll.active_line_index, playback_time.current_time, max(scroll_time, fade_duration));
 
-        origin.y += wrapped_line_height;
+    // While the highlight is fading but the lines have not yet started scrolling, only the lines that are changing colour need to be redrawn
+    const double scroll_start_time = max(m_lyrics.LineTimestamp(scroll.active_line_index), m_lyrics.LineTimestamp(scroll.active_line_index+1) - scroll_time);
+    if((next_frame.delay_seconds == 0.0) && (playback_time.current_time < scroll_start_time))
+    {
+        CRect dirty_rect = {};
+        const int line_count = static_cast<int>(m_lyrics.lines.size());
+        for(int line_index=max(0, scroll.active_line_index); line_index <= min(scroll.active_line_index+1, line_count-1); line_index++)
+        {
+            const CRect line_rect = get_line_rect(layout, font_metrics, client_area, origin.y, size_t(line_index));
+            dirty_rect.UnionRect(&dirty_rect, &line_rect);
+        }
+        dirty_rect.IntersectRect(&dirty_rect, &client_area);
+        next_frame.dirty_rect = dirty_rect;
+        next_frame.dirty_rect_end_time = scroll_start_time;
     }
+    return next_frame;
 }
 
 void LyricPanel::OnPaint(CDCHandle)
@@ -879,7 +1119,7 @@ void LyricPanel::OnPaint(CDCHandle)
         {
             if(should_panel_search(this))
             {
-                const SearchAvoidanceReason avoid_reason = search_avoidance_allows_search(m_now_playing, m_now_playing_info);
+                const SearchAvoidanceReason avoid_reason = search_avoidance_allows_search(m_now_playing, m_now_playing_info, m_now_playing_key);
                 InitiateLyricSearch(avoid_reason);
             }
         }
@@ -892,14 +1132,41 @@ void LyricPanel::OnPaint(CDCHandle)
 
     // As suggested in this article: https://docs.microsoft.com/en-us/previous-versions/ms969905(v=msdn.10)
     // We get flickering if we draw everything to the UI directly, so instead we render everything to a back buffer
-    // and then blit the whole thing to the screen at the end.
+    // and then blit it to the screen at the end.
+    // NOTE: Only the invalidated part of the panel is redrawn (and copied to the screen). When only some of the lines are
+    //       changing (e.g when fading the highlight between lines) that can be much less than the whole panel.
     PAINTSTRUCT paintstruct;
     HDC front_buffer = BeginPaint(&paintstruct);
+    const CRect paint_rect = paintstruct.rcPaint;
 
     CRect client_rect;
     WIN32_OP_D(GetClientRect(&client_rect))
 
-    if(m_background_img.valid())
+    // NOTE: If we fail to create the bitmap then it's likely that we'd fail again (e.g because we're out of GDI resources),
+    //       so we don't try again until the image changes and just draw straight from the image (below) in the meantime.
+    if(m_background_img.valid() && (m_background_dc == nullptr) && !m_background_bitmap_failed)
+    {
+        CreateBackgroundBitmap();
+    }
+
+    const bool background_fits_client = (m_background_img.width == client_rect.Width()) && (m_background_img.height == client_rect.Height());
+    if((m_background_dc != nullptr) && background_fits_client)
+    {
+        BitBlt(m_back_buffer, paint_rect.left, paint_rect.top,
+               paint_rect.Width(), paint_rect.Height(),
+               m_background_dc, paint_rect.left, paint_rect.top,
+               SRCCOPY);
+    }
+    else if(m_background_dc != nullptr)
+    {
+        // The background hasn't been recomputed for the new size yet (e.g we're waiting for album art), so just stretch the old one for now
+        StretchBlt(m_back_buffer, client_rect.left, client_rect.top,
+                   client_rect.Width(), client_rect.Height(),
+                   m_background_dc, 0, 0,
+                   m_background_img.width, m_background_img.height,
+                   SRCCOPY);
+    }
+    else if(m_background_img.valid())
     {
         BITMAPINFO bmp = {};
         bmp.bmiHeader.biSize = sizeof(bmp.bmiHeader);
@@ -927,7 +1194,7 @@ void LyricPanel::OnPaint(CDCHandle)
     {
         const t_ui_color bg_colour = defaultui::background_colour();
         HBRUSH bg_brush = CreateSolidBrush(bg_colour);
-        FillRect(m_back_buffer, &client_rect, bg_brush);
+        FillRect(m_back_buffer, &paint_rect, bg_brush);
         DeleteObject(bg_brush);
     }
 
@@ -965,25 +1232,28 @@ void LyricPanel::OnPaint(CDCHandle)
     {
         LOG_WARN("Failed to set text alignment: %d", GetLastError());
     }
+    NextFrame next_frame = {};
     if(m_lyrics.IsEmpty())
     {
-        DrawNoLyrics(m_back_buffer, client_rect);
+        next_frame = DrawNoLyrics(m_back_buffer, client_rect);
     }
     else if(m_lyrics.IsTimestamped() &&
             (preferences::display::scroll_type() == LineScrollType::Automatic))
     {
-        DrawTimestampedLyrics(m_back_buffer, client_rect);
+        next_frame = DrawTimestampedLyrics(m_back_buffer, client_rect, paint_rect);
     }
     else // We have lyrics, but no timestamps
     {
-        DrawUntimedLyrics(m_back_buffer, client_rect);
+        next_frame = DrawUntimedLyrics(m_back_buffer, client_rect, paint_rect);
     }
 
-    BitBlt(front_buffer, client_rect.left, client_rect.top,
-            client_rect.Width(), client_rect.Height(),
-            m_back_buffer, 0, 0,
+    BitBlt(front_buffer, paint_rect.left, paint_rect.top,
+            paint_rect.Width(), paint_rect.Height(),
+            m_back_buffer, paint_rect.left, paint_rect.top,
             SRCCOPY);
     EndPaint(&paintstruct);
+
+    ScheduleNextFrame(next_frame);
 }
 
 void LyricPanel::OnContextMenu(CWindow window, CPoint point)
@@ -1111,7 +1381,7 @@ void LyricPanel::OnContextMenu(CWindow window, CPoint point)
                 try
                 {
                     const bool allow_overwrite = true;
-                    io::save_lyrics(m_now_playing, m_now_playing_info, m_lyrics, allow_overwrite, m_child_abort);
+                    io::save_lyrics(m_now_playing, m_now_playing_info, m_lyrics, allow_overwrite);
                 }
                 catch(const std::exception& e)
                 {
@@ -1215,6 +1485,7 @@ void LyricPanel::OnContextMenu(CWindow window, CPoint point)
                 {
                     io::delete_saved_lyrics(m_now_playing, m_lyrics);
                     m_lyrics = {};
+                    InvalidateLyricLayout();
                 }
                 search_avoidance_force_by_mark_instrumental(m_now_playing);
             } break;
@@ -1294,6 +1565,7 @@ void LyricPanel::OnContextMenu(CWindow window, CPoint point)
                 if(deleted)
                 {
                     m_lyrics = {};
+                    InvalidateLyricLayout();
                 }
             } break;
 
@@ -1314,7 +1586,9 @@ void LyricPanel::OnContextMenu(CWindow window, CPoint point)
             std::optional<LyricData> maybe_lyrics = io::process_available_lyric_update(update);
             assert(maybe_lyrics.has_value()); // Round-trip through the processing to avoid copies
             m_lyrics = std::move(maybe_lyrics.value());
+            InvalidateLyricLayout();
         }
+        Invalidate(); // Draw again in case any of the above changed what we should display
     }
     catch(std::exception const & e)
     {
@@ -1386,11 +1660,7 @@ void LyricPanel::StartTimer()
     if (m_timerRunning) return;
     m_timerRunning = true;
 
-    UINT_PTR result = SetTimer(m_panel_update_timer, 16, nullptr);
-    if (result != m_panel_update_timer)
-    {
-        LOG_WARN("Unexpected timer result when starting playback timer");
-    }
+    ScheduleNextFrame({0.0, {}, 0.0});
 }
 
 void LyricPanel::StopTimer()
@@ -1398,12 +1668,50 @@ void LyricPanel::StopTimer()
     if (!m_timerRunning) return;
     m_timerRunning = false;
 
+    CancelScheduledFrame();
+}
+
+// Schedules the panel to be redrawn once the given number of seconds have passed (or as soon as possible if the delay is zero).
+// Frames are only scheduled while playback is in progress, since otherwise nothing we draw changes with time.
+void LyricPanel::ScheduleNextFrame(NextFrame frame)
+{
+    m_scheduled_dirty_rect = frame.dirty_rect;
+    m_scheduled_dirty_rect_end_time = frame.dirty_rect_end_time;
+
+    const double delay_seconds = frame.delay_seconds;
+    if(!m_timerRunning || (delay_seconds == DBL_MAX))
+    {
+        // Nothing will change until something else causes us to redraw (e.g a seek, new lyrics or the panel being resized)
+        CancelScheduledFrame();
+        return;
+    }
+
+    // NOTE: While the text is scrolling, we want to redraw at our animation frame rate but not any faster.
+    //       The longest delay is limited only to avoid overflowing the timer's (unsigned, milliseconds) interval.
+    const UINT animation_frame_ms = 16;
+    const double max_delay_seconds = 60.0*60.0;
+    const UINT delay_ms = UINT(std::ceil(min(delay_seconds, max_delay_seconds) * 1000.0));
+    UINT_PTR result = SetTimer(m_panel_update_timer, max(delay_ms, animation_frame_ms), nullptr);
+    if (result != m_panel_update_timer)
+    {
+        LOG_WARN("Unexpected timer result when scheduling the next panel update");
+        return;
+    }
+    m_frame_scheduled = true;
+}
+
+void LyricPanel::CancelScheduledFrame()
+{
+    if(!m_frame_scheduled) return;
+    m_frame_scheduled = false;
+
     WIN32_OP(KillTimer(m_panel_update_timer))
 }
 
 void LyricPanel::InitiateLyricSearch(SearchAvoidanceReason avoid_reason)
 {
     m_lyrics = {};
+    InvalidateLyricLayout();
     m_auto_search_avoided_reason = avoid_reason;
 
     const bool search_local_only = (avoid_reason != SearchAvoidanceReason::Allowed);
@@ -1474,6 +1782,7 @@ void LyricPanel::LyricUpdateQueue::check_for_available_updates()
                 {
                     assert(panel != nullptr);
                     panel->m_lyrics = maybe_lyrics.value();
+                    panel->InvalidateLyricLayout();
                     panel->m_auto_search_avoided_reason = SearchAvoidanceReason::Allowed;
                     ::InvalidateRect(panel->m_hWnd, nullptr, TRUE);
                 }
@@ -6,6 +6,27 @@
 #include "lyric_io.h"
 #include "metadb_index_search_avoidance.h"
 
+// The result of wrapping every lyric line to fit within the width of a panel
+struct WrappedLyricLayout
+{
+    struct Row
+    {
+        size_t text_start; // The index (in the text of the lyric line) of the first char drawn on this row
+        int text_length;   // The number of chars drawn on this row
+    };
+
+    std::vector<Row> rows;              // The rows of every line, in order
+    std::vector<size_t> line_first_row; // The index of the first row of each line, followed by the total row count
+    std::vector<int> line_top;          // The distance from the top of the first line to the top of each line, followed by the total height
+    int row_height;
+
+    // The inputs for which the layout was computed. It is recomputed whenever any of these change.
+    bool valid;
+    LOGFONT font;
+    int linegap;
+    int width;
+};
+
 class LyricPanel : public CWindowImpl<LyricPanel>, private play_callback
 {
 public:
@@ -86,11 +107,27 @@ private:
     void StartTimer();
 protected: // TODO: Only protected to support the external window
     void StopTimer();
+
+    // When the panel will next look different, and which part of it will change
+    struct NextFrame
+    {
+        double delay_seconds;           // The number of seconds until the next change. Zero while animating, DBL_MAX if nothing will change.
+        std::optional<CRect> dirty_rect; // The only part of the panel that will change, if the whole panel need not be redrawn
+        double dirty_rect_end_time;      // The playback time after which more than just the dirty rect might change
+    };
+    void ScheduleNextFrame(NextFrame frame);
 private:
+    void CancelScheduledFrame();
 
-    void DrawNoLyrics(HDC dc, CRect client_area);
-    void DrawUntimedLyrics(HDC dc, CRect client_area);
-    void DrawTimestampedLyrics(HDC dc, CRect client_area);
+    NextFrame DrawNoLyrics(HDC dc, CRect client_area);
+    NextFrame DrawUntimedLyrics(HDC dc, CRect client_area, CRect paint_area);
+    NextFrame DrawTimestampedLyrics(HDC dc, CRect client_area, CRect paint_area);
+
+    const WrappedLyricLayout& GetLyricLayout(HDC dc, CRect client_area);
+    void InvalidateLyricLayout();
+
+    void CreateBackgroundBitmap();
+    void ReleaseBackgroundBitmap();
 
 protected: // TODO: Only protected to support the external window
     void InitiateLyricSearch(SearchAvoidanceReason avoid_reason);
@@ -106,23 +143,33 @@ private:
     abort_callback_impl m_child_abort;
 
     bool m_timerRunning = false;
+    bool m_frame_scheduled = false;
+    std::optional<CRect> m_scheduled_dirty_rect;
+    double m_scheduled_dirty_rect_end_time = 0.0;
     UINT_PTR m_panel_update_timer;
 
 protected: // TODO: These two are only protected to support the external window
     metadb_handle_ptr m_now_playing;
     metadb_v2_rec_t m_now_playing_info;
+    TrackKey m_now_playing_key;
 private:
     double m_now_playing_time_offset = 0.0;
 protected: // TODO: Only protected to support the external window
     LyricData m_lyrics;
     bool m_search_pending = false;
 private:
+    WrappedLyricLayout m_lyrics_layout = {};
     SearchAvoidanceReason m_auto_search_avoided_reason = SearchAvoidanceReason::Allowed;
     uint64_t m_auto_search_avoided_timestamp = 0;
 
     HDC m_back_buffer;
     HBITMAP m_back_buffer_bitmap;
 
+    // The background image, uploaded into a GDI bitmap once each time it is computed so that painting need only copy it
+    HDC m_background_dc = nullptr;
+    HBITMAP m_background_bitmap = nullptr;
+    bool m_background_bitmap_failed = false; // Set if we couldn't create the bitmap, so that we don't retry on every paint
+
     std::optional<CPoint> m_manual_scroll_start;
     int m_manual_scroll_distance;
 
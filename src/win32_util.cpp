@@ -1,5 +1,7 @@
 #include "stdafx.h"
 
+#include <shlwapi.h>
+
 #include "logging.h"
 #include "win32_util.h"
 
@@ -165,3 +167,94 @@ BOOL DrawTextOut(HDC dc, int x, int y, std::tstring_view string)
     return TextOut(dc, x, y, string.data(), int(string.length()));
 }
 
+static bool is_on_fixed_local_drive(const std::tstring& path)
+{
+    if(PathIsNetworkPath(path.c_str()))
+    {
+        return false;
+    }
+
+    // NOTE: We ask for the volume root rather than just taking the drive letter so that
+    //       volumes mounted into a folder (and drive letters mapped to network shares) are handled correctly.
+    TCHAR volume_root[MAX_PATH+1] = {};
+    if(!GetVolumePathName(path.c_str(), volume_root, MAX_PATH+1))
+    {
+        return false;
+    }
+    return GetDriveType(volume_root) == DRIVE_FIXED;
+}
+
+std::shared_ptr<const MappedFile> MappedFile::open(std::tstring_view native_path)
+{
+    // NOTE: If the data behind a mapped view can't be read when we touch it (e.g because a network share dropped
+    //       out, removable media was ejected or the file was truncated remotely) then Windows raises a structured
+    //       exception (EXCEPTION_IN_PAGE_ERROR) rather than a C++ one, which would crash foobar.
+    //       We therefore only map files on fixed local drives, and read everything else through a normal buffered read.
+    const std::tstring path_str(native_path);
+    if(!is_on_fixed_local_drive(path_str))
+    {
+        LOG_INFO("Not mapping %s because it is not on a fixed local drive", from_tstring(native_path).c_str());
+        return nullptr;
+    }
+
+    // NOTE: MappedFile has a private constructor so we can't use std::make_shared
+    std::shared_ptr<MappedFile> result(new MappedFile());
+
+    result->m_file = CreateFile(path_str.c_str(),
+                                GENERIC_READ,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr,
+                                OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                                nullptr);
+    if(result->m_file == INVALID_HANDLE_VALUE)
+    {
+        LOG_INFO("Failed to open %s for mapping: %d", from_tstring(native_path).c_str(), GetLastError());
+        return nullptr;
+    }
+
+    LARGE_INTEGER file_size = {};
+    if(!GetFileSizeEx(result->m_file, &file_size) || (file_size.QuadPart <= 0) || (uint64_t(file_size.QuadPart) > SIZE_MAX))
+    {
+        // NOTE: Empty files cannot be mapped (CreateFileMapping fails with ERROR_FILE_INVALID)
+        return nullptr;
+    }
+    result->m_size = size_t(file_size.QuadPart);
+
+    result->m_mapping = CreateFileMapping(result->m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(result->m_mapping == nullptr)
+    {
+        LOG_INFO("Failed to create file mapping for %s: %d", from_tstring(native_path).c_str(), GetLastError());
+        return nullptr;
+    }
+
+    result->m_view = MapViewOfFile(result->m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if(result->m_view == nullptr)
+    {
+        LOG_INFO("Failed to map view of %s: %d", from_tstring(native_path).c_str(), GetLastError());
+        return nullptr;
+    }
+
+    return result;
+}
+
+MappedFile::~MappedFile()
+{
+    if(m_view != nullptr)
+    {
+        UnmapViewOfFile(m_view);
+    }
+    if(m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+    }
+    if(m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+    }
+}
+
+std::string_view MappedFile::contents() const
+{
+    return std::string_view(static_cast<const char*>(m_view), m_size);
+}
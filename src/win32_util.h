@@ -2,6 +2,8 @@
 
 #include "stdafx.h"
 
+#include <memory>
+
 namespace std
 {
 #ifdef UNICODE
@@ -29,3 +31,27 @@ std::tstring normalise_utf8(std::tstring_view input);
 bool hr_success(HRESULT result, const char* filename, int line_number);
 std::optional<SIZE> GetTextExtents(HDC dc, std::tstring_view string); // GetTextExtentPoint32
 BOOL DrawTextOut(HDC dc, int x, int y, std::tstring_view string); // TextOut
+
+// The contents of a file on the local filesystem, mapped read-only into memory.
+// Others can still open the file (for reading, writing or deleting) while it is mapped, but it cannot be replaced
+// (e.g by move_overwrite when saving new lyrics) until the mapping is released, so don't hold on to it for any longer than needed.
+class MappedFile
+{
+public:
+    // Returns null if the file could not be mapped (e.g because it doesn't exist, is empty or is not on a fixed local drive)
+    static std::shared_ptr<const MappedFile> open(std::tstring_view native_path);
+
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+    ~MappedFile();
+
+    std::string_view contents() const;
+
+private:
+    MappedFile() = default;
+
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+    const void* m_view = nullptr;
+    size_t m_size = 0;
+};
@@ -0,0 +1,442 @@
+#include "bvtf.h"
+
+#include "lyric_auto_edit.h"
+#include "parsers.h"
+
+static LyricData make_lyrics(std::vector<LyricDataLine> lines)
+{
+    LyricData lyrics = {};
+    lyrics.lines = std::move(lines);
+    lyrics.timestamp_offset = 0.0;
+    return lyrics;
+}
+
+static bool lines_equal(const std::vector<LyricDataLine>& lhs, const std::vector<LyricDataLine>& rhs)
+{
+    if(lhs.size() != rhs.size())
+    {
+        return false;
+    }
+    for(size_t i=0; i<lhs.size(); i++)
+    {
+        if((lhs[i].text != rhs[i].text) || (lhs[i].timestamp != rhs[i].timestamp))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+BVTF_TEST(autoedit_remove_repeated_spaces)
+{
+    LyricData lyrics = make_lyrics({{_T("a  b   c "), DBL_MAX}, {_T("   "), DBL_MAX}, {_T("d e"), DBL_MAX}});
+    ASSERT(auto_edit::RunAutoEdits({AutoEditType::RemoveRepeatedSpaces}, lyrics));
+    CHECK(lines_equal(lyrics.lines, {{_T("a b c "), DBL_MAX}, {_T(" "), DBL_MAX}, {_T("d e"), DBL_MAX}}));
+}
+
+BVTF_TEST(autoedit_remove_repeated_blank_lines)
+{
+    LyricData lyrics = make_lyrics({{_T(""), DBL_MAX}, {_T("a"), DBL_MAX}, {_T(""), DBL_MAX}, {_T("  "), DBL_MAX}, {_T(""), DBL_MAX}, {_T("b"), DBL_MAX}});
+    ASSERT(auto_edit::RunAutoEdits({AutoEditType::RemoveRepeatedBlankLines}, lyrics));
+    CHECK(lines_equal(lyrics.lines, {{_T("a"), DBL_MAX}, {_T(""), DBL_MAX}, {_T("b"), DBL_MAX}}));
+}
+
+BVTF_TEST(autoedit_remove_all_blank_lines)
+{
+    LyricData lyrics = make_lyrics({{_T("a"), 1.0}, {_T(" \t"), 2.0}, {_T(""), DBL_MAX}, {_T("b"), DBL_MAX}});
+    ASSERT(auto_edit::RunAutoEdits({AutoEditType::RemoveAllBlankLines}, lyrics));
+    CHECK(lines_equal(lyrics.lines, {{_T("a"), 1.0}, {_T("b"), DBL_MAX}}));
+}
+
+BVTF_TEST(autoedit_replace_html_escaped_chars_in_lines_and_tags)
+{
+    LyricData lyrics = make_lyrics({{_T("Rock &amp; Roll"), 1.0}, {_T("&lt;3 &quot;quoted&quot;"), 2.0}, {_T("R&B"), 3.0}});
+    lyrics.tags = {"[ar:AC&amp;DC]"};
+    ASSERT(auto_edit::RunAutoEdits({AutoEditType::ReplaceHtmlEscapedChars}, lyrics));
+    CHECK(lines_equal(lyrics.lines, {{_T("Rock & Roll"), 1.0}, {_T("<3 \"quoted\""), 2.0}, {_T("R&B"), 3.0}}));
+    ASSERT(lyrics.tags.size() == 1);
+    CHECK(lyrics.tags[0] == "[ar:AC&DC]");
+}
+
+BVTF_TEST(autoedit_reset_capitalisation)
+{
+    LyricData lyrics = make_lyrics({{_T("hELLO World"), DBL_MAX}, {_T("Already fine"), DBL_MAX}});
+    ASSERT(auto_edit::RunAutoEdits({AutoEditType::ResetCapitalisation}, lyrics));
+    CHECK(lines_equal(lyrics.lines, {{_T("Hello world"), DBL_MAX}, {_T("Already fine"), DBL_MAX}}));
+}
+
+BVTF_TEST(autoedit_fix_malformed_timestamps_moves_fixed_lines_into_place)
+{
+    LyricData lyrics = make_lyrics({{_T("First"), 1.0}, {_T("Third"), 3.0}, {_T("[00:02:00]Second"), DBL_MAX}});
+    ASSERT(auto_edit::RunAutoEdits({AutoEditType::FixMalformedTimestamps}, lyrics));
+    CHECK(lines_equal(lyrics.lines, {{_T("First"), 1.0}, {_T("Second"), 2.0}, {_T("Third"), 3.0}}));
+}
+
+BVTF_TEST(autoedit_fix_malformed_timestamps_duplicates_lines_with_several_timestamps)
+{
+    LyricData lyrics = make_lyrics({{_T("[00:04:00]Chorus"), 1.0}, {_T("Verse"), 2.0}});
+    ASSERT(auto_edit::RunAutoEdits({AutoEditType::FixMalformedTimestamps}, lyrics));
+    CHECK(lines_equal(lyrics.lines, {{_T("Chorus"), 1.0}, {_T("Verse"), 2.0}, {_T("Chorus"), 4.0}}));
+}
+
+BVTF_TEST(autoedit_remove_timestamps)
+{
+    LyricData lyrics = make_lyrics({{_T("a"), 1.0}, {_T("b"), DBL_MAX}});
+    ASSERT(auto_edit::RunAutoEdits({AutoEditType::RemoveTimestamps}, lyrics));
+    CHECK(lines_equal(lyrics.lines, {{_T("a"), DBL_MAX}, {_T("b"), DBL_MAX}}));
+    CHECK(!auto_edit::RunAutoEdits({AutoEditType::RemoveTimestamps}, lyrics));
+}
+
+BVTF_TEST(autoedit_reports_no_change_for_clean_lyrics)
+{
+    LyricData lyrics = make_lyrics({{_T("Clean line"), 1.0}, {_T(""), 2.0}, {_T("Another"), 3.0}});
+    const std::vector<AutoEditType> edits = {AutoEditType::ReplaceHtmlEscapedChars, AutoEditType::RemoveRepeatedSpaces, AutoEditType::RemoveRepeatedBlankLines, AutoEditType::FixMalformedTimestamps};
+    CHECK(!auto_edit::RunAutoEdits(edits, lyrics));
+    CHECK(lyrics.lines.size() == 3);
+}
+
+static LyricData make_large_messy_lyrics(size_t line_count)
+{
+    std::vector<LyricDataLine> lines;
+    lines.reserve(line_count);
+    for(size_t i=0; i<line_count; i++)
+    {
+        const double timestamp = double(i) * 0.5;
+        switch(i % 5)
+        {
+            case 0: lines.push_back({_T("tHIS   line has  Repeated    spaces and &amp; some &quot;escapes&quot;"), timestamp}); break;
+            case 1: lines.push_back({_T(""), timestamp}); break;
+            case 2: lines.push_back({_T("   "), timestamp}); break;
+            case 3: lines.push_back({_T("A perfectly ordinary line of lyrics, nothing to see here"), timestamp}); break;
+            case 4: lines.push_back({_T("&lt;Another&gt;   LINE   with    MIXED case"), timestamp}); break;
+        }
+    }
+    return make_lyrics(std::move(lines));
+}
+
+BVTF_TEST(autoedit_combined_pass_matches_sequential_edits)
+{
+    const std::vector<AutoEditType> edits = {
+        AutoEditType::ReplaceHtmlEscapedChars,
+        AutoEditType::RemoveRepeatedSpaces,
+        AutoEditType::RemoveRepeatedBlankLines,
+        AutoEditType::ResetCapitalisation,
+        AutoEditType::RemoveAllBlankLines,
+        AutoEditType::RemoveTimestamps,
+    };
+    const LyricData input = make_large_messy_lyrics(1000);
+
+    LyricData sequential = input;
+    for(AutoEditType type : edits)
+    {
+        std::optional<LyricData> edited = auto_edit::RunAutoEdit(type, sequential);
+        if(edited.has_value())
+        {
+            sequential = std::move(edited.value());
+        }
+    }
+
+    LyricData combined = input;
+    ASSERT(auto_edit::RunAutoEdits(edits, combined));
+    CHECK(lines_equal(combined.lines, sequential.lines));
+}
+
+BVTF_TEST(autoedit_combined_pass_of_every_edit_matches_sequential_edits)
+{
+    const std::vector<AutoEditType> edits = {
+        AutoEditType::ReplaceHtmlEscapedChars,
+        AutoEditType::RemoveRepeatedSpaces,
+        AutoEditType::RemoveRepeatedBlankLines,
+        AutoEditType::RemoveAllBlankLines,
+        AutoEditType::ResetCapitalisation,
+        AutoEditType::FixMalformedTimestamps,
+        AutoEditType::RemoveTimestamps,
+    };
+    const LyricData input = make_large_messy_lyrics(1000);
+
+    LyricData sequential = input;
+    for(AutoEditType type : edits)
+    {
+        std::optional<LyricData> edited = auto_edit::RunAutoEdit(type, sequential);
+        if(edited.has_value())
+        {
+            sequential = std::move(edited.value());
+        }
+    }
+
+    LyricData combined = input;
+    ASSERT(auto_edit::RunAutoEdits(edits, combined));
+    CHECK(lines_equal(combined.lines, sequential.lines));
+    CHECK(combined.lines.size() == 600);
+}
+
+// The auto-edit implementation from before edits were combined into a single pass, kept here as a benchmark baseline.
+// Each edit copies the whole lyrics and the text-replacement edits serialise the lyrics & parse them again.
+namespace previous_auto_edit
+{
+    static std::optional<LyricData> ReplaceHtmlEscapedChars(const LyricData& lyrics)
+    {
+        LyricDataUnstructured unstructured = parsers::lrc::serialise(lyrics);
+        std::pair<std::string_view, char> replacements[] =
+        {
+            {"&amp;", '&'},
+            {"&lt;", '<'},
+            {"&gt;", '>'},
+            {"&quot;", '"'},
+            {"&apos;", '\''},
+        };
+
+        size_t replace_count = 0;
+        for(auto [escaped, replacement] : replacements)
+        {
+            size_t current_index = 0;
+            while(current_index < unstructured.text.length())
+            {
+                size_t next_index = unstructured.text.find(escaped, current_index);
+                if(next_index == std::string::npos) break;
+
+                unstructured.text.replace(next_index, escaped.length(), 1, replacement);
+                current_index = next_index + 1;
+                replace_count++;
+            }
+        }
+
+        if(replace_count > 0)
+        {
+            return {parsers::lrc::parse(unstructured)};
+        }
+        return {};
+    }
+
+    static std::optional<LyricData> RemoveRepeatedSpaces(const LyricData& lyrics)
+    {
+        size_t spaces_erased = 0;
+        LyricData new_lyrics = lyrics;
+        for(LyricDataLine& line : new_lyrics.lines)
+        {
+            size_t search_start = 0;
+            while(search_start < line.text.length())
+            {
+                size_t next_space = line.text.find_first_of(_T(' '), search_start);
+                if(next_space > line.text.length()-1)
+                {
+                    break;
+                }
+
+                size_t erase_start = next_space + 1;
+                size_t erase_end = line.text.find_first_not_of(_T(' '), erase_start);
+                if((erase_end != std::tstring::npos) && (erase_end > erase_start))
+                {
+                    size_t erase_count = erase_end - erase_start;
+                    line.text.erase(erase_start, erase_count);
+                    spaces_erased += erase_count;
+                }
+                search_start = next_space + 1;
+            }
+        }
+
+        if(spaces_erased > 0)
+        {
+            return {std::move(new_lyrics)};
+        }
+        return {};
+    }
+
+    static std::optional<LyricData> RemoveRepeatedBlankLines(const LyricData& lyrics)
+    {
+        size_t lines_removed = 0;
+        bool previous_blank = true;
+        LyricData new_lyrics = lyrics;
+        for(auto iter=new_lyrics.lines.begin(); iter != new_lyrics.lines.end(); /*Omitted*/)
+        {
+            size_t first_non_space = iter->text.find_first_not_of(' ');
+            bool is_blank = (first_non_space == std::tstring::npos);
+            if(is_blank && previous_blank)
+            {
+                iter = new_lyrics.lines.erase(iter);
+                lines_removed++;
+            }
+            else
+            {
+                iter++;
+            }
+            previous_blank = is_blank;
+        }
+
+        if(lines_removed > 0)
+        {
+            return {std::move(new_lyrics)};
+        }
+        return {};
+    }
+
+    static std::optional<LyricData> RemoveAllBlankLines(const LyricData& lyrics)
+    {
+        LyricData new_lyrics = lyrics;
+        auto line_is_empty = [](const LyricDataLine& line)
+        {
+            const auto is_not_whitespace = [](wchar_t c) { return std::iswspace(c) == 0; };
+            return std::find_if(line.text.begin(), line.text.end(), is_not_whitespace) == line.text.end();
+        };
+        auto new_end = std::remove_if(new_lyrics.lines.begin(), new_lyrics.lines.end(), line_is_empty);
+        ptrdiff_t lines_removed = std::distance(new_end, new_lyrics.lines.end());
+        new_lyrics.lines.erase(new_end, new_lyrics.lines.end());
+
+        if(lines_removed > 0)
+        {
+            return {std::move(new_lyrics)};
+        }
+        return {};
+    }
+
+    static std::optional<LyricData> ResetCapitalisation(const LyricData& lyrics)
+    {
+        LyricData new_lyrics = lyrics;
+
+        size_t edit_count = 0;
+        for(LyricDataLine& line : new_lyrics.lines)
+        {
+            if(line.text.empty()) continue;
+
+            bool edited = false;
+            if((line.text[0] <= 255) && _istlower(line.text[0]))
+            {
+                line.text[0] = _totupper(static_cast<unsigned char>(line.text[0]));
+                edited = true;
+            }
+
+            for(size_t i=1; i<line.text.length(); i++)
+            {
+                if((line.text[i] <= 255) && _istupper(line.text[i]))
+                {
+                    line.text[i] = _totlower(static_cast<unsigned char>(line.text[i]));
+                    edited = true;
+                }
+            }
+
+            if(edited)
+            {
+                edit_count++;
+            }
+        }
+
+        if(edit_count > 0)
+        {
+            return {std::move(new_lyrics)};
+        }
+        return {};
+    }
+
+    static std::optional<LyricData> FixMalformedTimestamps(const LyricData& lyrics)
+    {
+        const auto fix_decimal_separator = [](std::string_view tag)
+        {
+            if((tag.length() < 10) || (tag[0] != '[') || (tag[tag.length()-1] != ']'))
+            {
+                return false;
+            }
+
+            double unused;
+            if(parsers::lrc::try_parse_timestamp(tag, unused))
+            {
+                return false;
+            }
+
+            size_t last_nondecimal_index = tag.find_last_not_of("1234567890.", tag.length()-2);
+            if(last_nondecimal_index == std::string_view::npos)
+            {
+                return false;
+            }
+
+            char replaced_char = tag[last_nondecimal_index];
+            const_cast<char&>(tag[last_nondecimal_index]) = '.';
+            if(parsers::lrc::try_parse_timestamp(tag, unused))
+            {
+                return true;
+            }
+            const_cast<char&>(tag[last_nondecimal_index]) = replaced_char;
+            return false;
+        };
+
+        LyricDataUnstructured new_lyrics = parsers::lrc::serialise(lyrics);
+
+        int change_count = 0;
+        size_t current_index = new_lyrics.text.find('[');
+        while(current_index != std::string::npos)
+        {
+            size_t end_index = new_lyrics.text.find(']', current_index);
+            if(end_index == std::string::npos)
+            {
+                break;
+            }
+            std::string_view tag {new_lyrics.text.c_str() + current_index, end_index - current_index + 1};
+            if(fix_decimal_separator(tag))
+            {
+                change_count++;
+            }
+            current_index = new_lyrics.text.find('[', current_index+1);
+        }
+
+        if(change_count > 0)
+        {
+            return {parsers::lrc::parse(new_lyrics)};
+        }
+        return {};
+    }
+
+    static std::optional<LyricData> RemoveTimestamps(const LyricData& lyrics)
+    {
+        LyricData new_lyrics = lyrics;
+        for(LyricDataLine& line : new_lyrics.lines)
+        {
+            line.timestamp = DBL_MAX;
+        }
+        return {new_lyrics};
+    }
+}
+
+BVTF_BENCHMARK(autoedit_benchmark_all_edits_on_large_lyrics)
+{
+    const std::vector<AutoEditType> edits = {
+        AutoEditType::ReplaceHtmlEscapedChars,
+        AutoEditType::RemoveRepeatedSpaces,
+        AutoEditType::RemoveRepeatedBlankLines,
+        AutoEditType::RemoveAllBlankLines,
+        AutoEditType::ResetCapitalisation,
+        AutoEditType::FixMalformedTimestamps,
+        AutoEditType::RemoveTimestamps,
+    };
+    using previous_edit_func = std::optional<LyricData>(*)(const LyricData&);
+    const previous_edit_func previous_edits[] = {
+        previous_auto_edit::ReplaceHtmlEscapedChars,
+        previous_auto_edit::RemoveRepeatedSpaces,
+        previous_auto_edit::RemoveRepeatedBlankLines,
+        previous_auto_edit::RemoveAllBlankLines,
+        previous_auto_edit::ResetCapitalisation,
+        previous_auto_edit::FixMalformedTimestamps,
+        previous_auto_edit::RemoveTimestamps,
+    };
+    const LyricData input = make_large_messy_lyrics(50'000);
+
+    LyricData previous = input;
+    {
+        BVTF_MEASURE("Previous implementation, one copying pass per edit");
+        for(previous_edit_func edit : previous_edits)
+        {
+            std::optional<LyricData> edited = edit(previous);
+            if(edited.has_value())
+            {
+                previous = std::move(edited.value());
+            }
+        }
+    }
+
+    LyricData combined = input;
+    {
+        BVTF_MEASURE("Single combined in-place pass");
+        ASSERT(auto_edit::RunAutoEdits(edits, combined));
+    }
+
+    CHECK(lines_equal(combined.lines, previous.lines));
+    CHECK(combined.lines.size() == 30'000);
+}
@@ -0,0 +1,156 @@
+#include "bvtf.h"
+
+#include <cctype>
+
+#include "tag_util.h"
+
+// The plain two-row Levenshtein distance that bounded_edit_distance replaced, to check that the results are unchanged
+static int reference_edit_distance(std::string_view strA, std::string_view strB)
+{
+    std::vector<int> prev_row(strB.length() + 1);
+    std::vector<int> cur_row(strB.length() + 1);
+    for(size_t i=0; i<prev_row.size(); i++)
+    {
+        prev_row[i] = static_cast<int>(i);
+    }
+
+    for(size_t row=0; row<strA.length(); row++)
+    {
+        cur_row[0] = static_cast<int>(row) + 1;
+        for(size_t i=0; i<strB.length(); i++)
+        {
+            const int delete_cost = prev_row[i+1] + 1;
+            const int insert_cost = cur_row[i] + 1;
+            const bool chars_equal = (std::tolower(static_cast<unsigned char>(strA[row])) == std::tolower(static_cast<unsigned char>(strB[i])));
+            const int subst_cost = prev_row[i] + (chars_equal ? 0 : 1);
+            cur_row[i+1] = std::min(std::min(delete_cost, insert_cost), subst_cost);
+        }
+        std::swap(prev_row, cur_row);
+    }
+    return prev_row[strB.length()];
+}
+
+static uint32_t next_random(uint32_t& state)
+{
+    // xorshift32, so that the test data is the same on every run
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static std::string random_string(uint32_t& rng, size_t length)
+{
+    // A small alphabet (including case variants and non-ASCII bytes) so that random strings are often similar
+    const char alphabet[] = { 'a', 'A', 'b', 'B', 'c', ' ', '\'', '\xC3', '\xA9' };
+    std::string result;
+    for(size_t i=0; i<length; i++)
+    {
+        result += alphabet[next_random(rng) % sizeof(alphabet)];
+    }
+    return result;
+}
+
+static std::string random_edit(uint32_t& rng, std::string str, int edit_count)
+{
+    for(int i=0; i<edit_count; i++)
+    {
+        const size_t index = str.empty() ? 0 : (next_random(rng) % str.length());
+        const char c = random_string(rng, 1)[0];
+        switch(next_random(rng) % 3)
+        {
+            case 0: str.insert(str.begin() + index, c); break;
+            case 1: if(!str.empty()) str.erase(str.begin() + index); break;
+            case 2: if(!str.empty()) str[index] = c; break;
+        }
+    }
+    return str;
+}
+
+BVTF_TEST(bounded_edit_distance_is_case_insensitive)
+{
+    ASSERT(bounded_edit_distance("Hello World", "hELLO wORLD", 3) == 0);
+    ASSERT(bounded_edit_distance("", "", 3) == 0);
+    ASSERT(bounded_edit_distance("abc", "", 3) == 3);
+    ASSERT(bounded_edit_distance("abcd", "", 3) == 4);
+    ASSERT(bounded_edit_distance("kitten", "sitting", 3) == 3);
+    ASSERT(bounded_edit_distance("kitten", "sitting", 2) == 3);
+}
+
+BVTF_TEST(bounded_edit_distance_matches_full_levenshtein_distance_for_short_strings)
+{
+    uint32_t rng = 0x1234567;
+    for(int iteration=0; iteration<20000; iteration++)
+    {
+        const std::string strA = random_string(rng, next_random(rng) % 16);
+        const std::string strB = (next_random(rng) % 2) ? random_string(rng, next_random(rng) % 16) : random_edit(rng, strA, next_random(rng) % 6);
+        const int max_distance = next_random(rng) % 6;
+
+        const int expected = std::min(reference_edit_distance(strA, strB), max_distance + 1);
+        const int actual = bounded_edit_distance(strA, strB, max_distance);
+        ASSERT(actual == expected);
+    }
+}
+
+BVTF_TEST(bounded_edit_distance_matches_full_levenshtein_distance_for_long_strings)
+{
+    // Strings longer than 64 characters don't fit in a single machine word and so take a different path
+    uint32_t rng = 0x89abcde;
+    for(int iteration=0; iteration<2000; iteration++)
+    {
+        const std::string strA = random_string(rng, 60 + (next_random(rng) % 40));
+        const std::string strB = random_edit(rng, strA, next_random(rng) % 8);
+        const int max_distance = next_random(rng) % 6;
+
+        const int expected = std::min(reference_edit_distance(strA, strB), max_distance + 1);
+        const int actual = bounded_edit_distance(strA, strB, max_distance);
+        ASSERT(actual == expected);
+    }
+}
+
+BVTF_BENCHMARK(bounded_edit_distance_benchmark_typical_tag_pairs)
+{
+    // Tag pairs like those compared when matching search results: identical tags, near-misses and unrelated tags
+    const std::pair<std::string_view, std::string_view> tag_pairs[] = {
+        {"The Beatles", "The Beatles"},
+        {"The Beatles", "Beatles"},
+        {"Don't Stop Me Now", "Dont Stop Me Now"},
+        {"Bohemian Rhapsody", "bohemian rhapsody"},
+        {"Smells Like Teen Spirit", "Smells Like Teen Spirit (Remastered)"},
+        {"A Night at the Opera", "A Night at the Opera (Deluxe Edition)"},
+        {"Iron Maiden", "Metallica"},
+        {"Stairway to Heaven", "Highway to Hell"},
+        {"Sigur R\xC3\xB3s", "Sigur Ros"},
+        {"Hey Jude", "Hey Jude"},
+        {"Paranoid Android", "Paranoid Andriod"},
+        {"Comfortably Numb", "Wish You Were Here"},
+    };
+    const int iterations = 100'000;
+
+    int reference_total = 0;
+    {
+        BVTF_MEASURE("Previous two-row Levenshtein distance");
+        for(int i=0; i<iterations; i++)
+        {
+            for(const auto& [tagA, tagB] : tag_pairs)
+            {
+                reference_total += (reference_edit_distance(tagA, tagB) <= 3) ? 1 : 0;
+            }
+        }
+    }
+
+    int bounded_total = 0;
+    {
+        BVTF_MEASURE("Bounded edit distance");
+        for(int i=0; i<iterations; i++)
+        {
+            for(const auto& [tagA, tagB] : tag_pairs)
+            {
+                bounded_total += (bounded_edit_distance(tagA, tagB, 3) <= 3) ? 1 : 0;
+            }
+        }
+    }
+
+    BVTF_REPORT("%d comparisons of each implementation", iterations * int(std::size(tag_pairs)));
+    CHECK(bounded_total == reference_total);
+}
@@ -2,6 +2,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
 
 // TODO: This requires shared.dll to be copied to the binaries directory from the fb2k install dir.
 // That kinda sucks but it's a consequence of linking to the fb2k SDK and the plugin DLL directly.
@@ -17,11 +20,35 @@ typedef struct
 {
     BVTF_TEST_FUNCTION_TYPE* ptr;
     const char* name;
+    bool is_benchmark;
 } bvtf_function_metadata;
 
-int bvtf_register_function(BVTF_TEST_FUNCTION_TYPE* ptr, const char* name);
+int bvtf_register_function(BVTF_TEST_FUNCTION_TYPE* ptr, const char* name, bool is_benchmark);
+
+#define BVTF_TEST(TEST_NAME) BVTF_TEST_FUNCTION_TYPE TEST_NAME; static int bvtf_test_##TEST_NAME = bvtf_register_function(&TEST_NAME, #TEST_NAME, false); void TEST_NAME(int* bvtf_error_count)
 
-#define BVTF_TEST(TEST_NAME) BVTF_TEST_FUNCTION_TYPE TEST_NAME; static int bvtf_test_##TEST_NAME = bvtf_register_function(&TEST_NAME, #TEST_NAME); void TEST_NAME(int* bvtf_error_count)
+// Benchmarks are only run when the test executable is passed "--benchmark" (and then only benchmarks are run).
+// They can use ASSERT & CHECK like any other test, and use BVTF_MEASURE to report how long a scope took.
+#define BVTF_BENCHMARK(TEST_NAME) BVTF_TEST_FUNCTION_TYPE TEST_NAME; static int bvtf_test_##TEST_NAME = bvtf_register_function(&TEST_NAME, #TEST_NAME, true); void TEST_NAME(int* bvtf_error_count)
+
+struct bvtf_scope_timer
+{
+    const char* label;
+    std::chrono::steady_clock::time_point start;
+
+    explicit bvtf_scope_timer(const char* label_) : label(label_), start(std::chrono::steady_clock::now()) {}
+    ~bvtf_scope_timer()
+    {
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        printf("    %s: %.3fms\n", label, elapsed.count());
+    }
+};
+#define BVTF_CONCAT_INNER(A, B) A##B
+#define BVTF_CONCAT(A, B) BVTF_CONCAT_INNER(A, B)
+#define BVTF_MEASURE(LABEL) const bvtf_scope_timer BVTF_CONCAT(bvtf_timer_, __LINE__)(LABEL)
+
+// Reports a result (other than timing) from a benchmark, using the same format as BVTF_MEASURE
+#define BVTF_REPORT(...) do{ printf("    "); printf(__VA_ARGS__); printf("\n"); }while(false)
 
 // TODO: It would be great if we could get away from using this macro and just leverage inline functions to allow every source file to be effectively equivalent in terms of infrastructure.
 //       The problem is knowing where to store the data, since we need each translation unit to contribute to the same list of tests.
@@ -30,21 +57,39 @@ int bvtf_register_function(BVTF_TEST_FUNCTION_TYPE* ptr, const char* name);
 static int bvtf_test_count = 0;
 static bvtf_function_metadata* bvtf_test_functions = nullptr;
 
-int bvtf_register_function(BVTF_TEST_FUNCTION_TYPE* ptr, const char* name)
+int bvtf_register_function(BVTF_TEST_FUNCTION_TYPE* ptr, const char* name, bool is_benchmark)
 {
     // TODO: Only realloc when we reach a new power of 2 in the test count, to minimise reallocs
     bvtf_test_functions = (bvtf_function_metadata*)realloc(bvtf_test_functions, sizeof(*bvtf_test_functions) * (bvtf_test_count+1));
-    bvtf_test_functions[bvtf_test_count] = { ptr, name };
+    bvtf_test_functions[bvtf_test_count] = { ptr, name, is_benchmark };
     bvtf_test_count++;
     return bvtf_test_count;
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    bool run_benchmarks = false;
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--benchmark") == 0)
+        {
+            run_benchmarks = true;
+        }
+    }
+
     int return_code = 0;
     printf("Executing %d test functions...\n", bvtf_test_count);
     for(int i=0; i<bvtf_test_count; i++)
     {
+        if(bvtf_test_functions[i].is_benchmark != run_benchmarks)
+        {
+            continue;
+        }
+        if(bvtf_test_functions[i].is_benchmark)
+        {
+            printf("[BENCHMARK] %s\n", bvtf_test_functions[i].name);
+        }
+
         int error_count = 0;
         bvtf_test_functions[i].ptr(&error_count);
 
@@ -0,0 +1,319 @@
+#include "bvtf.h"
+
+#include "tidy.h"
+#include "tidybuffio.h"
+#include "pugixml.hpp"
+
+#include "parsers.h"
+#include "sources/scrape_rules.h"
+
+using namespace parsers::html;
+
+BVTF_TEST(tokenizer_returns_text_and_tags_in_document_order)
+{
+    Tokenizer tokenizer("<div class=\"lyrics\">First line<br>Second line</div>");
+
+    const Token div_open = tokenizer.next();
+    ASSERT(div_open.type == TokenType::StartTag);
+    ASSERT(div_open.text == "div");
+    ASSERT(!div_open.self_closing);
+
+    const Token line1 = tokenizer.next();
+    ASSERT(line1.type == TokenType::Text);
+    ASSERT(line1.text == "First line");
+
+    const Token br = tokenizer.next();
+    ASSERT(br.type == TokenType::StartTag);
+    ASSERT(tag_is(br, "br"));
+    ASSERT(br.self_closing);
+
+    const Token line2 = tokenizer.next();
+    ASSERT(line2.type == TokenType::Text);
+    ASSERT(line2.text == "Second line");
+
+    const Token div_close = tokenizer.next();
+    ASSERT(div_close.type == TokenType::EndTag);
+    ASSERT(tag_is(div_close, "div"));
+
+    ASSERT(tokenizer.next().type == TokenType::EndOfInput);
+}
+
+BVTF_TEST(tokenizer_skips_comments_doctypes_and_scripts)
+{
+    Tokenizer tokenizer("<!DOCTYPE html><!-- <div>not a tag</div> --><script>if(a<b){}</script>text");
+
+    const Token script_open = tokenizer.next();
+    ASSERT(script_open.type == TokenType::StartTag);
+    ASSERT(tag_is(script_open, "script"));
+
+    const Token script_close = tokenizer.next();
+    ASSERT(script_close.type == TokenType::EndTag);
+    ASSERT(tag_is(script_close, "SCRIPT"));
+
+    const Token text = tokenizer.next();
+    ASSERT(text.type == TokenType::Text);
+    ASSERT(text.text == "text");
+
+    ASSERT(tokenizer.next().type == TokenType::EndOfInput);
+}
+
+BVTF_TEST(tokenizer_ignores_closing_angle_brackets_in_quoted_attributes)
+{
+    Tokenizer tokenizer("<a title='x > y' name=3/>after");
+
+    const Token anchor = tokenizer.next();
+    ASSERT(anchor.type == TokenType::StartTag);
+    ASSERT(anchor.self_closing);
+    CHECK(get_attribute(anchor.attributes, "title") == std::optional<std::string_view>("x > y"));
+    CHECK(get_attribute(anchor.attributes, "NAME") == std::optional<std::string_view>("3"));
+    CHECK(!get_attribute(anchor.attributes, "class").has_value());
+
+    const Token text = tokenizer.next();
+    ASSERT(text.type == TokenType::Text);
+    ASSERT(text.text == "after");
+}
+
+BVTF_TEST(decoded_text_replaces_named_and_numeric_character_references)
+{
+    std::string output;
+    append_decoded_text(output, "Rock &amp; Roll &lt;3 don&#39;t &#x2019; &nbsp;&unknown; & done");
+    ASSERT(output == "Rock & Roll <3 don't \xE2\x80\x99 \xC2\xA0&unknown; & done");
+}
+
+BVTF_TEST(decoded_text_replaces_any_html5_named_reference)
+{
+    std::string output;
+    append_decoded_text(output, "Wait&hellip; &ldquo;caf&eacute;&rdquo; &mdash; &CounterClockwiseContourIntegral; &hearts;");
+    ASSERT(output == "Wait\xE2\x80\xA6 \xE2\x80\x9C" "caf\xC3\xA9\xE2\x80\x9D \xE2\x80\x94 \xE2\x88\xB3 \xE2\x99\xA5");
+}
+
+BVTF_TEST(decoded_text_replaces_named_references_with_two_codepoints)
+{
+    std::string output;
+    append_decoded_text(output, "&NotEqualTilde;");
+    ASSERT(output == "\xE2\x89\x82\xCC\xB8");
+}
+
+BVTF_TEST(decoded_text_named_references_are_case_sensitive_and_need_a_semicolon)
+{
+    std::string output;
+    append_decoded_text(output, "&AMP; &Amp; &amp &copy");
+    ASSERT(output == "& &Amp; &amp &copy");
+}
+
+BVTF_TEST(decoded_text_numeric_references_in_c1_range_are_windows1252)
+{
+    std::string output;
+    append_decoded_text(output, "don&#146;t &#x96; &#150;");
+    ASSERT(output == "don\xE2\x80\x99t \xE2\x80\x93 \xE2\x80\x93");
+}
+
+// A page laid out like a Genius lyric page: lots of scripts, navigation & footer markup around a few lyric containers
+static std::string make_synthetic_lyric_page()
+{
+    std::string page = "<!DOCTYPE html><html><head><title>Artist - Title Lyrics</title>";
+    for(int i=0; i<100; i++)
+    {
+        page += "<script>window.__STATE__ = {\"item\": \"<div class='lyrics'>not lyrics</div>\", \"index\": " + std::to_string(i) + "};</script>";
+        page += "<style>.Lyrics__Container-" + std::to_string(i) + " { display: block; }</style>";
+    }
+    page += "</head><body><div class=\"header\"><ul>";
+    for(int i=0; i<500; i++)
+    {
+        page += "<li class=\"nav-item\"><a href=\"/artists/" + std::to_string(i) + "\">Artist &amp; friends " + std::to_string(i) + "</a></li>";
+    }
+    page += "</ul></div><main>";
+    for(int verse=0; verse<4; verse++)
+    {
+        page += "<div data-lyrics-container=\"true\" class=\"Lyrics__Container-sc-1ynbvzw-6 jYfhrf\">[Verse " + std::to_string(verse) + "]<br>";
+        for(int line=0; line<16; line++)
+        {
+            page += "<a href=\"/annotation\"><span>Line " + std::to_string(line) + " of the verse, don&#x27;t stop</span></a><br>";
+            page += "Another line &amp; <i>some</i> emphasis<br>";
+        }
+        page += "</div><div class=\"RightSidebar\"><div class=\"ad\">Advertisement</div></div>";
+    }
+    page += "</main><div class=\"footer\">";
+    for(int i=0; i<1000; i++)
+    {
+        page += "<div class=\"footer-item\"><p>Footer link number " + std::to_string(i) + "</p></div>";
+    }
+    page += "</div></body></html>";
+    return page;
+}
+
+static std::string extract_synthetic_page_lyrics(std::string_view page)
+{
+    scrape::RuleSet rules = {};
+    rules.container = "div[class=lyrics], div[class*=Lyrics__Container]";
+    rules.text_scope = scrape::TextScope::Descendants;
+    rules.text_trim = scrape::TextTrim::LineEndings;
+    rules.newline_after_container = true;
+
+    const std::vector<scrape::ExtractedTrack> tracks = scrape::extract_tracks(rules, page);
+    return tracks.empty() ? std::string() : tracks[0].text;
+}
+
+// Counts the heap memory used by tidy & pugixml, so that we can report the peak usage of the previous implementation
+namespace counted_heap
+{
+    static size_t g_current_bytes = 0;
+    static size_t g_peak_bytes = 0;
+
+    static void* allocate(size_t size)
+    {
+        void* block = malloc(sizeof(max_align_t) + size);
+        if(block == nullptr) return nullptr;
+        *static_cast<size_t*>(block) = size;
+        g_current_bytes += size;
+        g_peak_bytes = (g_current_bytes > g_peak_bytes) ? g_current_bytes : g_peak_bytes;
+        return static_cast<char*>(block) + sizeof(max_align_t);
+    }
+
+    static void deallocate(void* ptr)
+    {
+        if(ptr == nullptr) return;
+        void* block = static_cast<char*>(ptr) - sizeof(max_align_t);
+        g_current_bytes -= *static_cast<size_t*>(block);
+        free(block);
+    }
+
+    static void* reallocate(void* ptr, size_t size)
+    {
+        void* new_ptr = allocate(size);
+        if((ptr != nullptr) && (new_ptr != nullptr))
+        {
+            const size_t old_size = *reinterpret_cast<size_t*>(static_cast<char*>(ptr) - sizeof(max_align_t));
+            memcpy(new_ptr, ptr, (old_size < size) ? old_size : size);
+            deallocate(ptr);
+        }
+        return new_ptr;
+    }
+
+    static void* TIDY_CALL tidy_alloc(TidyAllocator*, size_t size) { return allocate(size); }
+    static void* TIDY_CALL tidy_realloc(TidyAllocator*, void* ptr, size_t size) { return reallocate(ptr, size); }
+    static void TIDY_CALL tidy_free(TidyAllocator*, void* ptr) { deallocate(ptr); }
+    static void TIDY_CALL tidy_panic(TidyAllocator*, ctmbstr) { abort(); }
+    static const TidyAllocatorVtbl g_tidy_vtbl = { tidy_alloc, tidy_realloc, tidy_free, tidy_panic };
+}
+
+// The text extraction used by the Genius source before pages were tokenized directly, kept here as a benchmark baseline.
+// The page is converted to XHTML by tidy, loaded into a pugixml DOM and then the lyric containers are found with XPath.
+namespace previous_html_extract
+{
+    static std::string_view trim_line_endings(std::string_view str)
+    {
+        while(!str.empty() && ((str.front() == '\r') || (str.front() == '\n'))) str.remove_prefix(1);
+        while(!str.empty() && ((str.back() == '\r') || (str.back() == '\n'))) str.remove_suffix(1);
+        return str;
+    }
+
+    static void add_all_text_to_string(std::string& output, pugi::xml_node node)
+    {
+        if((node.type() == pugi::node_null) || (node.type() != pugi::node_element))
+        {
+            return;
+        }
+
+        for(pugi::xml_node child : node.children())
+        {
+            if(child.type() == pugi::node_pcdata)
+            {
+                std::string node_text(trim_line_endings(child.value()));
+                node_text.erase(std::remove(node_text.begin(), node_text.end(), '\r'), node_text.end());
+                std::replace(node_text.begin(), node_text.end(), '\n', ' ');
+                output += node_text;
+            }
+            else if(child.type() == pugi::node_element)
+            {
+                if(strcmp(child.name(), "br") == 0)
+                {
+                    output += "\r\n";
+                }
+                else
+                {
+                    add_all_text_to_string(output, child);
+                }
+            }
+        }
+    }
+
+    static std::string extract_lyrics(const std::string& content)
+    {
+        TidyAllocator allocator = { &counted_heap::g_tidy_vtbl };
+        std::string lyric_text;
+        TidyBuffer tidy_output = {};
+        TidyBuffer tidy_error = {};
+        tidyBufInitWithAllocator(&tidy_output, &allocator);
+        tidyBufInitWithAllocator(&tidy_error, &allocator);
+
+        TidyDoc tidy_doc = tidyCreateWithAllocator(&allocator);
+        tidySetErrorBuffer(tidy_doc, &tidy_error);
+        tidyOptSetBool(tidy_doc, TidyXhtmlOut, yes);
+        tidyOptSetBool(tidy_doc, TidyForceOutput, yes);
+        tidyParseString(tidy_doc, content.c_str());
+        tidyCleanAndRepair(tidy_doc);
+        tidyRunDiagnostics(tidy_doc);
+        tidySaveBuffer(tidy_doc, &tidy_output);
+
+        if(tidyErrorCount(tidy_doc) == 0)
+        {
+            pugi::xml_document doc;
+            doc.load_buffer(tidy_output.bp, tidy_output.size);
+
+            const char* xpath_queries[] = { "//div[@class='lyrics']", "//div[contains(@class, 'Lyrics__Container')]" };
+            for(const char* query_str : xpath_queries)
+            {
+                pugi::xpath_query query_lyricdivs(query_str);
+                pugi::xpath_node_set lyricdivs = query_lyricdivs.evaluate_node_set(doc);
+                if(!lyricdivs.empty())
+                {
+                    for(const pugi::xpath_node& node : lyricdivs)
+                    {
+                        add_all_text_to_string(lyric_text, node.node());
+                        lyric_text += "\r\n";
+                    }
+                    break;
+                }
+            }
+        }
+
+        tidyBufFree(&tidy_output);
+        tidyBufFree(&tidy_error);
+        tidyRelease(tidy_doc);
+        return lyric_text;
+    }
+}
+
+BVTF_BENCHMARK(html_benchmark_lyric_extraction_from_synthetic_page)
+{
+    const std::string page = make_synthetic_lyric_page();
+    const int iterations = 20;
+    BVTF_REPORT("Page size: %zu bytes, %d iterations", page.length(), iterations);
+
+    pugi::set_memory_management_functions(counted_heap::allocate, counted_heap::deallocate);
+    std::string previous_lyrics;
+    {
+        BVTF_MEASURE("Previous implementation, tidy + pugixml + XPath");
+        for(int i=0; i<iterations; i++)
+        {
+            previous_lyrics = previous_html_extract::extract_lyrics(page);
+        }
+    }
+    pugi::set_memory_management_functions(malloc, free);
+    BVTF_REPORT("Previous implementation peak heap usage: %zu bytes", counted_heap::g_peak_bytes);
+
+    std::string lyrics;
+    {
+        BVTF_MEASURE("Streaming tokenizer");
+        for(int i=0; i<iterations; i++)
+        {
+            lyrics = extract_synthetic_page_lyrics(page);
+        }
+    }
+    // The tokenizer only ever references the page, so the only memory it allocates is the output text
+    BVTF_REPORT("Streaming tokenizer peak heap usage: %zu bytes", lyrics.capacity());
+
+    CHECK(!lyrics.empty());
+    CHECK(lyrics == previous_lyrics);
+}
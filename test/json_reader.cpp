@@ -0,0 +1,268 @@
+#include "bvtf.h"
+
+#include "cJSON.h"
+
+#include "parsers.h"
+
+using namespace parsers::json;
+
+BVTF_TEST(reader_finds_nested_keys_and_skips_everything_else)
+{
+    Reader reader("{\"header\": {\"status\": [1, {\"x\": \"}]\"}]}, \"result\": {\"songs\": [{\"id\": 42, \"name\": \"Title\", \"ok\": true, \"nothing\": null}, 7]}}");
+    ASSERT(reader.enter_object());
+    ASSERT(reader.find_key("result"));
+    ASSERT(reader.enter_object());
+    ASSERT(reader.find_key("songs"));
+    ASSERT(reader.peek() == ValueType::Array);
+    ASSERT(reader.enter_array());
+
+    ASSERT(reader.next_element());
+    ASSERT(reader.enter_object());
+
+    std::string_view key;
+    double id = 0.0;
+    ASSERT(reader.next_key(key));
+    ASSERT(key == "id");
+    ASSERT(reader.read_number(id));
+    CHECK(id == 42.0);
+
+    std::string name;
+    ASSERT(reader.next_key(key));
+    ASSERT(key == "name");
+    ASSERT(reader.read_string(name));
+    CHECK(name == "Title");
+    ASSERT(reader.exit_object());
+
+    ASSERT(reader.next_element());
+    ASSERT(reader.peek() == ValueType::Number);
+    ASSERT(reader.skip_value());
+    ASSERT(!reader.next_element());
+    ASSERT(!reader.failed());
+}
+
+BVTF_TEST(reader_unescapes_strings)
+{
+    Reader reader("[\"a\\\"b\\\\c\\/d\\n\", \"\\u00e9\\u2019\\ud83c\\udfb5\"]");
+    ASSERT(reader.enter_array());
+
+    std::string value;
+    ASSERT(reader.next_element());
+    ASSERT(reader.read_string(value));
+    CHECK(value == "a\"b\\c/d\n");
+
+    ASSERT(reader.next_element());
+    ASSERT(reader.read_string(value));
+    CHECK(value == "\xC3\xA9\xE2\x80\x99\xF0\x9F\x8E\xB5");
+
+    ASSERT(!reader.next_element());
+    ASSERT(!reader.failed());
+}
+
+BVTF_TEST(reader_stops_at_malformed_input)
+{
+    Reader reader("{\"key\" 1}");
+    ASSERT(reader.enter_object());
+
+    std::string_view key;
+    ASSERT(!reader.next_key(key));
+    ASSERT(reader.failed());
+    ASSERT(reader.peek() == ValueType::Invalid);
+    ASSERT(!reader.enter_object());
+}
+
+BVTF_TEST(reader_uses_the_first_of_duplicate_keys_like_cjson)
+{
+    const char* json = "{\"id\": 1, \"name\": \"First\", \"id\": 2, \"name\": \"Second\"}";
+
+    cJSON* root = cJSON_Parse(json);
+    ASSERT(root != nullptr);
+    const cJSON* cjson_id = cJSON_GetObjectItem(root, "id");
+    const cJSON* cjson_name = cJSON_GetObjectItem(root, "name");
+    ASSERT((cjson_id != nullptr) && (cjson_name != nullptr));
+    CHECK(cjson_id->valuedouble == 1.0);
+    CHECK(strcmp(cjson_name->valuestring, "First") == 0);
+    cJSON_Delete(root);
+
+    Reader find_reader(json);
+    double id = 0.0;
+    ASSERT(find_reader.enter_object());
+    ASSERT(find_reader.find_key("id"));
+    ASSERT(find_reader.read_number(id));
+    CHECK(id == 1.0);
+
+    Reader loop_reader(json);
+    bool seen_id = false;
+    bool seen_name = false;
+    std::string name;
+    std::string_view key;
+    id = 0.0;
+    ASSERT(loop_reader.enter_object());
+    while(loop_reader.next_key(key))
+    {
+        if((key == "id") && is_first_occurrence(seen_id)) loop_reader.read_number(id);
+        else if((key == "name") && is_first_occurrence(seen_name)) loop_reader.read_string(name);
+        else loop_reader.skip_value();
+    }
+    ASSERT(!loop_reader.failed());
+    CHECK(id == 1.0);
+    CHECK(name == "First");
+}
+
+// A search response laid out like those from NetEase, which include a lot of data that we don't use for every song
+static std::string make_synthetic_search_response(int song_count)
+{
+    std::string json = "{\"result\": {\"songCount\": " + std::to_string(song_count) + ", \"songs\": [";
+    for(int i=0; i<song_count; i++)
+    {
+        const std::string index = std::to_string(i);
+        json += (i == 0) ? "" : ",";
+        json += "{\"id\": " + std::to_string(1000000 + i) + ", \"name\": \"Song title number " + index + " \\u2019 (Live)\", ";
+        json += "\"artists\": [{\"id\": 12345, \"name\": \"The Artist\", \"picUrl\": null, \"alias\": [], \"albumSize\": 0, \"picId\": 0, \"img1v1Url\": \"https://p1.music.126.net/6y-UleORITEDbvrOLV0Q8A==/5639395138885805.jpg\", \"img1v1\": 0, \"trans\": null}, ";
+        json += "{\"id\": 67890, \"name\": \"Featured Artist\", \"picUrl\": null, \"alias\": [\"Alias\"], \"albumSize\": 0, \"picId\": 0, \"img1v1Url\": \"https://p1.music.126.net/6y-UleORITEDbvrOLV0Q8A==/5639395138885805.jpg\", \"img1v1\": 0, \"trans\": null}], ";
+        json += "\"album\": {\"id\": " + index + ", \"name\": \"Album \\\"" + index + "\\\"\", \"artist\": {\"id\": 0, \"name\": \"\", \"picUrl\": null, \"alias\": [], \"albumSize\": 0, \"picId\": 0}, \"publishTime\": 1388505600007, \"size\": 12, \"copyrightId\": 7002, \"status\": 1, \"picId\": 109951163076136660, \"mark\": 0}, ";
+        json += "\"duration\": 245000, \"copyrightId\": 7002, \"status\": 0, \"alias\": [\"Some alias\", \"Another alias\"], \"rtype\": 0, \"ftype\": 0, \"mvid\": 0, \"fee\": 8, \"rUrl\": null, \"mark\": 8192}";
+    }
+    json += "]}, \"code\": 200}";
+    return json;
+}
+
+struct BenchmarkSong
+{
+    std::string artist;
+    std::string album;
+    std::string title;
+    int64_t id;
+};
+
+// Reads the search results in the same way as the NetEase source did when it used cJSON, as a benchmark baseline
+static std::vector<BenchmarkSong> read_songs_with_cjson(const std::string& json)
+{
+    std::vector<BenchmarkSong> output;
+    cJSON* root = cJSON_ParseWithLength(json.c_str(), json.length());
+    cJSON* result_obj = cJSON_GetObjectItem(root, "result");
+    cJSON* song_arr = cJSON_GetObjectItem(result_obj, "songs");
+    const int song_arr_len = cJSON_GetArraySize(song_arr);
+    for(int song_index=0; song_index<song_arr_len; song_index++)
+    {
+        cJSON* song_item = cJSON_GetArrayItem(song_arr, song_index);
+        BenchmarkSong song = {};
+
+        cJSON* artist_list_item = cJSON_GetObjectItem(song_item, "artists");
+        cJSON* artist_item = cJSON_GetArrayItem(artist_list_item, 0);
+        cJSON* artist_name = cJSON_GetObjectItem(artist_item, "name");
+        if((artist_name != nullptr) && (artist_name->type == cJSON_String)) song.artist = artist_name->valuestring;
+
+        cJSON* album_item = cJSON_GetObjectItem(song_item, "album");
+        cJSON* album_title_item = cJSON_GetObjectItem(album_item, "name");
+        if((album_title_item != nullptr) && (album_title_item->type == cJSON_String)) song.album = album_title_item->valuestring;
+
+        cJSON* title_item = cJSON_GetObjectItem(song_item, "name");
+        if((title_item != nullptr) && (title_item->type == cJSON_String)) song.title = title_item->valuestring;
+
+        cJSON* song_id_item = cJSON_GetObjectItem(song_item, "id");
+        if((song_id_item == nullptr) || (song_id_item->type != cJSON_Number)) continue;
+        song.id = (int64_t)song_id_item->valuedouble;
+        output.push_back(std::move(song));
+    }
+    cJSON_Delete(root);
+    return output;
+}
+
+// Reads the search results in the same way as the NetEase source does with the reader
+static std::vector<BenchmarkSong> read_songs_with_reader(const std::string& json)
+{
+    std::vector<BenchmarkSong> output;
+    Reader reader(json);
+    if(!reader.enter_object() || !reader.find_key("result") || !reader.enter_object() || !reader.find_key("songs") || !reader.enter_array())
+    {
+        return output;
+    }
+
+    while(reader.next_element() && reader.enter_object())
+    {
+        BenchmarkSong song = {};
+        std::optional<double> id;
+        bool seen_id = false;
+        bool seen_name = false;
+        bool seen_artists = false;
+        bool seen_album = false;
+        std::string_view key;
+        while(reader.next_key(key))
+        {
+            const ValueType value_type = reader.peek();
+            double number = 0.0;
+            if((key == "id") && is_first_occurrence(seen_id) && (value_type == ValueType::Number) && reader.read_number(number))
+            {
+                id = number;
+            }
+            else if((key == "name") && is_first_occurrence(seen_name) && (value_type == ValueType::String))
+            {
+                reader.read_string(song.title);
+            }
+            else if((key == "artists") && is_first_occurrence(seen_artists) && (value_type == ValueType::Array))
+            {
+                reader.enter_array();
+                if(reader.next_element() && reader.enter_object() && reader.find_key("name") && reader.read_string(song.artist))
+                {
+                    reader.exit_object();
+                }
+                reader.exit_array();
+            }
+            else if((key == "album") && is_first_occurrence(seen_album) && (value_type == ValueType::Object))
+            {
+                reader.enter_object();
+                if(reader.find_key("name") && reader.read_string(song.album))
+                {
+                    reader.exit_object();
+                }
+            }
+            else
+            {
+                reader.skip_value();
+            }
+        }
+
+        if(id.has_value())
+        {
+            song.id = (int64_t)id.value();
+            output.push_back(std::move(song));
+        }
+    }
+    return output;
+}
+
+BVTF_BENCHMARK(json_benchmark_reading_a_search_response)
+{
+    const std::string json = make_synthetic_search_response(60);
+    const int iterations = 1000;
+    BVTF_REPORT("Response size: %zu bytes, %d iterations", json.length(), iterations);
+
+    std::vector<BenchmarkSong> cjson_songs;
+    {
+        BVTF_MEASURE("cJSON tree with key lookups");
+        for(int i=0; i<iterations; i++)
+        {
+            cjson_songs = read_songs_with_cjson(json);
+        }
+    }
+
+    std::vector<BenchmarkSong> reader_songs;
+    {
+        BVTF_MEASURE("Single-pass pull reader");
+        for(int i=0; i<iterations; i++)
+        {
+            reader_songs = read_songs_with_reader(json);
+        }
+    }
+
+    ASSERT(reader_songs.size() == 60);
+    ASSERT(cjson_songs.size() == reader_songs.size());
+    for(size_t i=0; i<reader_songs.size(); i++)
+    {
+        CHECK(reader_songs[i].artist == cjson_songs[i].artist);
+        CHECK(reader_songs[i].album == cjson_songs[i].album);
+        CHECK(reader_songs[i].title == cjson_songs[i].title);
+        CHECK(reader_songs[i].id == cjson_songs[i].id);
+    }
+    CHECK(reader_songs[3].album == "Album \"3\"");
+}
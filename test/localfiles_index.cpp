@@ -0,0 +1,32 @@
+#include "bvtf.h"
+
+#include "sources/localfiles_index.h"
+
+using namespace localfiles_index;
+
+BVTF_TEST(loose_file_name_key_ignores_case_and_punctuation)
+{
+    CHECK(loose_file_name_key("AC-DC - Back in Black.lrc") == loose_file_name_key("ACDC - Back In Black.lrc"));
+    CHECK(loose_file_name_key("Don't Stop Me Now.txt") == loose_file_name_key("dont stop me now.txt"));
+    CHECK(loose_file_name_key("Title.LRC") == loose_file_name_key("title.lrc"));
+}
+
+BVTF_TEST(loose_file_name_key_distinguishes_different_names_and_extensions)
+{
+    CHECK(loose_file_name_key("Artist - Title.lrc") != loose_file_name_key("Artist - Title.txt"));
+    CHECK(loose_file_name_key("Artist - Title.lrc") != loose_file_name_key("Artist - Title 2.lrc"));
+    CHECK(loose_file_name_key("Artist - Title.lrc") != loose_file_name_key("Artist - Title.lrc.bak"));
+}
+
+BVTF_TEST(loose_file_name_key_keeps_non_ascii_characters)
+{
+    CHECK(loose_file_name_key("\xE3\x81\x82 - \xE3\x81\x84.lrc") == loose_file_name_key("\xE3\x81\x82\xE3\x81\x84.lrc"));
+    CHECK(loose_file_name_key("\xE3\x81\x82.lrc") != loose_file_name_key("\xE3\x81\x84.lrc"));
+}
+
+BVTF_TEST(loose_file_name_key_is_empty_for_names_that_are_only_punctuation)
+{
+    CHECK(loose_file_name_key("???.lrc").empty());
+    CHECK(loose_file_name_key(" - .txt").empty());
+    CHECK(!loose_file_name_key("a.lrc").empty());
+}
@@ -0,0 +1,68 @@
+#include "bvtf.h"
+
+#include "parsers.h"
+
+static LyricData make_lyrics(std::vector<std::string> tags, std::vector<LyricDataLine> lines)
+{
+    LyricData lyrics = {};
+    lyrics.tags = std::move(tags);
+    lyrics.lines = std::move(lines);
+    lyrics.timestamp_offset = 0.0;
+    return lyrics;
+}
+
+BVTF_TEST(lrc_write_plain_keeps_every_line)
+{
+    const LyricData lyrics = make_lyrics({"[ar:Artist]"}, {{_T("Chorus"), 1.0}, {_T("Verse"), 62.5}, {_T("Chorus"), 3723.25}, {_T("Outro"), DBL_MAX}});
+    const std::string output = parsers::lrc::write(lyrics, parsers::lrc::OutputFormat::Lrc);
+    CHECK(output == "[ar:Artist]\r\n\r\n[00:01.00]Chorus\r\n[01:02.50]Verse\r\n[01:02:03.25]Chorus\r\nOutro\r\n");
+}
+
+BVTF_TEST(lrc_write_plain_splits_lines_with_identical_timestamps)
+{
+    const LyricData lyrics = make_lyrics({}, {{_T("First\nSecond"), 1.5}, {_T(""), 2.0}});
+    const std::string output = parsers::lrc::write(lyrics, parsers::lrc::OutputFormat::Lrc);
+    CHECK(output == "[00:01.50]First\r\n[00:01.50]Second\r\n[00:02.00]\r\n");
+}
+
+BVTF_TEST(lrc_write_merged_groups_identical_lines_at_their_first_occurrence)
+{
+    const LyricData lyrics = make_lyrics({}, {{_T("Chorus"), 1.0}, {_T("Verse"), 2.0}, {_T("Chorus"), 3.0}, {_T("Verse 2"), 4.0}, {_T("Chorus"), 5.0}, {_T("Chorus"), DBL_MAX}});
+    const std::string output = parsers::lrc::write(lyrics, parsers::lrc::OutputFormat::MergedLrc);
+    CHECK(output == "[00:01.00][00:03.00][00:05.00]Chorus\r\n[00:02.00]Verse\r\n[00:04.00]Verse 2\r\nChorus\r\n");
+}
+
+BVTF_TEST(lrc_write_merged_output_parses_back_to_the_original_lines)
+{
+    const LyricData lyrics = make_lyrics({}, {{_T("a"), 1.0}, {_T("b"), 2.0}, {_T("a"), 3.0}, {_T("c"), 4.0}, {_T("b"), 5.0}});
+    LyricDataUnstructured unstructured(lyrics);
+    unstructured.text = parsers::lrc::write(lyrics, parsers::lrc::OutputFormat::MergedLrc);
+
+    const LyricData parsed = parsers::lrc::parse(unstructured);
+    ASSERT(parsed.lines.size() == lyrics.lines.size());
+    for(size_t i=0; i<lyrics.lines.size(); i++)
+    {
+        CHECK(parsed.lines[i].text == lyrics.lines[i].text);
+        CHECK(parsed.lines[i].timestamp == lyrics.lines[i].timestamp);
+    }
+}
+
+BVTF_TEST(lrc_write_enhanced_ends_each_line_at_the_start_of_the_next)
+{
+    const LyricData lyrics = make_lyrics({}, {{_T("One"), 1.0}, {_T(""), 2.0}, {_T("Two"), 3.0}, {_T("Three"), 3.0}, {_T("Four"), 4.5}});
+    const std::string output = parsers::lrc::write(lyrics, parsers::lrc::OutputFormat::EnhancedLrc);
+    CHECK(output == "[00:01.00]<00:01.00>One<00:02.00>\r\n"
+                    "[00:02.00]\r\n"
+                    "[00:03.00]<00:03.00>Two<00:04.50>\r\n"
+                    "[00:03.00]<00:03.00>Three<00:04.50>\r\n"
+                    "[00:04.50]<00:04.50>Four\r\n");
+}
+
+BVTF_TEST(lrc_write_srt_applies_offset_and_skips_untimed_and_empty_lines)
+{
+    LyricData lyrics = make_lyrics({"[offset:500]"}, {{_T("One"), 1.5}, {_T(""), 2.0}, {_T("Two\nLines"), 62.0}, {_T("Untimed"), DBL_MAX}});
+    lyrics.timestamp_offset = 0.5;
+    const std::string output = parsers::lrc::write(lyrics, parsers::lrc::OutputFormat::Srt);
+    CHECK(output == "1\r\n00:00:01,000 --> 00:00:01,500\r\nOne\r\n\r\n"
+                    "2\r\n00:01:01,500 --> 00:01:06,500\r\nTwo\r\nLines\r\n\r\n");
+}
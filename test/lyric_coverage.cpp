@@ -0,0 +1,27 @@
+#include "bvtf.h"
+
+#include "lyric_coverage.h"
+
+BVTF_TEST(coverage_timestamped_text_detected)
+{
+    CHECK(coverage::text_is_timestamped("[00:12.34]First line\r\n[00:15.00]Second line"));
+    CHECK(coverage::text_is_timestamped("[01:02:03.45]Line with hours"));
+}
+
+BVTF_TEST(coverage_timestamp_after_tags_detected)
+{
+    CHECK(coverage::text_is_timestamped("[ar:Artist]\n[ti:Title]\n\n[00:01.00]Finally some lyrics"));
+}
+
+BVTF_TEST(coverage_plain_text_not_timestamped)
+{
+    CHECK(!coverage::text_is_timestamped(""));
+    CHECK(!coverage::text_is_timestamped("Just some lyrics\nwith no timestamps"));
+    CHECK(!coverage::text_is_timestamped("[Chorus]\nSing along"));
+    CHECK(!coverage::text_is_timestamped("[ar:Artist]\n[ti:Title]"));
+}
+
+BVTF_TEST(coverage_timestamp_must_start_the_line)
+{
+    CHECK(!coverage::text_is_timestamped("Not at the start [00:12.34]"));
+}
@@ -0,0 +1,49 @@
+#include "bvtf.h"
+
+#include "sources/scrape_rules.h"
+
+static scrape::RuleSet make_sibling_rules()
+{
+    scrape::RuleSet rules = {};
+    rules.container = "div:not([class])";
+    rules.container_follows = "div[class=lyricsh]";
+    rules.text_scope = scrape::TextScope::DirectChildren;
+    rules.text_trim = scrape::TextTrim::Whitespace;
+    rules.newline_after_container = false;
+    return rules;
+}
+
+BVTF_TEST(scrape_container_follows_siblings_with_explicit_end_tags)
+{
+    const std::string_view page = "<div><div class=\"lyricsh\"><h2>Title</h2></div><p>Ad</p><div>Line one<br>Line two</div></div>";
+    const std::vector<scrape::ExtractedTrack> tracks = scrape::extract_tracks(make_sibling_rules(), page);
+    ASSERT(tracks.size() == 1);
+    CHECK(tracks[0].text == "Line one\r\nLine two");
+}
+
+BVTF_TEST(scrape_container_follows_paragraphs_without_end_tags)
+{
+    const std::string_view page = "<div><div class=\"lyricsh\">Title</div><p>Ad one<p>Ad <b>two</b><div>Line one<br>Line two</div></div>";
+    const std::vector<scrape::ExtractedTrack> tracks = scrape::extract_tracks(make_sibling_rules(), page);
+    ASSERT(tracks.size() == 1);
+    CHECK(tracks[0].text == "Line one\r\nLine two");
+}
+
+BVTF_TEST(scrape_container_follows_list_items_without_end_tags)
+{
+    scrape::RuleSet rules = make_sibling_rules();
+    rules.container = "li.lyrics";
+    rules.container_follows = "li.header";
+
+    const std::string_view page = "<ul><li class=\"header\">Title<li>Ad<ul><li>Nested<li>List</ul><li class=\"lyrics\">Line one<br>Line two</ul>";
+    const std::vector<scrape::ExtractedTrack> tracks = scrape::extract_tracks(rules, page);
+    ASSERT(tracks.size() == 1);
+    CHECK(tracks[0].text == "Line one\r\nLine two");
+}
+
+BVTF_TEST(scrape_container_follows_stops_at_the_end_of_the_parent)
+{
+    const std::string_view page = "<div><div class=\"lyricsh\">Title</div><p>Unclosed</div><div>Not a sibling</div>";
+    const std::vector<scrape::ExtractedTrack> tracks = scrape::extract_tracks(make_sibling_rules(), page);
+    CHECK(tracks.empty() || tracks[0].text.empty());
+}
@@ -0,0 +1,49 @@
+#include "bvtf.h"
+
+#include "metadb_index_search_avoidance.h"
+
+BVTF_TEST(retry_delay_is_zero_before_any_failures)
+{
+    CHECK(search_avoidance_retry_delay(0, 12345) == 0);
+    CHECK(search_avoidance_retry_delay(-1, 12345) == 0);
+}
+
+BVTF_TEST(retry_delay_is_within_jitter_of_doubling_schedule)
+{
+    const metadb_index_hash hashes[] = {0, 1, 0xDEADBEEF, 0xFFFFFFFFFFFFFFFFull};
+    for(metadb_index_hash hash : hashes)
+    {
+        t_filetimestamp expected = system_time_periods::day;
+        for(int failures=1; failures<=6; failures++)
+        {
+            const t_filetimestamp delay = search_avoidance_retry_delay(failures, hash);
+            CHECK(delay >= expected - expected/5);
+            CHECK(delay <= expected + expected/5);
+            expected *= 2;
+        }
+    }
+}
+
+BVTF_TEST(retry_delay_stops_growing_after_a_month)
+{
+    const t_filetimestamp max_delay = 32*system_time_periods::day + (32*system_time_periods::day)/5;
+    CHECK(search_avoidance_retry_delay(7, 42) <= max_delay);
+    CHECK(search_avoidance_retry_delay(100, 42) <= max_delay);
+    CHECK(search_avoidance_retry_delay(INT_MAX, 42) <= max_delay);
+}
+
+BVTF_TEST(retry_delay_jitter_differs_between_tracks)
+{
+    bool any_different = false;
+    const t_filetimestamp first = search_avoidance_retry_delay(1, 0);
+    for(metadb_index_hash hash=1; hash<16; hash++)
+    {
+        any_different |= (search_avoidance_retry_delay(1, hash) != first);
+    }
+    CHECK(any_different);
+}
+
+BVTF_TEST(retry_delay_is_deterministic)
+{
+    CHECK(search_avoidance_retry_delay(3, 0xABCDEF) == search_avoidance_retry_delay(3, 0xABCDEF));
+}